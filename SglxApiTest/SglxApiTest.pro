@@ -0,0 +1,25 @@
+# Checks of SglxApi's connection handling against a scripted fake
+# server. Plain C++/POSIX; no Qt. Exits nonzero on any failure.
+
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle qt
+
+LIBS += -pthread
+
+INCLUDEPATH += ../SpikeMemory
+
+SOURCES += \
+    ../SpikeMemory/Comm.cpp \
+    ../SpikeMemory/NetClient.cpp \
+    ../SpikeMemory/SglxApi.cpp \
+    ../SpikeMemory/SglxCppClient.cpp \
+    ../SpikeMemory/Socket.cpp \
+    main.cpp
+
+HEADERS += \
+    ../SpikeMemory/Comm.h \
+    ../SpikeMemory/NetClient.h \
+    ../SpikeMemory/SglxApi.h \
+    ../SpikeMemory/SglxCppClient.h \
+    ../SpikeMemory/Socket.h
@@ -0,0 +1,218 @@
+
+#include "SglxApi.h"
+#include "SglxCppClient.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+
+
+static int  nFail = 0;
+
+#define CHECK( cond )                                               \
+    do {                                                            \
+        if( !(cond) ) {                                             \
+            fprintf( stderr, "FAIL %s:%d: %s\n",                    \
+                __FILE__, __LINE__, #cond );                        \
+            ++nFail;                                                \
+        }                                                           \
+    } while( 0 )
+
+/* ---------------------------------------------------------------- */
+/* Fake server ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+static int listenAny( int &port )
+{
+    int lsock = socket( AF_INET, SOCK_STREAM, 0 );
+
+    struct sockaddr_in  addr;
+    socklen_t           len = sizeof(addr);
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family         = AF_INET;
+    addr.sin_addr.s_addr    = htonl( INADDR_LOOPBACK );
+    addr.sin_port           = 0;
+
+    bind( lsock, (struct sockaddr*)&addr, sizeof(addr) );
+    listen( lsock, 4 );
+    getsockname( lsock, (struct sockaddr*)&addr, &len );
+    port = ntohs( addr.sin_port );
+
+    return lsock;
+}
+
+
+// Accept a connection, or return -1 if none comes within (ms).
+//
+static int acceptWithin( int lsock, int ms )
+{
+    struct pollfd   pfd = {lsock, POLLIN, 0};
+
+    if( poll( &pfd, 1, ms ) <= 0 )
+        return -1;
+
+    return accept( lsock, 0, 0 );
+}
+
+
+static bool readLine( int sock, std::string &line )
+{
+    char    c;
+
+    line.clear();
+
+    while( recv( sock, &c, 1, 0 ) == 1 ) {
+
+        if( c == '\n' )
+            return true;
+
+        line += c;
+    }
+
+    return false;
+}
+
+
+static void sendAll( int sock, const void *buf, size_t n )
+{
+    send( sock, buf, n, MSG_NOSIGNAL );
+}
+
+
+static void sendStr( int sock, const std::string &s )
+{
+    sendAll( sock, s.c_str(), s.size() );
+}
+
+
+// Answer one connection's commands. FETCH gets a 1 x 4 reply, but
+// on the (breakAt)th FETCH the reply stops partway through its
+// binary data and the connection closes.
+//
+static void serve( int sock, int breakAt )
+{
+    std::string line;
+    short       samps[4] = {1, 2, 3, 4};
+    int         nFetch = 0;
+
+    if( sock < 0 )
+        return;
+
+    while( readLine( sock, line ) ) {
+
+        if( line == "GETVERSION" )
+            sendStr( sock, "FakeServer-1\nOK\n" );
+        else if( line == "NOOP" )
+            sendStr( sock, "OK\n" );
+        else if( !line.compare( 0, 20, "GETSTREAMSAMPLECOUNT" ) )
+            sendStr( sock, "12345\nOK\n" );
+        else if( !line.compare( 0, 5, "FETCH" ) ) {
+
+            char    hdr[64];
+
+            sprintf( hdr, "BINARY_DATA 1 4 uint64(%d)\n", 100 + 4 * nFetch );
+            sendStr( sock, hdr );
+
+            if( ++nFetch == breakAt ) {
+                sendAll( sock, samps, 3 );
+                break;
+            }
+
+            sendAll( sock, samps, sizeof(samps) );
+            sendStr( sock, "OK\n" );
+        }
+        else
+            sendStr( sock, "ERROR " + line + "\n" );
+    }
+
+    close( sock );
+}
+
+/* ---------------------------------------------------------------- */
+/* Tests ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+struct Done {
+    t_ull   headCt[2];
+    int     n;
+};
+
+
+static void SGLX_CALL fetchDone( void *ctx, t_ull headCt )
+{
+    Done    *D = static_cast<Done*>(ctx);
+
+    if( D->n < 2 )
+        D->headCt[D->n] = headCt;
+
+    ++D->n;
+}
+
+
+// Two FETCHes pipelined on one connection; the second reply breaks
+// off mid-binary. The first must complete, the second fail, and the
+// connection must be rebuilt before the next command, even in
+// session mode right after a completed reply.
+//
+static void testBrokenPipelinedFetch()
+{
+    int port,
+        lsock = listenAny( port );
+
+    std::thread server( [lsock]() {
+        serve( acceptWithin( lsock, 5000 ), 2 );    // breaks
+        serve( acceptWithin( lsock, 5000 ), 0 );    // reconnect
+    } );
+
+    void    *h = sglx_createHandle_std();
+
+    CHECK( sglx_connect( h, "127.0.0.1", port ) );
+    CHECK( sglx_setSessionMode( h, 60000 ) );
+
+    cppClient_sglx_fetch    io1, io2;
+    Done                    D = {{1, 1}, 0};
+
+    io1.js = io2.js = 2;
+    io1.ip = io2.ip = 0;
+    io1.max_samps = io2.max_samps = 4;
+
+    CHECK( sglx_fetchAsync( io1, h, 0, 0, fetchDone, &D ) );
+    CHECK( sglx_fetchAsync( io2, h, 0, 4, fetchDone, &D ) );
+
+    void    *hv[1] = {h};
+
+    for( int tries = 0; D.n < 2 && tries < 100; ++tries )
+        sglx_pollAsync( hv, 1, 100 );
+
+    CHECK( D.n == 2 );
+    CHECK( D.headCt[0] == 100 );
+    CHECK( D.headCt[1] == 0 );
+    CHECK( sglx_getStreamSampleCount( h, 2, 0 ) == 12345 );
+
+    sglx_close( h );
+    sglx_destroyHandle( h );
+    server.join();
+    close( lsock );
+}
+
+
+int main()
+{
+    testBrokenPipelinedFetch();
+
+    if( nFail )
+        fprintf( stderr, "%d check(s) failed.\n", nFail );
+    else
+        printf( "All checks passed.\n" );
+
+    return nFail ? 1 : 0;
+}
+
+
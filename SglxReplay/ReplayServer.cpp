@@ -0,0 +1,357 @@
+
+#include "ReplayServer.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <thread>
+
+
+#define VERSION "SglxReplay-1"
+
+
+
+
+ReplayServer::~ReplayServer()
+{
+    if( lsock >= 0 )
+        ::close( lsock );
+}
+
+
+std::string ReplayServer::listen( int port )
+{
+    if( (lsock = socket( AF_INET, SOCK_STREAM, 0 )) < 0 )
+        return "Can't create socket.";
+
+    int on = 1;
+    setsockopt( lsock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) );
+
+    struct sockaddr_in  addr;
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family         = AF_INET;
+    addr.sin_addr.s_addr    = htonl( INADDR_ANY );
+    addr.sin_port           = htons( port );
+
+    if( bind( lsock, (struct sockaddr*)&addr, sizeof(addr) ) < 0 )
+        return "Can't bind port " + std::to_string( port ) + ".";
+
+    if( ::listen( lsock, 16 ) < 0 )
+        return "Can't listen on port " + std::to_string( port ) + ".";
+
+    return "";
+}
+
+
+void ReplayServer::run()
+{
+    for(;;) {
+
+        int sock = accept( lsock, 0, 0 );
+
+        if( sock < 0 )
+            continue;
+
+        int on = 1;
+        setsockopt( sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on) );
+
+        std::thread( &ReplayServer::serve, this, sock ).detach();
+    }
+}
+
+
+void ReplayServer::serve( int sock )
+{
+    Conn        C;
+    std::string line;
+
+    C.sock = sock;
+
+    fprintf( stderr, "Client %d connected.\n", sock );
+
+    while( readLine( C, line ) ) {
+
+        if( !line.empty() && !command( C, line ) )
+            break;
+    }
+
+    fprintf( stderr, "Client %d disconnected.\n", sock );
+
+    ::close( sock );
+}
+
+
+// Return false if connection lost.
+//
+bool ReplayServer::command( Conn &C, const std::string &line )
+{
+    char        cmd[32] = {0};
+    int         js = 0, ip = 0, n = 0;
+    const char  *args;
+
+    sscanf( line.c_str(), "%31s%n", cmd, &n );
+    args = line.c_str() + n;
+
+    if( !strcmp( cmd, "NOOP" ) )
+        return reply( C, "OK\n" );
+
+    if( !strcmp( cmd, "GETVERSION" ) )
+        return reply( C, VERSION "\nOK\n" );
+
+    if( !strcmp( cmd, "GETSTREAMNP" ) ) {
+
+        int np = 0;
+
+        sscanf( args, "%d", &js );
+
+        for( int is = 0, ns = int(vS.size()); is < ns; ++is )
+            np += (vS[is]->getJS() == js);
+
+        return reply( C, std::to_string( np ) + "\nOK\n" );
+    }
+
+    if( !strcmp( cmd, "FETCH" ) )
+        return fetch( C, args );
+
+    if( !strcmp( cmd, "GETGEOMMAP" ) ) {
+
+        sscanf( args, "%d", &ip );
+        js = 2;
+    }
+    else if( 2 != sscanf( args, "%d %d", &js, &ip ) )
+        return reply( C, "ERROR " + std::string(cmd) + ": Unknown command or bad arguments.\n" );
+
+    ReplayStream    *S = stream( js, ip );
+
+    if( !S ) {
+        return reply( C, "ERROR " + std::string(cmd)
+                + ": No stream js=" + std::to_string( js )
+                + " ip=" + std::to_string( ip ) + ".\n" );
+    }
+
+    if( !strcmp( cmd, "GETSTREAMSAMPLERATE" ) ) {
+
+        char    s[64];
+        sprintf( s, "%.6f\nOK\n", S->sampleRate() );
+        return reply( C, s );
+    }
+
+    if( !strcmp( cmd, "GETSTREAMSAMPLECOUNT" ) )
+        return reply( C, std::to_string( S->sampleCount( clk ) ) + "\nOK\n" );
+
+    if( !strcmp( cmd, "GETSTREAMACQCHANS" ) ) {
+
+        const std::vector<int>  &v = S->acqChanCounts();
+        std::string             s;
+
+        for( int i = 0, n = int(v.size()); i < n; ++i )
+            s += (i ? " " : "") + std::to_string( v[i] );
+
+        return reply( C, s + "\nOK\n" );
+    }
+
+    if( !strcmp( cmd, "GETGEOMMAP" ) ) {
+
+        std::vector<std::string>    vL = S->geomMap();
+        std::string                 s;
+
+        if( vL.empty() )
+            return reply( C, "ERROR GETGEOMMAP: No geometry in metadata.\n" );
+
+        for( int i = 0, n = int(vL.size()); i < n; ++i )
+            s += vL[i] + "\n";
+
+        return reply( C, s + "OK\n" );
+    }
+
+    return reply( C, "ERROR " + std::string(cmd) + ": Unknown command.\n" );
+}
+
+
+// FETCH js ip start max chan#chan#... downsample
+//
+bool ReplayServer::fetch( Conn &C, const char *args )
+{
+    int     js, ip, maxSamps, ds, n;
+    t_ull   start;
+
+    if( 4 != sscanf( args, "%d %d %llu %d%n", &js, &ip, &start, &maxSamps, &n ) )
+        return reply( C, "ERROR FETCH: Bad arguments.\n" );
+
+    ReplayStream    *S = stream( js, ip );
+
+    if( !S )
+        return reply( C, "ERROR FETCH: No such stream.\n" );
+
+// Channel list: "c#c#...#", or "-1#" = all acquired, "-2#" = all saved.
+
+    const char  *p = args + n;
+
+    while( *p == ' ' )
+        ++p;
+
+    const char  *q = strchr( p, ' ' );
+
+    if( !q || 1 != sscanf( q, "%d", &ds ) || ds < 1 )
+        return reply( C, "ERROR FETCH: Bad arguments.\n" );
+
+    C.chans.clear();
+
+    while( p < q ) {
+
+        char    *end;
+        long    c = strtol( p, &end, 10 );
+
+        if( end == p )
+            break;
+
+        if( c < 0 ) {
+            for( int i = 0, nc = S->nAcqChans(); i < nc; ++i ) {
+                if( c == -1 || S->isSaved( i ) )
+                    C.chans.push_back( i );
+            }
+        }
+        else
+            C.chans.push_back( int(c) );
+
+        p = (*end == '#' ? end + 1 : end);
+    }
+
+    if( C.chans.empty() )
+        return reply( C, "ERROR FETCH: Empty channel list.\n" );
+
+// Range
+
+    S->noteRequested( start );
+
+    t_ull   count   = S->sampleCount( clk ),
+            oldest  = S->oldestScan( clk, count );
+    int     nsamps  = 0;
+
+    if( start < oldest )
+        return reply( C, "ERROR FETCH: Too late.\n" );
+
+    if( start < count ) {
+
+        t_ull   avail = (count - start + ds - 1) / ds;
+
+        nsamps = int(avail < t_ull(maxSamps) ? avail : maxSamps);
+    }
+
+    if( !S->columns( C.cols, &C.chans[0], int(C.chans.size()) ) )
+        return reply( C, "ERROR FETCH: Channel not in file.\n" );
+
+    C.data.resize( size_t(nsamps) * C.chans.size() );
+
+    if( nsamps )
+        S->gather( &C.data[0], C.cols, start, nsamps, ds );
+
+// Header, data and OK in one write
+
+    char    hdr[96];
+    int     nc = int(C.chans.size());
+
+    snprintf( hdr, sizeof(hdr), "BINARY_DATA %d %d uint64(%llu)\n", nc, nsamps, start );
+
+    struct iovec    iov[3];
+    iov[0].iov_base = hdr;
+    iov[0].iov_len  = strlen( hdr );
+    iov[1].iov_base = (nsamps ? &C.data[0] : 0);
+    iov[1].iov_len  = size_t(nsamps) * nc * sizeof(short);
+    iov[2].iov_base = (void*)"OK\n";
+    iov[2].iov_len  = 3;
+
+    return sendAll( C.sock, iov, 3 );
+}
+
+
+ReplayStream *ReplayServer::stream( int js, int ip ) const
+{
+    for( int is = 0, ns = int(vS.size()); is < ns; ++is ) {
+
+        if( vS[is]->getJS() == js && vS[is]->getIP() == ip )
+            return vS[is];
+    }
+
+    return 0;
+}
+
+
+// Return false if connection lost.
+//
+bool ReplayServer::readLine( Conn &C, std::string &line )
+{
+    for(;;) {
+
+        size_t  nl = C.rbuf.find( '\n' );
+
+        if( nl != std::string::npos ) {
+
+            line = C.rbuf.substr( 0, nl );
+            C.rbuf.erase( 0, nl + 1 );
+
+            if( !line.empty() && line.back() == '\r' )
+                line.pop_back();
+
+            return true;
+        }
+
+        char    buf[4096];
+        ssize_t n = recv( C.sock, buf, sizeof(buf), 0 );
+
+        if( n <= 0 )
+            return false;
+
+        C.rbuf.append( buf, n );
+    }
+}
+
+
+bool ReplayServer::reply( Conn &C, const std::string &s )
+{
+    struct iovec    iov;
+    iov.iov_base    = (void*)s.data();
+    iov.iov_len     = s.size();
+
+    return sendAll( C.sock, &iov, 1 );
+}
+
+
+bool ReplayServer::sendAll( int sock, const struct iovec *iov, int niov )
+{
+    std::vector<struct iovec>   v( iov, iov + niov );
+    int                         i = 0;
+
+    while( i < niov ) {
+
+        struct msghdr   msg;
+        memset( &msg, 0, sizeof(msg) );
+        msg.msg_iov     = &v[i];
+        msg.msg_iovlen  = niov - i;
+
+        ssize_t n = sendmsg( sock, &msg, MSG_NOSIGNAL );
+
+        if( n < 0 )
+            return false;
+
+        // advance past what was sent
+        while( i < niov && size_t(n) >= v[i].iov_len )
+            n -= v[i++].iov_len;
+
+        if( i < niov ) {
+            v[i].iov_base = (char*)v[i].iov_base + n;
+            v[i].iov_len -= n;
+        }
+    }
+
+    return true;
+}
+
+
@@ -0,0 +1,77 @@
+#ifndef REPLAYSERVER_H
+#define REPLAYSERVER_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include "ReplayStream.h"
+
+#include <string>
+#include <vector>
+
+/* ---------------------------------------------------------------- */
+/* ReplayServer --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Speaks the subset of the SpikeGLX remote command protocol that
+// SpikeMemory uses:
+//
+//      GETVERSION
+//      NOOP
+//      GETSTREAMNP js
+//      GETSTREAMSAMPLERATE js ip
+//      GETSTREAMSAMPLECOUNT js ip
+//      GETSTREAMACQCHANS js ip
+//      GETGEOMMAP ip
+//      FETCH js ip start max chan#chan#... downsample
+//
+// Each reply ends with "OK", or is a single "ERROR ..." line. FETCH
+// replies "BINARY_DATA nchans nsamps uint64(headCt)", the int16
+// data, then "OK". Asking for scans that have left the buffer gets
+// "ERROR FETCH: Too late.".
+//
+// Every client gets its own thread, so one connection per stream
+// works as it does with SpikeGLX.
+//
+class ReplayServer
+{
+private:
+    struct Conn {
+        std::string         rbuf;
+        std::vector<short>  data;
+        std::vector<int>    chans,
+                            cols;
+        int                 sock;
+    };
+
+    std::vector<ReplayStream*>  vS;
+    ReplayClock                 clk;
+    int                         lsock;
+
+public:
+    ReplayServer( const std::vector<ReplayStream*> &vS, const ReplayClock &clk )
+    :   vS(vS), clk(clk), lsock(-1) {}
+    virtual ~ReplayServer();
+
+    // Return error string, or "".
+    std::string listen( int port );
+
+    // Accept clients forever.
+    void run();
+
+private:
+    void serve( int sock );
+    bool command( Conn &C, const std::string &line );
+    bool fetch( Conn &C, const char *args );
+
+    ReplayStream *stream( int js, int ip ) const;
+
+    static bool readLine( Conn &C, std::string &line );
+    static bool reply( Conn &C, const std::string &s );
+    static bool sendAll( int sock, const struct iovec *iov, int niov );
+};
+
+#endif  // REPLAYSERVER_H
+
+
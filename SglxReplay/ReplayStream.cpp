@@ -0,0 +1,48 @@
+
+#include "ReplayStream.h"
+
+
+
+
+t_ull ReplayStream::sampleCount( const ReplayClock &clk ) const
+{
+    t_ull   count;
+
+    if( clk.speed > 0 ) {
+
+        double  t = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - clk.t0 ).count();
+
+        count = t_ull(t * sampleRate() * clk.speed);
+    }
+    else
+        count = maxAsked + t_ull(clk.bufSec * sampleRate());
+
+    if( !clk.loop && count > fileScans() )
+        count = fileScans();
+
+    // SpikeGLX reports zero only if the stream isn't running.
+    return (count ? count : 1);
+}
+
+
+t_ull ReplayStream::oldestScan( const ReplayClock &clk, t_ull count ) const
+{
+    if( clk.speed <= 0 )
+        return 0;
+
+    t_ull   buf = t_ull(clk.bufSec * sampleRate());
+
+    return (count > buf ? count - buf : 0);
+}
+
+
+void ReplayStream::noteRequested( t_ull start )
+{
+    t_ull   cur = maxAsked.load();
+
+    while( start > cur && !maxAsked.compare_exchange_weak( cur, start ) )
+        ;
+}
+
+
@@ -0,0 +1,61 @@
+#ifndef REPLAYSTREAM_H
+#define REPLAYSTREAM_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include "SglxFile.h"
+
+#include <atomic>
+#include <chrono>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// How replayed sample counts advance.
+// - speed  = multiple of real time; <= 0 means "max" (see below).
+// - bufSec = seconds of history the server holds, as SpikeGLX's
+//            stream buffer does; older scans can't be fetched.
+// - loop   = wrap to file start at end instead of stopping.
+//
+struct ReplayClock {
+    std::chrono::steady_clock::time_point   t0;
+    double                                  speed,
+                                            bufSec;
+    bool                                    loop;
+};
+
+/* ---------------------------------------------------------------- */
+/* ReplayStream --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// One recorded stream (SglxFile) played back against a ReplayClock.
+//
+// Timed replay: the sample count is (elapsed * rate * speed), so a
+// client sees data arrive as if acquisition began when the server
+// started. Scans older than the buffer window are gone.
+//
+// Max replay: data are released as fast as they're fetched. The
+// count always stands one buffer ahead of the furthest scan any
+// client has asked for, and nothing expires.
+//
+class ReplayStream : public SglxFile
+{
+private:
+    std::atomic<t_ull>  maxAsked;
+
+public:
+    ReplayStream( int ip ) : SglxFile(ip), maxAsked(0)  {}
+
+    t_ull sampleCount( const ReplayClock &clk ) const;
+    t_ull oldestScan( const ReplayClock &clk, t_ull count ) const;
+
+    // Max replay: note FETCH start, advancing the count.
+    void noteRequested( t_ull start );
+};
+
+#endif  // REPLAYSTREAM_H
+
+
@@ -0,0 +1,22 @@
+# Stand-in SpikeGLX server: replays recorded .bin/.meta files over
+# the SpikeGLX remote command protocol. Plain C++/POSIX; no Qt.
+
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle qt
+
+LIBS += -pthread
+
+# Recorded-file access is shared with SpikeMemory.
+INCLUDEPATH += ../SpikeMemory
+
+SOURCES += \
+    ../SpikeMemory/SglxFile.cpp \
+    ReplayServer.cpp \
+    ReplayStream.cpp \
+    main.cpp
+
+HEADERS += \
+    ../SpikeMemory/SglxFile.h \
+    ReplayServer.h \
+    ReplayStream.h
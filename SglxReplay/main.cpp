@@ -0,0 +1,112 @@
+
+#include "ReplayServer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+
+static void usage()
+{
+    fprintf( stderr,
+    "Usage: SglxReplay [options] file.bin [file.bin ...]\n"
+    "\n"
+    "Serve SpikeGLX recordings over the SpikeGLX remote protocol.\n"
+    "Each file needs its .meta alongside. Stream is set by name:\n"
+    "    *.nidq.bin         -> js=0, ip=0\n"
+    "    *.obxN.obx.bin     -> js=1, ip in order given\n"
+    "    *.imecN.ap.bin     -> js=2, ip in order given\n"
+    "\n"
+    "Options:\n"
+    "    -port=N      TCP port (default 4142)\n"
+    "    -speed=X     replay at X times real time (default 1),\n"
+    "                 or 'max' to release data as fast as fetched\n"
+    "    -buffer=S    seconds of history held (default 4)\n"
+    "    -loop        wrap to start at end of file\n" );
+}
+
+
+int main( int argc, char *argv[] )
+{
+    ReplayClock                 clk;
+    std::vector<ReplayStream*>  vS;
+    int                         port    = 4142,
+                                nOB     = 0,
+                                nIM     = 0;
+
+    clk.speed   = 1;
+    clk.bufSec  = 4;
+    clk.loop    = false;
+
+    for( int i = 1; i < argc; ++i ) {
+
+        const char  *a = argv[i];
+
+        if( !strncmp( a, "-port=", 6 ) )
+            port = atoi( a + 6 );
+        else if( !strncmp( a, "-speed=", 7 ) )
+            clk.speed = (!strcmp( a + 7, "max" ) ? 0 : atof( a + 7 ));
+        else if( !strncmp( a, "-buffer=", 8 ) )
+            clk.bufSec = atof( a + 8 );
+        else if( !strcmp( a, "-loop" ) )
+            clk.loop = true;
+        else if( a[0] == '-' ) {
+            usage();
+            return 1;
+        }
+        else {
+
+            std::string     f = a;
+            ReplayStream    *S;
+
+            switch( SglxFile::streamOf( f ) ) {
+                case 0:  S = new ReplayStream( 0 ); break;
+                case 1:  S = new ReplayStream( nOB++ ); break;
+                case 2:  S = new ReplayStream( nIM++ ); break;
+                default:
+                    fprintf( stderr, "Unrecognized stream type: %s\n", a );
+                    return 1;
+            }
+
+            std::string err = S->open( f );
+
+            if( !err.empty() ) {
+                fprintf( stderr, "%s\n", err.c_str() );
+                return 1;
+            }
+
+            fprintf( stderr, "js=%d ip=%d  %.3f Hz  %llu scans  %s\n",
+                S->getJS(), S->getIP(), S->sampleRate(),
+                S->fileScans(), a );
+
+            vS.push_back( S );
+        }
+    }
+
+    if( vS.empty() || clk.bufSec <= 0 ) {
+        usage();
+        return 1;
+    }
+
+    clk.t0 = std::chrono::steady_clock::now();
+
+    ReplayServer    srv( vS, clk );
+    std::string     err = srv.listen( port );
+
+    if( !err.empty() ) {
+        fprintf( stderr, "%s\n", err.c_str() );
+        return 1;
+    }
+
+    fprintf( stderr, "Listening on port %d, speed %s.\n",
+        port, clk.speed > 0 ? std::to_string( clk.speed ).c_str() : "max" );
+
+    srv.run();
+
+    return 0;
+}
+
+
@@ -0,0 +1,286 @@
+
+#include "AcqThread.h"
+#include "SglxApi.h"
+
+#include <QThread>
+
+#include <algorithm>
+#include <chrono>
+
+
+/* ---------------------------------------------------------------- */
+/* AcqWorker ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+AcqWorker::AcqWorker(
+    const std::vector<AcqStream>    &vS,
+    int                             periodMS,
+    bool                            live )
+    :   QObject(0), vS(vS), periodMS(periodMS), live(live),
+        pleaseStop(false)
+{
+// Half the ring per read leaves the consumer room to work
+
+    for( int is = 0, ns = int(this->vS.size()); is < ns; ++is ) {
+
+        AcqStream   &S = this->vS[is];
+
+        S.maxScans = std::min( S.maxScans, S.ring->capacity() / 2 );
+    }
+}
+
+
+AcqWorker::~AcqWorker()
+{
+    for( int is = 0, ns = int(vS.size()); is < ns; ++is )
+        delete vS[is].reader;
+}
+
+
+void AcqWorker::run()
+{
+    while( !pleaseStop ) {
+
+        if( !live ) {
+
+            int got = readAll();
+
+            if( got < 0 )
+                QThread::msleep( periodMS );    // all at end
+            else if( !got )
+                QThread::msleep( 1 );           // consumer behind
+
+            continue;
+        }
+
+        auto    t0 = std::chrono::steady_clock::now();
+
+        fetchAll();
+
+        int dt = int(std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - t0 ).count());
+
+        if( dt < periodMS )
+            QThread::msleep( periodMS - dt );
+    }
+
+    emit finished();
+}
+
+
+// Live pass over all streams. The first block of every stream that
+// can post() is requested up front, so the replies travel while we
+// wait on all the connections at once. Once every request is in, each
+// such stream is completed and, if still behind, caught up with
+// ordinary reads; the remaining streams are read as before.
+//
+void AcqWorker::fetchAll()
+{
+    enum { Sync, Posted, Full };
+
+    int                         ns = int(vS.size());
+    std::vector<int>            vState( ns, Sync );
+    std::vector<SampleBlock*>   vB( ns );
+    std::vector<void*>          vH;
+    int                         nOut = 0;
+
+    for( int is = 0; is < ns; ++is ) {
+
+        AcqStream   &S = vS[is];
+        void        *h = S.reader->connection();
+
+        if( !h )
+            continue;
+
+        if( !(vB[is] = S.ring->reserve( S.maxScans )) ) {
+            noteFull( S );
+            vState[is] = Full;
+        }
+        else if( S.reader->post( vB[is], S.maxScans ) ) {
+
+            vState[is] = Posted;
+            ++nOut;
+
+            if( std::find( vH.begin(), vH.end(), h ) == vH.end() )
+                vH.push_back( h );
+        }
+        else
+            S.ring->commit( 0 );
+    }
+
+// Every reply, or else the connections give up, so that nothing is
+// left in flight when the readers next talk to them.
+
+    auto    t0 = std::chrono::steady_clock::now();
+
+    while( nOut > 0 ) {
+
+        int nDone = sglx_pollAsync( &vH[0], int(vH.size()), periodMS );
+
+        if( nDone > 0 )
+            nOut -= nDone;
+        else if( nDone < 0
+                || pleaseStop
+                || std::chrono::steady_clock::now() - t0
+                    > std::chrono::milliseconds( replyTimeoutMS ) ) {
+
+            for( int ih = 0, nh = int(vH.size()); ih < nh; ++ih )
+                sglx_cancelAsync( vH[ih] );
+
+            break;
+        }
+    }
+
+    for( int is = 0; is < ns; ++is ) {
+
+        AcqStream   &S = vS[is];
+
+        if( vState[is] == Posted ) {
+
+            int nscans = S.reader->finish( vB[is], S.maxScans );
+
+            S.ring->commit( std::max( nscans, 0 ) );
+            noteRead( S );
+
+            if( nscans > 0 && S.reader->next() < S.reader->sourceCount() )
+                fetchStream( S, catchUpBlocks - 1 );
+        }
+        else if( vState[is] == Sync )
+            fetchStream( S, catchUpBlocks );
+    }
+}
+
+
+// Fetch new scans from stream S into its ring, in blocks of at most
+// (maxScans). The reader fills each reserved ring block directly.
+// While the reader reports more at the source, keep going, up to
+// (nBlocks) blocks.
+//
+// If the ring has no room, the scans stay at the source and we
+// get them next pass. The reader flags any gap in the block.
+//
+void AcqWorker::fetchStream( AcqStream &S, int nBlocks )
+{
+    for( int ib = 0; ib < nBlocks; ++ib ) {
+
+        SampleBlock *B = S.ring->reserve( S.maxScans );
+
+        if( !B ) {
+            noteFull( S );
+            return;
+        }
+
+        int nscans = S.reader->read( B, S.maxScans );
+
+        S.ring->commit( std::max( nscans, 0 ) );
+        noteRead( S );
+
+        if( nscans <= 0 || S.reader->next() >= S.reader->sourceCount() )
+            return;
+    }
+}
+
+
+void AcqWorker::noteFull( AcqStream &S )
+{
+    S.ring->noteOverrun();
+
+    if( S.stats )
+        ++S.stats->ringFull;
+}
+
+
+void AcqWorker::noteRead( AcqStream &S )
+{
+    if( !S.stats )
+        return;
+
+    AcqStats    &St = *S.stats;
+
+    St.sourceCt = std::max( S.reader->sourceCount(), S.reader->next() );
+    St.readCt   = S.reader->next();
+    St.skipped  = S.reader->lost();
+    St.gaps     = S.reader->gaps();
+}
+
+
+// Not live: read one block into every ring, but only if all of them
+// have room, so no stream gets ahead of the others.
+//
+int AcqWorker::readAll()
+{
+    int ns      = int(vS.size()),
+        nEnd    = 0;
+
+    std::vector<SampleBlock*>   vB( ns );
+
+    for( int is = 0; is < ns; ++is ) {
+
+        AcqStream   &S = vS[is];
+
+        if( S.reader->atEnd() ) {
+            ++nEnd;
+            continue;
+        }
+
+        if( !(vB[is] = S.ring->reserve( S.maxScans )) )
+            return 0;
+    }
+
+    if( nEnd == ns )
+        return -1;
+
+    bool    got = false;
+
+    for( int is = 0; is < ns; ++is ) {
+
+        if( !vB[is] )
+            continue;
+
+        AcqStream   &S  = vS[is];
+        int         n   = S.reader->read( vB[is], S.maxScans );
+
+        S.ring->commit( std::max( n, 0 ) );
+        noteRead( S );
+        got = got || n > 0;
+    }
+
+    return got ? 1 : -1;
+}
+
+/* ---------------------------------------------------------------- */
+/* AcqThread ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+AcqThread::AcqThread(
+    const std::vector<AcqStream>    &vS,
+    int                             periodMS,
+    bool                            live )
+{
+    thread  = new QThread;
+    worker  = new AcqWorker( vS, periodMS, live );
+
+    worker->moveToThread( thread );
+
+    QObject::connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+    QObject::connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
+    QObject::connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+
+    thread->start();
+}
+
+
+AcqThread::~AcqThread()
+{
+// worker object auto-deleted asynchronously
+// thread object manually deleted synchronously (so we can call wait())
+
+    worker->stop();
+
+    if( thread->isRunning() )
+        thread->wait( 20000 );
+
+    delete thread;
+}
+
+
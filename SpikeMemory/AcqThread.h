@@ -0,0 +1,152 @@
+#ifndef ACQTHREAD_H
+#define ACQTHREAD_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include "DataSource.h"
+
+#include <QObject>
+
+#include <atomic>
+#include <vector>
+
+class QThread;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Health of one stream, for telling data that never came from the
+// probe from data SpikeMemory failed to keep up with. Scan counts are
+// stream indices (headCt units).
+// - sourceCt = latest scan count known at the source.
+// - readCt   = everything below was read (or skipped).
+// - doneCt   = everything below was processed; set by the consumer.
+// - skipped  = scans lost in gaps.
+// - gaps     = gap events.
+// - ringFull = live reads put off because the consumer was behind.
+//
+// Written by the acquisition thread (doneCt by the processing side)
+// and readable from any thread.
+//
+struct AcqStats {
+    std::atomic<t_ull>  sourceCt,
+                        readCt,
+                        doneCt,
+                        skipped,
+                        gaps,
+                        ringFull;
+    const double        srate;
+
+    AcqStats( double srate )
+    :   sourceCt(0), readCt(0), doneCt(0), skipped(0), gaps(0),
+        ringFull(0), srate(srate)   {}
+
+    // Scans at the source not yet processed; none before first read.
+    t_ull lagScans() const
+        {t_ull s = sourceCt, d = doneCt; return (d && s > d ? s - d : 0);}
+    double lagMS() const    {return 1000.0 * lagScans() / srate;}
+};
+
+// One stream serviced by the acquisition thread.
+// - reader   = scan source; owned by AcqWorker once handed over.
+// - ring     = destination for scans.
+// - stats    = counters to keep up to date; not owned; may be 0.
+// - maxScans = most scans to move per read.
+//
+struct AcqStream {
+    StreamReader    *reader;
+    SampleRing      *ring;
+    AcqStats        *stats;
+    int             maxScans;
+};
+
+/* ---------------------------------------------------------------- */
+/* AcqWorker ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Owns the read loop, so nothing on the GUI thread can stall it.
+//
+// Live: every (periodMS) it pulls whatever is new from each stream
+// and commits it to that stream's ring. Streams on SpikeGLX have
+// their fetches in flight together (sglx_fetchAsync), so a pass
+// costs about one round trip rather than one per stream. A stream
+// that has fallen behind is drained in blocks of at most (maxScans),
+// up to (catchUpBlocks) of them per pass, so a backlog clears quickly
+// without one stream holding up the others. If a ring is full the
+// scans stay at the source; whatever expires there meanwhile is lost
+// and flagged as a gap.
+//
+// Not live: it reads a block from every stream whenever all rings
+// have room, and otherwise waits. Streams stay aligned in time to
+// within the ring depth, nothing is dropped, and throughput is set
+// by the consumer.
+//
+// The worker has exclusive use of its readers' connections.
+//
+class AcqWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    enum {
+        catchUpBlocks   = 4,
+        replyTimeoutMS  = 10000
+    };
+
+    std::vector<AcqStream>  vS;
+    int                     periodMS;
+    bool                    live;
+    std::atomic<bool>       pleaseStop;
+
+public:
+    AcqWorker(
+        const std::vector<AcqStream>    &vS,
+        int                             periodMS,
+        bool                            live );
+    virtual ~AcqWorker();
+
+    void stop()     {pleaseStop = true;}
+
+    // Not live: one read pass, as run() makes it. Callers that want
+    // no thread at all (batch processing) use the worker directly
+    // and call this between processing passes.
+    // Return 1 if any scans were read, 0 if a ring was full, -1 if
+    // every reader is at its end.
+    int readAll();
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+
+private:
+    void fetchAll();
+    void fetchStream( AcqStream &S, int nBlocks );
+    void noteFull( AcqStream &S );
+    void noteRead( AcqStream &S );
+};
+
+/* ---------------------------------------------------------------- */
+/* AcqThread ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+class AcqThread
+{
+public:
+    QThread     *thread;
+    AcqWorker   *worker;
+public:
+    AcqThread(
+        const std::vector<AcqStream>    &vS,
+        int                             periodMS,
+        bool                            live );
+    virtual ~AcqThread();
+};
+
+#endif  // ACQTHREAD_H
+
+
@@ -0,0 +1,328 @@
+
+#include "BatchReprocess.h"
+#include "DataSource.h"
+#include "spikevm.h"
+
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+
+/* ---------------------------------------------------------------- */
+/* BatchWorker ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void BatchWorker::run()
+{
+    int ns = int(B.vShard.size()),
+        is;
+
+    while( (is = B.nextShard++) < ns )
+        B.doShard( is );
+
+    emit finished();
+}
+
+/* ---------------------------------------------------------------- */
+/* BatchThread ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+BatchThread::BatchThread( BatchReprocess &B )
+{
+    thread  = new QThread;
+    worker  = new BatchWorker( B );
+
+    worker->moveToThread( thread );
+
+    QObject::connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+    QObject::connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
+    QObject::connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+
+    thread->start();
+}
+
+
+BatchThread::~BatchThread()
+{
+// worker object auto-deleted asynchronously
+// thread object manually deleted synchronously (so we can call wait());
+// no timeout: a worker is done only when the shards are
+
+    if( thread->isRunning() )
+        thread->wait();
+
+    delete thread;
+}
+
+/* ---------------------------------------------------------------- */
+/* BatchReprocess ------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+BatchReprocess::BatchReprocess(
+    const std::vector<std::string>  &paths,
+    const BatchParams               &P )
+    :   paths(paths), P(P), nextShard(0), srateNI(0), recSec(0)
+{
+}
+
+
+bool BatchReprocess::run()
+{
+    {
+        FileSource  src( paths );
+
+        if( !src.open() ) {
+            err = src.error();
+            return false;
+        }
+
+        recSec = src.seconds();
+
+        for( int ip = 0, np = src.nProbes(); ip < np; ++ip )
+            srateIM.push_back( src.sampleRate( 2, ip ) );
+
+        srateNI = src.sampleRate( 0, 0 );
+    }
+
+    if( P.shardSec <= 0 || recSec <= 0 ) {
+        err = "Nothing to process.";
+        return false;
+    }
+
+    if( !estimateMix() )
+        return false;
+
+    int nShards     = int(std::ceil( recSec / P.shardSec )),
+        nThreads    = (P.nThreads > 0 ? P.nThreads : QThread::idealThreadCount());
+
+    vShard.assign( nShards, Shard() );
+    nextShard = 0;
+
+    {
+        std::vector<BatchThread*>   vT;
+
+        for( int it = 0, nt = std::max( 1, std::min( nThreads, nShards ) ); it < nt; ++it )
+            vT.push_back( new BatchThread( *this ) );
+
+        for( int it = 0, nt = int(vT.size()); it < nt; ++it )
+            delete vT[it];
+    }
+
+// Merge in shard order
+
+    spikes.clear();
+    events.clear();
+
+    for( int is = 0; is < nShards; ++is ) {
+
+        Shard   &S = vShard[is];
+
+        if( !S.err.empty() ) {
+            err = S.err;
+            return false;
+        }
+
+        spikes.insert( spikes.end(), S.vS.begin(), S.vS.end() );
+        events.insert( events.end(), S.vE.begin(), S.vE.end() );
+        S = Shard();
+    }
+
+    return true;
+}
+
+
+bool BatchReprocess::writeSpikes( const std::string &path ) const
+{
+    FILE    *f = fopen( path.c_str(), "w" );
+
+    if( !f )
+        return false;
+
+    fprintf( f, "scan,time_ms,probe,channel\n" );
+
+    for( int i = 0, n = int(spikes.size()); i < n; ++i ) {
+
+        const BatchSpike    &S = spikes[i];
+
+        fprintf( f, "%llu,%.3f,%d,%d\n",
+            S.scan, S.scan * 1000.0 / srateIM[S.probe], S.probe, S.chan );
+    }
+
+    return 0 == fclose( f );
+}
+
+
+bool BatchReprocess::writeEvents( const std::string &path ) const
+{
+    FILE    *f = fopen( path.c_str(), "w" );
+
+    if( !f )
+        return false;
+
+    fprintf( f, "scan,time_ms,type\n" );
+
+    for( int i = 0, n = int(events.size()); i < n; ++i ) {
+
+        const BatchEvent    &E = events[i];
+
+        fprintf( f, "%llu,%.3f,%d\n",
+            E.scan, E.scan * 1000.0 / srateNI, E.type );
+    }
+
+    return 0 == fclose( f );
+}
+
+
+void BatchReprocess::applyParams( SpikeVM &vm ) const
+{
+    vm.queued_absolute_threshold_imec   = P.absThresh;
+    vm.queued_rms_threshold_imec        = P.rmsThresh;
+    vm.queued_neo_threshold_imec        = P.neoThresh;
+    vm.queued_detect_mode               = P.detectMode;
+    vm.queued_dedup_spikes              = P.dedup;
+    vm.queued_reference_mode            = P.refMode;
+    vm.queued_reference_per_shank       = P.refPerShank;
+    vm.queued_mix_mode                  = P.mixMode;
+    vm.queued_float_pipeline            = P.float32;
+    vm.queued_fixed_point_filter        = P.fixedPoint;
+}
+
+
+// Run a SpikeVM from the start of the recording just until each
+// probe's whitening estimate is done (mixEstimateSeconds), and keep
+// the matrices. A probe with nothing to whiten keeps an empty one
+// and passes through.
+//
+bool BatchReprocess::estimateMix()
+{
+    mixW.clear();
+
+    if( P.mixMode == mix_none )
+        return true;
+
+    FileSource  *src = new FileSource( paths );
+    SpikeVM     vm( 0, src, false, false );
+
+    if( !vm.connected ) {
+        err = src->error();
+        return false;
+    }
+
+    applyParams( vm );
+
+    for(;;) {
+
+        bool    more    = vm.processBatchStep(),
+                done    = true;
+
+        for( int ip = 0; ip < vm.num_probes; ++ip )
+            done &= !vm.imec_mixers[ip]->estimating();
+
+        if( done )
+            break;
+
+        if( !more ) {
+            err = "Recording too short to estimate whitening.";
+            return false;
+        }
+    }
+
+    for( int ip = 0; ip < vm.num_probes; ++ip )
+        mixW.push_back( vm.imec_mixers[ip]->matrix() );
+
+    return true;
+}
+
+
+// Shard (is) owns [t0, t1). Its SpikeVM starts (warmupSec) earlier;
+// detections in the warm-up are dropped. Each stream converts t0 and
+// t1 to scans the same way in adjacent shards, so every scan is
+// owned by exactly one shard.
+//
+// It also reads (tailSec) past t1, so a spike just before t1 is
+// deduplicated against the next shard's spikes within the dedup
+// window, whose amplitudes need their waveforms; what it detects
+// there belongs to the next shard and is dropped too.
+//
+void BatchReprocess::doShard( int is )
+{
+    // Dedup window + waveform half-width, plus a margin.
+    const double    tailSec = (SpikeVM::dedupWindowMs + SpikeVM::waveformHalfMs + .5) / 1000;
+
+    Shard       &S  = vShard[is];
+    double      t0  = is * P.shardSec,
+                t1  = (is == int(vShard.size()) - 1 ? recSec : t0 + P.shardSec);
+    FileSource  *src = new FileSource( paths );
+
+    src->setWindow(
+        std::max( 0.0, t0 - P.warmupSec ),
+        std::min( recSec, t1 + tailSec ) );
+
+    SpikeVM vm( 0, src, false, false );
+
+    if( !vm.connected ) {
+        S.err = src->error();
+        return;
+    }
+
+    applyParams( vm );
+    vm.fixed_mix_matrices = mixW;
+
+    while( vm.processBatchStep() )
+        ;
+
+// Spikes
+
+    for( int ip = 0; ip < vm.num_probes; ++ip ) {
+
+        t_ull   lo  = src->scanAt( 2, ip, t0 ),
+                hi  = src->scanAt( 2, ip, t1 );
+
+        for( int ch = 0, nc = int(vm.spike_scan_nums[ip].size()); ch < nc; ++ch ) {
+
+            const std::vector<t_ull>    &v = vm.spike_scan_nums[ip][ch];
+
+            for( int i = 0, n = int(v.size()); i < n; ++i ) {
+
+                if( v[i] >= lo && v[i] < hi )
+                    S.vS.push_back( {v[i], ip, ch} );
+            }
+        }
+    }
+
+    std::sort( S.vS.begin(), S.vS.end(),
+        []( const BatchSpike &a, const BatchSpike &b ) {
+            if( a.scan != b.scan )
+                return a.scan < b.scan;
+            if( a.probe != b.probe )
+                return a.probe < b.probe;
+            return a.chan < b.chan;
+        } );
+
+// Events
+
+    t_ull   lo  = src->scanAt( 0, 0, t0 ),
+            hi  = src->scanAt( 0, 0, t1 );
+
+    for( int it = 0, nt = int(vm.event_scan_nums.size()); it < nt; ++it ) {
+
+        const std::vector<t_ull>    &v = vm.event_scan_nums[it];
+
+        for( int i = 0, n = int(v.size()); i < n; ++i ) {
+
+            if( v[i] >= lo && v[i] < hi )
+                S.vE.push_back( {v[i], it} );
+        }
+    }
+
+    std::sort( S.vE.begin(), S.vE.end(),
+        []( const BatchEvent &a, const BatchEvent &b ) {
+            if( a.scan != b.scan )
+                return a.scan < b.scan;
+            return a.type < b.type;
+        } );
+}
+
+
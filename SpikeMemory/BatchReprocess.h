@@ -0,0 +1,183 @@
+#ifndef BATCHREPROCESS_H
+#define BATCHREPROCESS_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include "SglxApi.h"
+#include "ChannelMixer.h"
+#include "Referencer.h"
+#include "SpikeDetector.h"
+
+#include <QObject>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+class QThread;
+class BatchReprocess;
+class SpikeVM;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Spike on acquired channel (chan) of probe (probe) at imec scan
+// (scan), counted from the start of the file.
+//
+struct BatchSpike {
+    t_ull   scan;
+    int     probe,
+            chan;
+};
+
+// Event of SpikeVM event type (type) at NI scan (scan).
+//
+struct BatchEvent {
+    t_ull   scan;
+    int     type;
+};
+
+// - shardSec   = recording seconds per shard.
+// - warmupSec  = seconds processed ahead of each shard (and thrown
+//                away) to settle filter state and baseline stats.
+// - nThreads   = worker threads; 0 = one per core.
+// - detectMode,
+//   thresholds,
+//   dedup,
+//   referencing,
+//   whitening,
+//   float32,
+//   fixedPoint = as in SpikeVM.
+//
+struct BatchParams {
+    double      shardSec,
+                warmupSec,
+                absThresh,
+                rmsThresh,
+                neoThresh;
+    int         nThreads;
+    DetectMode  detectMode;
+    RefMode     refMode;
+    MixMode     mixMode;
+    bool        dedup,
+                refPerShank,
+                float32,
+                fixedPoint;
+
+    BatchParams()
+    :   shardSec(60), warmupSec(3), absThresh(20), rmsThresh(5),
+        neoThresh(10), nThreads(0), detectMode(detect_absolute),
+        refMode(ref_none), mixMode(mix_none), dedup(false),
+        refPerShank(false), float32(false), fixedPoint(false)  {}
+};
+
+/* ---------------------------------------------------------------- */
+/* BatchWorker ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Takes shards from its BatchReprocess until none are left.
+//
+class BatchWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    BatchReprocess  &B;
+
+public:
+    BatchWorker( BatchReprocess &B ) : QObject(0), B(B)    {}
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+};
+
+/* ---------------------------------------------------------------- */
+/* BatchThread ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+class BatchThread
+{
+public:
+    QThread     *thread;
+    BatchWorker *worker;
+public:
+    BatchThread( BatchReprocess &B );
+    virtual ~BatchThread();
+};
+
+/* ---------------------------------------------------------------- */
+/* BatchReprocess ------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Offline reprocessing of a recording, faster than real time.
+//
+// The recording is cut into time shards, each run through its own
+// SpikeVM on a FileSource windowed to that shard. A shard starts
+// (warmupSec) early so the Biquad state and baseline estimators
+// have settled by the time its own data begin; whatever it detects
+// in the warm-up belongs to the previous shard and is dropped.
+//
+// Whitening is estimated once, from the start of the recording,
+// and every shard mixes with that matrix, so shards detect alike
+// and none runs unwhitened while it would be estimating its own.
+//
+// Shards are independent, so a pool of threads takes them in turn.
+// Each shard keeps its own logs; run() concatenates them in shard
+// order, which gives spikes and events sorted by time.
+//
+class BatchReprocess
+{
+    friend class BatchWorker;
+
+private:
+    struct Shard {
+        std::vector<BatchSpike> vS;
+        std::vector<BatchEvent> vE;
+        std::string             err;
+    };
+
+    std::vector<std::string>    paths;
+    BatchParams                 P;
+    std::vector<Shard>          vShard;
+    std::vector<double>         srateIM;
+    std::vector<std::vector<float> >
+                                mixW;   // per probe, for every shard
+    std::atomic<int>            nextShard;
+    double                      srateNI,
+                                recSec;
+    std::string                 err;
+
+public:
+    std::vector<BatchSpike>     spikes;
+    std::vector<BatchEvent>     events;
+
+public:
+    BatchReprocess(
+        const std::vector<std::string>  &paths,
+        const BatchParams               &P );
+
+    // Process everything; blocks until done.
+    // On failure return false and set error().
+    bool run();
+
+    const std::string &error() const    {return err;}
+
+    // CSV logs: "scan,time_ms,probe,channel" and "scan,time_ms,type".
+    bool writeSpikes( const std::string &path ) const;
+    bool writeEvents( const std::string &path ) const;
+
+private:
+    void applyParams( SpikeVM &vm ) const;
+    bool estimateMix();
+    void doShard( int is );
+};
+
+#endif  // BATCHREPROCESS_H
+
+
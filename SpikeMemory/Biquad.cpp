@@ -17,9 +17,12 @@
 //
 
 #include "Biquad.h"
+#include "BiquadSimd.h"
 
 #include <QThread>
 
+#include <algorithm>
+
 #include <math.h>
 #include <string.h>
 
@@ -32,77 +35,173 @@
 /* Threading helpers ---------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-static Biquad   *ME;
+class BiquadPoolThread : public QThread
+{
+private:
+    BiquadPool  &P;
+public:
+    BiquadPoolThread( BiquadPool &P ) : P(P)    {}
+protected:
+    void run()  {P.serve();}
+};
+
 
-void BiquadWorker::run()
+BiquadPool::BiquadPool( int nThreads )
+    :   tasks(0), nTasks(0), nextTask(0), nBusy(0), quit(false)
 {
-    double  Y   = 1.0 / maxInt,
-            A0  = ME->a0,
-            A1  = ME->a1,
-            A2  = ME->a2,
-            B1  = ME->b1,
-            B2  = ME->b2;
+    for( int i = 0; i < nThreads; ++i ) {
 
-    for( int it = 0; it < ntpts; ++it, data += nchans ) {
+        QThread *T = new BiquadPoolThread( *this );
 
-        for( int c = cFirst; c < cLim; ++c ) {
+        vT.push_back( T );
+        T->start();
+    }
+}
 
-            double  in  = data[c] * Y,
-                    z1  = ME->vz1[c - c0],
-                    z2  = ME->vz2[c - c0],
-                    out = in * A0 + z1;
 
-            z1 = in * A1 + z2 - B1 * out;
-            z2 = in * A2 - B2 * out;
+BiquadPool::~BiquadPool()
+{
+    mtx.lock();
+    quit = true;
+    work.wakeAll();
+    mtx.unlock();
+
+    for( int i = 0, n = int(vT.size()); i < n; ++i ) {
+        vT[i]->wait();
+        delete vT[i];
+    }
+}
 
-            data[c] = qBound( -maxInt, int(out * maxInt), maxInt - 1 );
 
-            ME->vz1[c - c0] = z1;
-            ME->vz2[c - c0] = z2;
-        }
+void BiquadPool::run( const std::vector<BiquadTask> &vTask )
+{
+    if( vTask.empty() )
+        return;
+
+    QMutexLocker    ml( &mtx );
+
+    tasks       = &vTask[0];
+    nTasks      = int(vTask.size());
+    nextTask    = 0;
+    nBusy       = 0;
+
+    if( !vT.empty() )
+        work.wakeAll();
+
+// The final worker is me, the calling thread
+
+    while( nextTask < nTasks ) {
+
+        const BiquadTask    &T = tasks[nextTask++];
+
+        ++nBusy;
+        ml.unlock();
+        exec( T );
+        ml.relock();
+        --nBusy;
     }
 
-    emit finished();
+    while( nBusy )
+        done.wait( &mtx );
+
+    tasks   = 0;
+    nTasks  = 0;
 }
 
-BiquadThread::BiquadThread(
-    short   *data,
-    int     maxInt,
-    int     ntpts,
-    int     nchans,
-    int     c0,
-    int     cFirst,
-    int     cLim )
+
+void BiquadPool::serve()
+{
+    QMutexLocker    ml( &mtx );
+
+    for(;;) {
+
+        while( !quit && nextTask >= nTasks )
+            work.wait( &mtx );
+
+        if( quit )
+            return;
+
+        const BiquadTask    &T = tasks[nextTask++];
+
+        ++nBusy;
+        ml.unlock();
+        exec( T );
+        ml.relock();
+
+        if( !--nBusy && nextTask >= nTasks )
+            done.wakeAll();
+    }
+}
+
+
+void BiquadPool::exec( const BiquadTask &T )
+{
+    if( T.fdata ) {
+        T.F->applyRangeF(
+            T.fdata, T.ntpts, T.nchans,
+            T.c0, T.cFirst, T.cLim );
+    }
+    else {
+        T.F->applyRange(
+            T.data, T.maxInt, T.ntpts, T.nchans,
+            T.c0, T.cFirst, T.cLim );
+    }
+}
+
+
+void BiquadPool::addTasks(
+    std::vector<BiquadTask> &vTask,
+    BiquadFilter            *F,
+    short                   *data,
+    int                     maxInt,
+    int                     ntpts,
+    int                     nchans,
+    int                     c0,
+    int                     cLim,
+    int                     nParts )
 {
-    thread  = new QThread;
-    worker  = new BiquadWorker(
-                    data, maxInt, ntpts,
-                    nchans, c0, cFirst, cLim );
-
-    worker->moveToThread( thread );
-
-    //QG note: BK has a error-checking form of QObject::connect that he uses here.
-    //It's good practice and we should emulate at a later point.
-    //His method applies a STR2CHR to the signal and slot. Do we need this?
-//    Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
-//    Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
-//    Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
-    QObject::connect(thread, SIGNAL(started()), worker, SLOT(run()) );
-    QObject::connect(worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
-    QObject::connect(worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
-
-    thread->start();
+    addSlices( vTask,
+        {F, data, 0, maxInt, ntpts, nchans, c0, c0, cLim}, nParts );
 }
 
-BiquadThread::~BiquadThread()
+
+void BiquadPool::addTasks(
+    std::vector<BiquadTask> &vTask,
+    BiquadFilter            *F,
+    float                   *data,
+    int                     ntpts,
+    int                     nchans,
+    int                     c0,
+    int                     cLim,
+    int                     nParts )
 {
-// worker object auto-deleted asynchronously
-// thread object manually deleted synchronously (so we can call wait())
+    addSlices( vTask,
+        {F, 0, data, 0, ntpts, nchans, c0, c0, cLim}, nParts );
+}
+
+
+// Cut (T)'s channels [c0,cLim) into slices.
+//
+void BiquadPool::addSlices(
+    std::vector<BiquadTask> &vTask,
+    const BiquadTask        &T,
+    int                     nParts )
+{
+    if( T.cLim <= T.c0 || T.ntpts <= 0 )
+        return;
+
+    int cPer = (T.cLim - T.c0 + nParts - 1) / std::max( nParts, 1 );
+
+    cPer = std::max( 32, (cPer + 15) & ~15 );
 
-    if( thread->isRunning() )
-        thread->wait( 20000 );
+    for( int cFirst = T.c0; cFirst < T.cLim; cFirst += cPer ) {
 
-    delete thread;
+        BiquadTask  S = T;
+
+        S.cFirst    = cFirst;
+        S.cLim      = std::min( cFirst + cPer, T.cLim );
+        vTask.push_back( S );
+    }
 }
 
 /* ---------------------------------------------------------------- */
@@ -176,27 +275,35 @@ void Biquad::setBiquad(
 
 
 void Biquad::applyBlockwiseThd(
-    short   *data,
-    int     maxInt,
-    int     ntpts,
-    int     nchans,
-    int     c0,
-    int     cLim,
-    int     nThd )
+    short       *data,
+    int         maxInt,
+    int         ntpts,
+    int         nchans,
+    int         c0,
+    int         cLim,
+    BiquadPool  &pool )
 {
-    ME = this;
+    std::vector<BiquadTask> vTask;
 
-    double  Y   = 1.0 / maxInt,
-            A0  = a0,
-            A1  = a1,
-            A2  = a2,
-            B1  = b1,
-            B2  = b2;
-    int     nneural = cLim - c0,
-            cPer    = nneural / nThd,
-            cFirst  = c0;
+    addBlockwiseTasks(
+        vTask, data, maxInt, ntpts, nchans,
+        c0, cLim, pool.nThreads() + 1 );
+
+    pool.run( vTask );
+}
 
-    --nThd;
+
+void Biquad::addBlockwiseTasks(
+    std::vector<BiquadTask> &vTask,
+    short                   *data,
+    int                     maxInt,
+    int                     ntpts,
+    int                     nchans,
+    int                     c0,
+    int                     cLim,
+    int                     nParts )
+{
+    int nneural = cLim - c0;
 
     if( nneural != int(vz1.size()) ) {
 
@@ -204,52 +311,8 @@ void Biquad::applyBlockwiseThd(
         vz2.assign( nneural, 0 );
     }
 
-// Make nThd companion workers
-
-    std::vector<BiquadThread*>  vT;
-
-    if( !nThd || cPer < 4 )
-        nThd = 0;
-    else {
-
-        for( int i = 0; i < nThd; ++i ) {
-
-            vT.push_back( new BiquadThread(
-                                data, maxInt, ntpts, nchans,
-                                c0, cFirst, cFirst + cPer ) );
-
-            cFirst += cPer;
-
-            if( cLim - cFirst <= cPer )
-                break;
-        }
-    }
-
-// The final worker is me, the calling thread
-
-    for( int it = 0; it < ntpts; ++it, data += nchans ) {
-
-        for( int c = cFirst; c < cLim; ++c ) {
-
-            double  in  = data[c] * Y,
-                    z1  = vz1[c - c0],
-                    z2  = vz2[c - c0],
-                    out = in * A0 + z1;
-
-            z1 = in * A1 + z2 - B1 * out;
-            z2 = in * A2 - B2 * out;
-
-            data[c] = qBound( -maxInt, int(out * maxInt), maxInt - 1 );
-
-            vz1[c - c0] = z1;
-            vz2[c - c0] = z2;
-        }
-    }
-
-// Clean up workers
-
-    for( int it = 0; it < nThd; ++it )
-        delete vT[it];
+    BiquadPool::addTasks(
+        vTask, this, data, maxInt, ntpts, nchans, c0, cLim, nParts );
 }
 
 
@@ -261,13 +324,7 @@ void Biquad::applyBlockwiseMem(
     int     c0,
     int     cLim )
 {
-    double  Y   = 1.0 / maxInt,
-            A0  = a0,
-            A1  = a1,
-            A2  = a2,
-            B1  = b1,
-            B2  = b2;
-    int     nneural = cLim - c0;
+    int nneural = cLim - c0;
 
     if( nneural != int(vz1.size()) ) {
 
@@ -275,24 +332,8 @@ void Biquad::applyBlockwiseMem(
         vz2.assign( nneural, 0 );
     }
 
-    for( int it = 0; it < ntpts; ++it, data += nchans ) {
-
-        for( int c = c0; c < cLim; ++c ) {
-
-            double  in  = data[c] * Y,
-                    z1  = vz1[c - c0],
-                    z2  = vz2[c - c0],
-                    out = in * A0 + z1;
-
-            z1 = in * A1 + z2 - B1 * out;
-            z2 = in * A2 - B2 * out;
-
-            data[c] = qBound( -maxInt, int(out * maxInt), maxInt - 1 );
-
-            vz1[c - c0] = z1;
-            vz2[c - c0] = z2;
-        }
-    }
+    if( nneural > 0 )
+        applyRange( data, maxInt, ntpts, nchans, c0, c0, cLim );
 }
 
 
@@ -407,6 +448,89 @@ void Biquad::apply1BlockwiseNoMem(
 }
 
 
+// Filter channels [cFirst,cLim) of the block; state for channel c
+// is at (c - c0), already sized.
+//
+void Biquad::applyRange(
+    short   *data,
+    int     maxInt,
+    int     ntpts,
+    int     nchans,
+    int     c0,
+    int     cFirst,
+    int     cLim )
+{
+    double  Y   = 1.0 / maxInt,
+            A0  = a0,
+            A1  = a1,
+            A2  = a2,
+            B1  = b1,
+            B2  = b2;
+
+// Vector kernel takes what channel groups it can; the rest are ours
+
+    const double    coef[5] = {A0, A1, A2, B1, B2};
+
+    cFirst += biquadSimdApply(
+                &data[cFirst], maxInt, ntpts, nchans,
+                cLim - cFirst, coef,
+                &vz1[cFirst - c0], &vz2[cFirst - c0] );
+
+    if( cFirst >= cLim )
+        return;
+
+    for( int it = 0; it < ntpts; ++it, data += nchans ) {
+
+        for( int c = cFirst; c < cLim; ++c ) {
+
+            double  in  = data[c] * Y,
+                    z1  = vz1[c - c0],
+                    z2  = vz2[c - c0],
+                    out = in * A0 + z1;
+
+            z1 = in * A1 + z2 - B1 * out;
+            z2 = in * A2 - B2 * out;
+
+            data[c] = qBound( -maxInt, int(out * maxInt), maxInt - 1 );
+
+            vz1[c - c0] = z1;
+            vz2[c - c0] = z2;
+        }
+    }
+}
+
+
+// Scalar only: a lone Biquad on float data is not a hot path. The
+// arithmetic is still double, on the data's own scale.
+//
+void Biquad::applyRangeF(
+    float   *data,
+    int     ntpts,
+    int     nchans,
+    int     c0,
+    int     cFirst,
+    int     cLim )
+{
+    for( int it = 0; it < ntpts; ++it, data += nchans ) {
+
+        for( int c = cFirst; c < cLim; ++c ) {
+
+            double  in  = data[c],
+                    z1  = vz1[c - c0],
+                    z2  = vz2[c - c0],
+                    out = in * a0 + z1;
+
+            z1 = in * a1 + z2 - b1 * out;
+            z2 = in * a2 - b2 * out;
+
+            data[c] = float(out);
+
+            vz1[c - c0] = z1;
+            vz2[c - c0] = z2;
+        }
+    }
+}
+
 void Biquad::calcBiquad()
 {
     vz1.clear();
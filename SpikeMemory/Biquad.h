@@ -19,7 +19,8 @@
 #ifndef Biquad_h
 #define Biquad_h
 
-#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
 
 #include <vector>
 
@@ -29,51 +30,117 @@ class QThread;
 /* Threading helpers ---------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-class BiquadWorker : public QObject
+// A filter with per-channel state that can be applied to any slice
+// [cFirst,cLim) of its channel range [c0,cLim) independently, with
+// state already sized. Biquad and BiquadBank are both.
+//
+// applyRangeF is the same for float32 data, in the data's own units
+// and unclipped. Its state is not on applyRange's scale (maxInt), so
+// clearMem() before switching a filter from one form to the other.
+//
+class BiquadFilter
 {
-    Q_OBJECT
-
-private:
-    short   *data;
-    int     maxInt,
-            ntpts,
-            nchans,
-            c0,
-            cFirst,
-            cLim;
 public:
-    BiquadWorker(
+    virtual ~BiquadFilter() {}
+
+    virtual void applyRange(
         short   *data,
         int     maxInt,
         int     ntpts,
         int     nchans,
         int     c0,
         int     cFirst,
-        int     cLim )
-    :   QObject(0), data(data), maxInt(maxInt),
-        ntpts(ntpts), nchans(nchans),
-        c0(c0), cFirst(cFirst), cLim(cLim)  {}
-signals:
-    void finished();
-public slots:
-    void run();
-};
+        int     cLim ) = 0;
 
-class BiquadThread
-{
-public:
-    QThread         *thread;
-    BiquadWorker    *worker;
-public:
-    BiquadThread(
-        short   *data,
-        int     maxInt,
+    virtual void applyRangeF(
+        float   *data,
         int     ntpts,
         int     nchans,
         int     c0,
         int     cFirst,
-        int     cLim );
-    virtual ~BiquadThread();
+        int     cLim ) = 0;
+};
+
+// One slice of work for a BiquadPool: filter channels [cFirst,cLim)
+// of a block with (F), whose state covers channels [c0,...). The
+// block is (fdata) if that is set, else (data).
+//
+struct BiquadTask {
+    BiquadFilter    *F;
+    short           *data;
+    float           *fdata;
+    int             maxInt,
+                    ntpts,
+                    nchans,
+                    c0,
+                    cFirst,
+                    cLim;
+};
+
+// Long-lived filter threads.
+//
+// run() hands a list of tasks to the pool and takes tasks itself
+// until none are left, returning when all are done. Tasks must not
+// overlap (distinct filters, or disjoint channel ranges of one), and
+// then they can run in any order. With no pool threads, run() does
+// everything on the caller's thread.
+//
+// A pool serves one caller at a time; each SpikeVM has its own.
+//
+class BiquadPool
+{
+    friend class BiquadPoolThread;
+
+private:
+    std::vector<QThread*>   vT;
+    QMutex                  mtx;
+    QWaitCondition          work,
+                            done;
+    const BiquadTask        *tasks;
+    int                     nTasks,
+                            nextTask,
+                            nBusy;
+    bool                    quit;
+
+public:
+    BiquadPool( int nThreads );
+    virtual ~BiquadPool();
+
+    int nThreads() const    {return int(vT.size());}
+
+    void run( const std::vector<BiquadTask> &vTask );
+
+    // Append tasks covering channels [c0,cLim) of one block for
+    // (F), in (nParts) slices. Slices are whole vector groups, and
+    // not so thin that a task costs more to hand out than to do.
+    static void addTasks(
+        std::vector<BiquadTask> &vTask,
+        BiquadFilter            *F,
+        short                   *data,
+        int                     maxInt,
+        int                     ntpts,
+        int                     nchans,
+        int                     c0,
+        int                     cLim,
+        int                     nParts );
+
+    static void addTasks(
+        std::vector<BiquadTask> &vTask,
+        BiquadFilter            *F,
+        float                   *data,
+        int                     ntpts,
+        int                     nchans,
+        int                     c0,
+        int                     cLim,
+        int                     nParts );
+
+private:
+    void serve();
+    static void addSlices(
+        std::vector<BiquadTask> &vTask,
+        const BiquadTask        &T,
+        int                     nParts );
+    static void exec( const BiquadTask &T );
 };
 
 /* ---------------------------------------------------------------- */
@@ -118,9 +185,9 @@ enum BiquadType {
 // so instead, run highpass followed by lowpass. This is tested and
 // works correctly.
 //
-class Biquad
+class Biquad : public BiquadFilter
 {
-    friend class    BiquadWorker;
+    friend class    BiquadBank;
 
 private:
     std::vector<double> vz1, vz2;
@@ -157,15 +224,28 @@ public:
     // so is the array stride between timepoints. Filter will only
     // be applied to channel range [c0,cLim). Class retains state
     // data for each channel in the filtered range between calls.
-    // Work is distributed among nThd worker threads.
+    // Work is distributed among the threads of (pool).
     void applyBlockwiseThd(
-        short   *data,
-        int     maxInt,
-        int     ntpts,
-        int     nchans,
-        int     c0,
-        int     cLim,
-        int     nThd );
+        short       *data,
+        int         maxInt,
+        int         ntpts,
+        int         nchans,
+        int         c0,
+        int         cLim,
+        BiquadPool  &pool );
+
+    // As applyBlockwiseThd, but only append this block's tasks to
+    // (vTask), so blocks of several Biquads can share one
+    // BiquadPool::run(). Channels are cut into (nParts) slices.
+    void addBlockwiseTasks(
+        std::vector<BiquadTask> &vTask,
+        short                   *data,
+        int                     maxInt,
+        int                     ntpts,
+        int                     nchans,
+        int                     c0,
+        int                     cLim,
+        int                     nParts );
 
     // Apply filter in-place to (ntpts) worth of data, starting at
     // address (data). (nchans) includes (neural + aux) channels,
@@ -216,6 +296,23 @@ public:
         int     nchans,
         int     ichan );
 
+    virtual void applyRange(
+        short   *data,
+        int     maxInt,
+        int     ntpts,
+        int     nchans,
+        int     c0,
+        int     cFirst,
+        int     cLim );
+
+    virtual void applyRangeF(
+        float   *data,
+        int     ntpts,
+        int     nchans,
+        int     c0,
+        int     cFirst,
+        int     cLim );
+
 private:
     void calcBiquad();
 };
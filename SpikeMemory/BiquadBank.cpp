@@ -0,0 +1,548 @@
+
+#include "BiquadBank.h"
+#include "BiquadSimd.h"
+
+#include <QtGlobal>
+
+#include <algorithm>
+
+#include <math.h>
+#include <stdlib.h>
+
+
+/* ---------------------------------------------------------------- */
+/* BiquadBank ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void BiquadBank::addSection(
+    int     type,
+    double  Fc,
+    double  Q,
+    double  peakGainDB )
+{
+    vSec.push_back( Biquad( type, Fc, Q, peakGainDB ) );
+
+    const Biquad    &B = vSec.back();
+
+    coef.push_back( B.a0 );
+    coef.push_back( B.a1 );
+    coef.push_back( B.a2 );
+    coef.push_back( B.b1 );
+    coef.push_back( B.b2 );
+
+    coefF.push_back( float(B.a0) );
+    coefF.push_back( float(B.a1) );
+    coefF.push_back( float(B.a2) );
+    coefF.push_back( float(B.b1) );
+    coefF.push_back( float(B.b2) );
+
+    addSectionQ( B );
+
+    clearMem();
+}
+
+
+void BiquadBank::setBandNotch(
+    double  srate,
+    double  loHz,
+    double  hiHz,
+    double  lineHz,
+    int     nLine,
+    double  notchQ )
+{
+    clearSections();
+
+    addSection( bq_type_highpass, loHz / srate );
+    addSection( bq_type_lowpass, hiHz / srate );
+
+    for( int k = 1; k <= nLine && k * lineHz < hiHz; ++k )
+        addSection( bq_type_notch, k * lineHz / srate, notchQ );
+}
+
+
+void BiquadBank::applyBlockwiseMem(
+    short   *data,
+    int     maxInt,
+    int     ntpts,
+    int     nchans,
+    int     c0,
+    int     cLim )
+{
+    sizeState( cLim - c0 );
+
+    if( cLim > c0 )
+        applyRange( data, maxInt, ntpts, nchans, c0, c0, cLim );
+}
+
+
+void BiquadBank::applyBlockwiseMem(
+    float   *data,
+    int     ntpts,
+    int     nchans,
+    int     c0,
+    int     cLim )
+{
+    sizeState( cLim - c0 );
+
+    if( cLim > c0 )
+        applyRangeF( data, ntpts, nchans, c0, c0, cLim );
+}
+
+
+void BiquadBank::addBlockwiseTasks(
+    std::vector<BiquadTask> &vTask,
+    short                   *data,
+    int                     maxInt,
+    int                     ntpts,
+    int                     nchans,
+    int                     c0,
+    int                     cLim,
+    int                     nParts )
+{
+    sizeState( cLim - c0 );
+
+    BiquadPool::addTasks(
+        vTask, this, data, maxInt, ntpts, nchans, c0, cLim, nParts );
+}
+
+
+void BiquadBank::addBlockwiseTasks(
+    std::vector<BiquadTask> &vTask,
+    float                   *data,
+    int                     ntpts,
+    int                     nchans,
+    int                     c0,
+    int                     cLim,
+    int                     nParts )
+{
+    sizeState( cLim - c0 );
+
+    BiquadPool::addTasks(
+        vTask, this, data, ntpts, nchans, c0, cLim, nParts );
+}
+
+
+// Vector kernel takes what channel groups it can; the rest are ours.
+// Per sample and section the arithmetic is Biquad's, so a one-section
+// bank matches that Biquad exactly.
+//
+void BiquadBank::applyRange(
+    short   *data,
+    int     maxInt,
+    int     ntpts,
+    int     nchans,
+    int     c0,
+    int     cFirst,
+    int     cLim )
+{
+    int nsec = nSections();
+
+    if( !nsec )
+        return;
+
+    if( fixedPoint() ) {
+        applyRangeQ( data, maxInt, ntpts, nchans, c0, cFirst, cLim );
+        return;
+    }
+
+    cFirst += biquadSimdApplySOS(
+                &data[cFirst], maxInt, ntpts, nchans,
+                cLim - cFirst, nsec, &coef[0],
+                &vz1[cFirst - c0], &vz2[cFirst - c0], nneural );
+
+    if( cFirst >= cLim )
+        return;
+
+    double  Y = 1.0 / maxInt;
+
+    for( int it = 0; it < ntpts; ++it, data += nchans ) {
+
+        for( int c = cFirst; c < cLim; ++c ) {
+
+            double  x = data[c] * Y;
+
+            for( int is = 0; is < nsec; ++is ) {
+
+                const double    *k  = &coef[5*is];
+                double          &z1 = vz1[is*nneural + c - c0],
+                                &z2 = vz2[is*nneural + c - c0],
+                                out = x * k[0] + z1;
+
+                z1 = x * k[1] + z2 - k[3] * out;
+                z2 = x * k[2] - k[4] * out;
+                x  = out;
+            }
+
+            data[c] = qBound( -maxInt, int(x * maxInt), maxInt - 1 );
+        }
+    }
+}
+
+
+// As applyRange, with every operation in float. The vector kernel's
+// arithmetic is this loop's, so results don't depend on the ISA.
+//
+void BiquadBank::applyRangeF(
+    float   *data,
+    int     ntpts,
+    int     nchans,
+    int     c0,
+    int     cFirst,
+    int     cLim )
+{
+    int nsec = nSections();
+
+    if( !nsec )
+        return;
+
+    cFirst += biquadSimdApplySOSF(
+                &data[cFirst], ntpts, nchans,
+                cLim - cFirst, nsec, &coefF[0],
+                &vf1[cFirst - c0], &vf2[cFirst - c0], nneural );
+
+    if( cFirst >= cLim )
+        return;
+
+    for( int it = 0; it < ntpts; ++it, data += nchans ) {
+
+        for( int c = cFirst; c < cLim; ++c ) {
+
+            float   x = data[c];
+
+            for( int is = 0; is < nsec; ++is ) {
+
+                const float *k  = &coefF[5*is];
+                float       &z1 = vf1[is*nneural + c - c0],
+                            &z2 = vf2[is*nneural + c - c0],
+                            out = x * k[0] + z1;
+
+                z1 = x * k[1] + z2 - k[3] * out;
+                z2 = x * k[2] - k[4] * out;
+                x  = out;
+            }
+
+            data[c] = x;
+        }
+    }
+}
+
+
+void BiquadBank::sizeState( int nneural )
+{
+    if( nneural != this->nneural || vz1.empty() ) {
+
+        this->nneural = nneural;
+        vz1.assign( nSections() * nneural, 0 );
+        vz2.assign( nSections() * nneural, 0 );
+        vf1.assign( nSections() * nneural, 0 );
+        vf2.assign( nSections() * nneural, 0 );
+        vq.assign( 5 * nSections() * nneural, 0 );
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* Fixed-point form ----------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// A sample is an int16 (v) and a residual (r), |r| <= 2^13, worth
+// v + r/2^14. Each section keeps pairs of its inputs and outputs
+//
+//  P = (x[n-1], x[n-2]),  Pr = their residuals,
+//  Q = (y[n-1], y[n-2]),  Qr = their residuals,
+//  E = (e[n-1], e[n-2]),  its low-order rounding errors,
+//
+// (low half first) and its coefQ entry is seven words of int16
+// pairs for pmaddwd against them:
+//
+//  0: (a0, a1)  Q14              3: (a0, a1)  bits 15-28
+//  1: ( 0, a2)                   4: ( 0, a2)
+//  2: (-b1,-b2)                  5: (-b1,-b2)
+//  6: error feedback, (-b1,-b2) rounded to integers
+//
+// The error feedback puts zeros on the poles' side of the circle
+// under the low-order rounding, which a notch's poles would
+// otherwise amplify several thousand times.
+
+#define BQ_Q        14
+#define BQ_HALF     (1 << (BQ_Q - 1))
+
+static inline int pairQ( int lo, int hi )
+{
+    return int((unsigned(hi) << 16) | (unsigned(lo) & 0xFFFF));
+}
+
+
+// pmaddwd on one lane: exact products, summed mod 2^32.
+//
+static inline int maddQ( int p, int k )
+{
+    return int( unsigned(short(p) * short(k))
+                + unsigned(short(p >> 16) * short(k >> 16)) );
+}
+
+
+void BiquadBank::addSectionQ( const Biquad &B )
+{
+    const double    c[5] = {B.a0, B.a1, B.a2, -B.b1, -B.b2};
+    int             h[5], l[5], f[2];
+    double          sumH = 0, sumL = 0;
+
+    for( int k = 0; k < 5; ++k ) {
+
+        double  v = c[k] * (1 << BQ_Q);
+
+        h[k] = int(lrint( v ));
+        l[k] = int(lrint( (v - h[k]) * (1 << BQ_Q) ));
+
+        if( h[k] < -32768 || h[k] > 32767 )
+            fixedOK = false;
+
+        sumH += abs( h[k] );
+        sumL += abs( l[k] );
+    }
+
+    f[0] = int(lrint( c[3] ));
+    f[1] = int(lrint( c[4] ));
+
+    // The low-order sum must not overflow, whatever the samples.
+
+    if( (sumH + abs( f[0] ) + abs( f[1] )) * BQ_HALF
+        + sumL * 32768 + sumL / 2 + BQ_HALF >= 2147483648.0 ) {
+
+        fixedOK = false;
+    }
+
+    coefQ.push_back( pairQ( h[0], h[1] ) );
+    coefQ.push_back( pairQ( 0, h[2] ) );
+    coefQ.push_back( pairQ( h[3], h[4] ) );
+    coefQ.push_back( pairQ( l[0], l[1] ) );
+    coefQ.push_back( pairQ( 0, l[2] ) );
+    coefQ.push_back( pairQ( l[3], l[4] ) );
+    coefQ.push_back( pairQ( f[0], f[1] ) );
+}
+
+
+// Per sample and section, with (x, xr) the input:
+//
+//  X   = (x, P.lo),  Xr = (xr, Pr.lo)
+//  acc = X.K0 + P.K1 + Q.K2                        (Q14, wrapping)
+//  s   = Xr.K0 + Pr.K1 + Qr.K2 + X.K3 + P.K4 + Q.K5 + E.K6
+//      + (Xr.K3 + Pr.K4 + Qr.K5 + 2^13) >> 14      (Q28)
+//  n   = (s + 2^13) >> 14,  e = s - 2^14 n
+//  acc += n
+//  y   = (acc + 2^13) >> 14, clamped to int16
+//  yr  = acc - 2^14 y
+//
+// The bank's output is y + yr/2^14 truncated toward zero, as the
+// double form truncates. The vector kernels do exactly this, so
+// results are the same integers on any ISA.
+//
+void BiquadBank::applyRangeQ(
+    short   *data,
+    int     maxInt,
+    int     ntpts,
+    int     nchans,
+    int     c0,
+    int     cFirst,
+    int     cLim )
+{
+    int nsec = nSections();
+
+    cFirst += biquadSimdApplySOSQ(
+                &data[cFirst], maxInt, ntpts, nchans,
+                cLim - cFirst, nsec, &coefQ[0],
+                &vq[cFirst - c0], nneural );
+
+    if( cFirst >= cLim )
+        return;
+
+    for( int it = 0; it < ntpts; ++it, data += nchans ) {
+
+        for( int c = cFirst; c < cLim; ++c ) {
+
+            int x   = data[c],
+                xr  = 0;
+
+            for( int is = 0; is < nsec; ++is ) {
+
+                const int   *K  = &coefQ[7*is];
+                int         *S  = &vq[5*is*nneural + c - c0];
+                int         &P  = S[0],
+                            &Pr = S[nneural],
+                            &Q  = S[2*nneural],
+                            &Qr = S[3*nneural],
+                            &E  = S[4*nneural],
+                            X   = pairQ( x, P ),
+                            Xr  = pairQ( xr, Pr ),
+                            acc = int( unsigned(maddQ( X, K[0] ))
+                                    + unsigned(maddQ( P, K[1] ))
+                                    + unsigned(maddQ( Q, K[2] )) ),
+                            xl  = maddQ( Xr, K[3] ) + maddQ( Pr, K[4] )
+                                    + maddQ( Qr, K[5] ),
+                            s   = int( unsigned(maddQ( Xr, K[0] ))
+                                    + unsigned(maddQ( Pr, K[1] ))
+                                    + unsigned(maddQ( Qr, K[2] ))
+                                    + unsigned(maddQ( X, K[3] ))
+                                    + unsigned(maddQ( P, K[4] ))
+                                    + unsigned(maddQ( Q, K[5] ))
+                                    + unsigned(maddQ( E, K[6] ))
+                                    + unsigned((xl + BQ_HALF) >> BQ_Q) ),
+                            n   = (s + BQ_HALF) >> BQ_Q;
+
+                acc = int(unsigned(acc) + unsigned(n));
+
+                int y = int(unsigned(acc) + BQ_HALF) >> BQ_Q;
+
+                xr  = int(unsigned(acc) - (unsigned(y) << BQ_Q));
+                x   = qBound( -32768, y, 32767 );
+                P   = X;
+                Pr  = Xr;
+                Q   = pairQ( x, Q );
+                Qr  = pairQ( xr, Qr );
+                E   = pairQ( int(unsigned(s) - (unsigned(n) << BQ_Q)), E );
+            }
+
+            // toward zero
+
+            if( x > 0 && xr < 0 )
+                --x;
+            else if( x < 0 && xr > 0 )
+                ++x;
+
+            data[c] = qBound( -maxInt, x, maxInt - 1 );
+        }
+    }
+}
+
+
+/* ---------------------------------------------------------------- */
+/* Priming -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// For a constant input (u) a section settles to output G*u, with
+// G = (a0+a1+a2)/(1+b1+b2) its DC gain, and (transposed direct
+// form II) z1 = y - a0*u, z2 = a2*u - b2*y.
+//
+void BiquadBank::prime(
+    const short *data,
+    int         maxInt,
+    int         ntpts,
+    int         nchans,
+    int         c0,
+    int         cLim )
+{
+    std::vector<double> u;
+    int                 nsec = nSections();
+
+    sizeState( cLim - c0 );
+    primeMeans( u, data, ntpts, nchans, c0, cLim );
+
+    if( u.empty() )
+        return;
+
+    for( int ic = 0; ic < nneural; ++ic ) {
+
+        // The fixed-point form's first section takes no input
+        // residual, so its input is the mean rounded.
+
+        double  x   = lrint( u[ic] ),
+                xq  = x;
+        int     xi  = int(xq),
+                xr  = 0;
+
+        x /= maxInt;
+
+        for( int is = 0; is < nsec; ++is ) {
+
+            const double    *k = &coef[5*is];
+            double          G  = (k[0] + k[1] + k[2]) / (1 + k[3] + k[4]),
+                            y  = G * x,
+                            yq = G * xq;
+
+            vz1[is*nneural + ic] = y - k[0] * x;
+            vz2[is*nneural + ic] = k[2] * x - k[4] * y;
+            x = y;
+
+            int yi  = int(lrint( yq )),
+                yr  = int(lrint( (yq - yi) * (1 << BQ_Q) )),
+                *S  = &vq[5*is*nneural + ic];
+
+            yi = qBound( -32768, yi, 32767 );
+
+            S[0]            = pairQ( xi, xi );
+            S[nneural]      = pairQ( xr, xr );
+            S[2*nneural]    = pairQ( yi, yi );
+            S[3*nneural]    = pairQ( yr, yr );
+            S[4*nneural]    = 0;
+
+            xi  = yi;
+            xr  = yr;
+            xq  = yi + double(yr) / (1 << BQ_Q);
+        }
+    }
+}
+
+
+void BiquadBank::prime(
+    const float *data,
+    int         ntpts,
+    int         nchans,
+    int         c0,
+    int         cLim )
+{
+    std::vector<double> u;
+    int                 nsec = nSections();
+
+    sizeState( cLim - c0 );
+    primeMeans( u, data, ntpts, nchans, c0, cLim );
+
+    if( u.empty() )
+        return;
+
+    for( int ic = 0; ic < nneural; ++ic ) {
+
+        double  x = u[ic];
+
+        for( int is = 0; is < nsec; ++is ) {
+
+            const float *k = &coefF[5*is];
+            double      G  = (double(k[0]) + k[1] + k[2]) / (1.0 + k[3] + k[4]),
+                        y  = G * x;
+
+            vf1[is*nneural + ic] = float(y - k[0] * x);
+            vf2[is*nneural + ic] = float(k[2] * x - k[4] * y);
+            x = y;
+        }
+    }
+}
+
+
+// u[c - c0] = mean of channel c over the first few scans, in rows.
+//
+template<typename T>
+void BiquadBank::primeMeans(
+    std::vector<double> &u,
+    const T             *data,
+    int                 ntpts,
+    int                 nchans,
+    int                 c0,
+    int                 cLim ) const
+{
+    int n = std::min( ntpts, BIQUAD_PRIME_TPTS );
+
+    if( n <= 0 || cLim <= c0 )
+        return;
+
+    u.assign( cLim - c0, 0 );
+
+    for( int it = 0; it < n; ++it, data += nchans ) {
+
+        for( int c = c0; c < cLim; ++c )
+            u[c - c0] += data[c];
+    }
+
+    for( int ic = 0; ic < cLim - c0; ++ic )
+        u[ic] /= n;
+}
+
+
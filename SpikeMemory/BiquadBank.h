@@ -0,0 +1,211 @@
+#ifndef BIQUADBANK_H
+#define BIQUADBANK_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include "Biquad.h"
+
+#include <vector>
+
+
+#define BIQUAD_PRIME_TPTS   16
+
+/* ---------------------------------------------------------------- */
+/* BiquadBank ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Cascade of Biquad sections (second-order sections) applied in a
+// single pass over interleaved multichannel data.
+//
+// Sections are designed by Biquad (calcBiquad) and run in the order
+// added. Each time tile of the block is read and written once, with
+// every section applied while it is in cache, and samples carried
+// in double between sections (no rounding to int16 until the end).
+// An extra section costs arithmetic, not another sweep of memory.
+//
+// Like Biquad, the bank retains state for each channel in the
+// filtered range between calls (one pair per section), and has the
+// same start-up transient (BIQUAD_TRANS_WIDE) per section.
+// After a gap, prime() avoids the transient: each channel's state
+// is set to the steady state for a constant input, the mean of the
+// first BIQUAD_PRIME_TPTS samples after the gap, so nothing need be
+// blanked.
+//
+// The float32 form (applyRangeF) runs entirely in float: float
+// coefficients and state, kept apart from the int16 form's, and
+// twice the channels per vector.
+//
+// The fixed-point form (setFixedPoint) replaces the int16 form's
+// double arithmetic with integer arithmetic, for int16 data end to
+// end. Each section is direct form I:
+//
+//  - coefficients are Q14 int16s (|c| < 2), each with a second
+//    int16 carrying bits 15-28, so pole and zero positions are as
+//    good as double's;
+//  - samples are int16s, each with a 14-bit residual carried from
+//    section to section and in the state, and the low-order sum's
+//    rounding error is fed back, so poles near the unit circle (the
+//    high-pass, notches) don't amplify rounding;
+//  - products are summed by pmaddwd pairs in 32-bit accumulators.
+//
+// On the AP bank (300-6000 Hz, 60 Hz notches) outputs agree with
+// the double form within +-1 LSB. Integer results are the same on
+// every ISA. A section
+// with a coefficient outside [-2,2) (a peak or shelf with gain),
+// or whose sums could overflow, can't be represented, and a bank
+// holding one stays in double.
+//
+class BiquadBank : public BiquadFilter
+{
+private:
+    std::vector<Biquad> vSec;
+    std::vector<double> coef,       // [section][5]
+                        vz1, vz2;   // [section][channel]
+    std::vector<float>  coefF,      // float32 form
+                        vf1, vf2;
+    std::vector<int>    coefQ,      // fixed-point form: [section][7]
+                        vq;         // [section][5][channel]
+    int                 nneural;
+    bool                fixedPt,
+                        fixedOK;
+
+public:
+    BiquadBank() : nneural(0), fixedPt(false), fixedOK(true)  {}
+
+    void clearSections()
+    {
+        vSec.clear(); coef.clear(); coefF.clear(); coefQ.clear();
+        fixedOK = true;
+        clearMem();
+    }
+    void addSection(
+        int     type,
+        double  Fc,
+        double  Q = 0,
+        double  peakGainDB = 0 );
+
+    // Band-pass [loHz,hiHz] (highpass then lowpass), then notches at
+    // (lineHz) and its harmonics, (nLine) in all, as long as they
+    // are below (hiHz). Rates in Hz at sample rate (srate).
+    void setBandNotch(
+        double  srate,
+        double  loHz,
+        double  hiHz,
+        double  lineHz,
+        int     nLine,
+        double  notchQ = 30 );
+
+    int nSections() const   {return int(vSec.size());}
+
+    // Filter int16 data in fixed point (if every section allows).
+    // Switching starts the int16 state over, as clearMem().
+    void setFixedPoint( bool on )
+        {if( on != fixedPt ) {fixedPt = on; clearMem();}}
+    bool fixedPoint() const {return fixedPt && fixedOK;}
+
+    void clearMem()
+    {
+        vz1.clear(); vz2.clear(); vf1.clear(); vf2.clear(); vq.clear();
+        nneural = 0;
+    }
+
+    // Set the state of channels [c0,cLim) to their steady state for
+    // a constant input: the mean of the first BIQUAD_PRIME_TPTS
+    // (or ntpts) of (data). Call with the first block after a gap,
+    // before filtering it. The int16 form primes the double and the
+    // fixed-point state both; the float32 form primes its own.
+    void prime(
+        const short *data,
+        int         maxInt,
+        int         ntpts,
+        int         nchans,
+        int         c0,
+        int         cLim );
+    void prime(
+        const float *data,
+        int         ntpts,
+        int         nchans,
+        int         c0,
+        int         cLim );
+
+    // As Biquad::applyBlockwiseMem.
+    void applyBlockwiseMem(
+        short   *data,
+        int     maxInt,
+        int     ntpts,
+        int     nchans,
+        int     c0,
+        int     cLim );
+
+    // As applyBlockwiseMem, for float32 data.
+    void applyBlockwiseMem(
+        float   *data,
+        int     ntpts,
+        int     nchans,
+        int     c0,
+        int     cLim );
+
+    // As Biquad::addBlockwiseTasks.
+    void addBlockwiseTasks(
+        std::vector<BiquadTask> &vTask,
+        short                   *data,
+        int                     maxInt,
+        int                     ntpts,
+        int                     nchans,
+        int                     c0,
+        int                     cLim,
+        int                     nParts );
+
+    // As addBlockwiseTasks, for float32 data.
+    void addBlockwiseTasks(
+        std::vector<BiquadTask> &vTask,
+        float                   *data,
+        int                     ntpts,
+        int                     nchans,
+        int                     c0,
+        int                     cLim,
+        int                     nParts );
+
+    virtual void applyRange(
+        short   *data,
+        int     maxInt,
+        int     ntpts,
+        int     nchans,
+        int     c0,
+        int     cFirst,
+        int     cLim );
+
+    virtual void applyRangeF(
+        float   *data,
+        int     ntpts,
+        int     nchans,
+        int     c0,
+        int     cFirst,
+        int     cLim );
+
+private:
+    void addSectionQ( const Biquad &B );
+    void applyRangeQ(
+        short   *data,
+        int     maxInt,
+        int     ntpts,
+        int     nchans,
+        int     c0,
+        int     cFirst,
+        int     cLim );
+    void sizeState( int nneural );
+    template<typename T>
+    void primeMeans(
+        std::vector<double> &u,
+        const T             *data,
+        int                 ntpts,
+        int                 nchans,
+        int                 c0,
+        int                 cLim ) const;
+};
+
+#endif  // BIQUADBANK_H
+
+
@@ -0,0 +1,948 @@
+
+#include "BiquadSimd.h"
+#include "CpuDispatch.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define BQ_X86
+#include <immintrin.h>
+#endif
+
+// Results must match the scalar filter bit for bit, so no fusing
+// mul/add pairs into FMA (AVX-512 targets imply FMA to gcc).
+// And gcc 12 flags its own _mm512_undefined_* placeholders
+// (PR 105593).
+
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// MSVC compiles any intrinsic as is; gcc/clang want each function
+// marked with the ISA it may use, so the rest of the program still
+// runs on any x86.
+
+#if defined(BQ_X86) && !defined(_MSC_VER)
+#define BQ_AVX2     __attribute__((target("avx2")))
+#define BQ_AVX512   __attribute__((target("avx512f")))
+#else
+#define BQ_AVX2
+#define BQ_AVX512
+#endif
+
+// Timepoints per tile: a tile of a 385-channel probe is ~24KB,
+// so it stays in L1 while every channel group passes over it.
+
+#define BQ_TILE_TPTS    32
+
+
+/* ---------------------------------------------------------------- */
+/* Kernels -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#ifdef BQ_X86
+
+// One tile of channels [c,c+8): (ntpts) timepoints from (d).
+//
+// Each step is the scalar loop's, in the same order:
+//
+//  in  = d * Y
+//  out = in * A0 + z1
+//  z1  = in * A1 + z2 - B1 * out
+//  z2  = in * A2 - B2 * out
+//  d   = clamp( trunc( out * M ) )
+//
+// Clamping before truncation gives the same integer as truncating
+// and then clamping (qBound), and keeps cvtt in range.
+//
+BQ_AVX2 static void tileAVX2(
+    short           *d,
+    int             ntpts,
+    int             nchans,
+    const double    *coef,
+    double          Y,
+    double          M,
+    double          *z1p,
+    double          *z2p )
+{
+    const __m256d   A0  = _mm256_set1_pd( coef[0] ),
+                    A1  = _mm256_set1_pd( coef[1] ),
+                    A2  = _mm256_set1_pd( coef[2] ),
+                    B1  = _mm256_set1_pd( coef[3] ),
+                    B2  = _mm256_set1_pd( coef[4] ),
+                    vY  = _mm256_set1_pd( Y ),
+                    vM  = _mm256_set1_pd( M ),
+                    lo  = _mm256_set1_pd( -M ),
+                    hi  = _mm256_set1_pd( M - 1 );
+    __m256d         z1a = _mm256_loadu_pd( z1p ),
+                    z1b = _mm256_loadu_pd( z1p + 4 ),
+                    z2a = _mm256_loadu_pd( z2p ),
+                    z2b = _mm256_loadu_pd( z2p + 4 );
+
+    for( int it = 0; it < ntpts; ++it, d += nchans ) {
+
+        __m128i s   = _mm_loadu_si128( (const __m128i*)d );
+        __m256d ina = _mm256_mul_pd( _mm256_cvtepi32_pd( _mm_cvtepi16_epi32( s ) ), vY ),
+                inb = _mm256_mul_pd( _mm256_cvtepi32_pd( _mm_cvtepi16_epi32( _mm_srli_si128( s, 8 ) ) ), vY ),
+                oa  = _mm256_add_pd( _mm256_mul_pd( ina, A0 ), z1a ),
+                ob  = _mm256_add_pd( _mm256_mul_pd( inb, A0 ), z1b );
+
+        z1a = _mm256_sub_pd( _mm256_add_pd( _mm256_mul_pd( ina, A1 ), z2a ), _mm256_mul_pd( B1, oa ) );
+        z1b = _mm256_sub_pd( _mm256_add_pd( _mm256_mul_pd( inb, A1 ), z2b ), _mm256_mul_pd( B1, ob ) );
+        z2a = _mm256_sub_pd( _mm256_mul_pd( ina, A2 ), _mm256_mul_pd( B2, oa ) );
+        z2b = _mm256_sub_pd( _mm256_mul_pd( inb, A2 ), _mm256_mul_pd( B2, ob ) );
+
+        oa = _mm256_min_pd( _mm256_max_pd( _mm256_mul_pd( oa, vM ), lo ), hi );
+        ob = _mm256_min_pd( _mm256_max_pd( _mm256_mul_pd( ob, vM ), lo ), hi );
+
+        _mm_storeu_si128( (__m128i*)d,
+            _mm_packs_epi32( _mm256_cvttpd_epi32( oa ), _mm256_cvttpd_epi32( ob ) ) );
+    }
+
+    _mm256_storeu_pd( z1p,     z1a );
+    _mm256_storeu_pd( z1p + 4, z1b );
+    _mm256_storeu_pd( z2p,     z2a );
+    _mm256_storeu_pd( z2p + 4, z2b );
+}
+
+
+// As tileAVX2, for channels [c,c+16).
+//
+BQ_AVX512 static void tileAVX512(
+    short           *d,
+    int             ntpts,
+    int             nchans,
+    const double    *coef,
+    double          Y,
+    double          M,
+    double          *z1p,
+    double          *z2p )
+{
+    const __m512d   A0  = _mm512_set1_pd( coef[0] ),
+                    A1  = _mm512_set1_pd( coef[1] ),
+                    A2  = _mm512_set1_pd( coef[2] ),
+                    B1  = _mm512_set1_pd( coef[3] ),
+                    B2  = _mm512_set1_pd( coef[4] ),
+                    vY  = _mm512_set1_pd( Y ),
+                    vM  = _mm512_set1_pd( M ),
+                    lo  = _mm512_set1_pd( -M ),
+                    hi  = _mm512_set1_pd( M - 1 );
+    __m512d         z1a = _mm512_loadu_pd( z1p ),
+                    z1b = _mm512_loadu_pd( z1p + 8 ),
+                    z2a = _mm512_loadu_pd( z2p ),
+                    z2b = _mm512_loadu_pd( z2p + 8 );
+
+    for( int it = 0; it < ntpts; ++it, d += nchans ) {
+
+        __m512i s   = _mm512_cvtepi16_epi32( _mm256_loadu_si256( (const __m256i*)d ) );
+        __m512d ina = _mm512_mul_pd( _mm512_cvtepi32_pd( _mm512_castsi512_si256( s ) ), vY ),
+                inb = _mm512_mul_pd( _mm512_cvtepi32_pd( _mm512_extracti64x4_epi64( s, 1 ) ), vY ),
+                oa  = _mm512_add_pd( _mm512_mul_pd( ina, A0 ), z1a ),
+                ob  = _mm512_add_pd( _mm512_mul_pd( inb, A0 ), z1b );
+
+        z1a = _mm512_sub_pd( _mm512_add_pd( _mm512_mul_pd( ina, A1 ), z2a ), _mm512_mul_pd( B1, oa ) );
+        z1b = _mm512_sub_pd( _mm512_add_pd( _mm512_mul_pd( inb, A1 ), z2b ), _mm512_mul_pd( B1, ob ) );
+        z2a = _mm512_sub_pd( _mm512_mul_pd( ina, A2 ), _mm512_mul_pd( B2, oa ) );
+        z2b = _mm512_sub_pd( _mm512_mul_pd( inb, A2 ), _mm512_mul_pd( B2, ob ) );
+
+        oa = _mm512_min_pd( _mm512_max_pd( _mm512_mul_pd( oa, vM ), lo ), hi );
+        ob = _mm512_min_pd( _mm512_max_pd( _mm512_mul_pd( ob, vM ), lo ), hi );
+
+        __m512i o = _mm512_inserti64x4(
+                        _mm512_castsi256_si512( _mm512_cvttpd_epi32( oa ) ),
+                        _mm512_cvttpd_epi32( ob ), 1 );
+
+        _mm256_storeu_si256( (__m256i*)d, _mm512_cvtsepi32_epi16( o ) );
+    }
+
+    _mm512_storeu_pd( z1p,     z1a );
+    _mm512_storeu_pd( z1p + 8, z1b );
+    _mm512_storeu_pd( z2p,     z2a );
+    _mm512_storeu_pd( z2p + 8, z2b );
+}
+
+
+// Cascade of (nsec) sections over one tile of channels [c,c+8).
+//
+// The tile is converted once into (buf), each section then runs
+// over (buf) with its state in registers, and the result is
+// converted back once. Samples stay in double between sections.
+// Per sample and section the arithmetic is tileAVX2's.
+//
+BQ_AVX2 static void tileSOSAVX2(
+    short           *d,
+    int             ntpts,
+    int             nchans,
+    int             nsec,
+    const double    *coef,
+    double          Y,
+    double          M,
+    double          *z1p,
+    double          *z2p,
+    int             zStride )
+{
+    __m256d         buf[2 * BQ_TILE_TPTS];
+    const __m256d   vY  = _mm256_set1_pd( Y ),
+                    vM  = _mm256_set1_pd( M ),
+                    lo  = _mm256_set1_pd( -M ),
+                    hi  = _mm256_set1_pd( M - 1 );
+    short           *p  = d;
+
+    for( int it = 0; it < ntpts; ++it, p += nchans ) {
+
+        __m128i s = _mm_loadu_si128( (const __m128i*)p );
+
+        buf[2*it]     = _mm256_mul_pd( _mm256_cvtepi32_pd( _mm_cvtepi16_epi32( s ) ), vY );
+        buf[2*it + 1] = _mm256_mul_pd( _mm256_cvtepi32_pd( _mm_cvtepi16_epi32( _mm_srli_si128( s, 8 ) ) ), vY );
+    }
+
+    for( int is = 0; is < nsec; ++is, coef += 5, z1p += zStride, z2p += zStride ) {
+
+        const __m256d   A0  = _mm256_set1_pd( coef[0] ),
+                        A1  = _mm256_set1_pd( coef[1] ),
+                        A2  = _mm256_set1_pd( coef[2] ),
+                        B1  = _mm256_set1_pd( coef[3] ),
+                        B2  = _mm256_set1_pd( coef[4] );
+        __m256d         z1a = _mm256_loadu_pd( z1p ),
+                        z1b = _mm256_loadu_pd( z1p + 4 ),
+                        z2a = _mm256_loadu_pd( z2p ),
+                        z2b = _mm256_loadu_pd( z2p + 4 );
+
+        for( int it = 0; it < ntpts; ++it ) {
+
+            __m256d ina = buf[2*it],
+                    inb = buf[2*it + 1],
+                    oa  = _mm256_add_pd( _mm256_mul_pd( ina, A0 ), z1a ),
+                    ob  = _mm256_add_pd( _mm256_mul_pd( inb, A0 ), z1b );
+
+            z1a = _mm256_sub_pd( _mm256_add_pd( _mm256_mul_pd( ina, A1 ), z2a ), _mm256_mul_pd( B1, oa ) );
+            z1b = _mm256_sub_pd( _mm256_add_pd( _mm256_mul_pd( inb, A1 ), z2b ), _mm256_mul_pd( B1, ob ) );
+            z2a = _mm256_sub_pd( _mm256_mul_pd( ina, A2 ), _mm256_mul_pd( B2, oa ) );
+            z2b = _mm256_sub_pd( _mm256_mul_pd( inb, A2 ), _mm256_mul_pd( B2, ob ) );
+
+            buf[2*it]     = oa;
+            buf[2*it + 1] = ob;
+        }
+
+        _mm256_storeu_pd( z1p,     z1a );
+        _mm256_storeu_pd( z1p + 4, z1b );
+        _mm256_storeu_pd( z2p,     z2a );
+        _mm256_storeu_pd( z2p + 4, z2b );
+    }
+
+    for( int it = 0; it < ntpts; ++it, d += nchans ) {
+
+        __m256d oa = _mm256_min_pd( _mm256_max_pd( _mm256_mul_pd( buf[2*it], vM ), lo ), hi ),
+                ob = _mm256_min_pd( _mm256_max_pd( _mm256_mul_pd( buf[2*it + 1], vM ), lo ), hi );
+
+        _mm_storeu_si128( (__m128i*)d,
+            _mm_packs_epi32( _mm256_cvttpd_epi32( oa ), _mm256_cvttpd_epi32( ob ) ) );
+    }
+}
+
+
+// As tileSOSAVX2, for channels [c,c+16).
+//
+BQ_AVX512 static void tileSOSAVX512(
+    short           *d,
+    int             ntpts,
+    int             nchans,
+    int             nsec,
+    const double    *coef,
+    double          Y,
+    double          M,
+    double          *z1p,
+    double          *z2p,
+    int             zStride )
+{
+    __m512d         buf[2 * BQ_TILE_TPTS];
+    const __m512d   vY  = _mm512_set1_pd( Y ),
+                    vM  = _mm512_set1_pd( M ),
+                    lo  = _mm512_set1_pd( -M ),
+                    hi  = _mm512_set1_pd( M - 1 );
+    short           *p  = d;
+
+    for( int it = 0; it < ntpts; ++it, p += nchans ) {
+
+        __m512i s = _mm512_cvtepi16_epi32( _mm256_loadu_si256( (const __m256i*)p ) );
+
+        buf[2*it]     = _mm512_mul_pd( _mm512_cvtepi32_pd( _mm512_castsi512_si256( s ) ), vY );
+        buf[2*it + 1] = _mm512_mul_pd( _mm512_cvtepi32_pd( _mm512_extracti64x4_epi64( s, 1 ) ), vY );
+    }
+
+    for( int is = 0; is < nsec; ++is, coef += 5, z1p += zStride, z2p += zStride ) {
+
+        const __m512d   A0  = _mm512_set1_pd( coef[0] ),
+                        A1  = _mm512_set1_pd( coef[1] ),
+                        A2  = _mm512_set1_pd( coef[2] ),
+                        B1  = _mm512_set1_pd( coef[3] ),
+                        B2  = _mm512_set1_pd( coef[4] );
+        __m512d         z1a = _mm512_loadu_pd( z1p ),
+                        z1b = _mm512_loadu_pd( z1p + 8 ),
+                        z2a = _mm512_loadu_pd( z2p ),
+                        z2b = _mm512_loadu_pd( z2p + 8 );
+
+        for( int it = 0; it < ntpts; ++it ) {
+
+            __m512d ina = buf[2*it],
+                    inb = buf[2*it + 1],
+                    oa  = _mm512_add_pd( _mm512_mul_pd( ina, A0 ), z1a ),
+                    ob  = _mm512_add_pd( _mm512_mul_pd( inb, A0 ), z1b );
+
+            z1a = _mm512_sub_pd( _mm512_add_pd( _mm512_mul_pd( ina, A1 ), z2a ), _mm512_mul_pd( B1, oa ) );
+            z1b = _mm512_sub_pd( _mm512_add_pd( _mm512_mul_pd( inb, A1 ), z2b ), _mm512_mul_pd( B1, ob ) );
+            z2a = _mm512_sub_pd( _mm512_mul_pd( ina, A2 ), _mm512_mul_pd( B2, oa ) );
+            z2b = _mm512_sub_pd( _mm512_mul_pd( inb, A2 ), _mm512_mul_pd( B2, ob ) );
+
+            buf[2*it]     = oa;
+            buf[2*it + 1] = ob;
+        }
+
+        _mm512_storeu_pd( z1p,     z1a );
+        _mm512_storeu_pd( z1p + 8, z1b );
+        _mm512_storeu_pd( z2p,     z2a );
+        _mm512_storeu_pd( z2p + 8, z2b );
+    }
+
+    for( int it = 0; it < ntpts; ++it, d += nchans ) {
+
+        __m512d oa = _mm512_min_pd( _mm512_max_pd( _mm512_mul_pd( buf[2*it], vM ), lo ), hi ),
+                ob = _mm512_min_pd( _mm512_max_pd( _mm512_mul_pd( buf[2*it + 1], vM ), lo ), hi );
+        __m512i o  = _mm512_inserti64x4(
+                        _mm512_castsi256_si512( _mm512_cvttpd_epi32( oa ) ),
+                        _mm512_cvttpd_epi32( ob ), 1 );
+
+        _mm256_storeu_si256( (__m256i*)d, _mm512_cvtsepi32_epi16( o ) );
+    }
+}
+
+
+// Float32 cascade over one tile of channels [c,c+16), in place.
+//
+// The tile is already float, so each section simply sweeps it with
+// its state in registers; a tile of 385 channels (~49KB) is mostly
+// L1-resident. Per sample and section the arithmetic is the scalar
+// loop's, in float.
+//
+BQ_AVX2 static void tileSOSFAVX2(
+    float           *d,
+    int             ntpts,
+    int             nchans,
+    int             nsec,
+    const float     *coef,
+    float           *z1p,
+    float           *z2p,
+    int             zStride )
+{
+    for( int is = 0; is < nsec; ++is, coef += 5, z1p += zStride, z2p += zStride ) {
+
+        const __m256    A0  = _mm256_set1_ps( coef[0] ),
+                        A1  = _mm256_set1_ps( coef[1] ),
+                        A2  = _mm256_set1_ps( coef[2] ),
+                        B1  = _mm256_set1_ps( coef[3] ),
+                        B2  = _mm256_set1_ps( coef[4] );
+        __m256          z1a = _mm256_loadu_ps( z1p ),
+                        z1b = _mm256_loadu_ps( z1p + 8 ),
+                        z2a = _mm256_loadu_ps( z2p ),
+                        z2b = _mm256_loadu_ps( z2p + 8 );
+        float           *p  = d;
+
+        for( int it = 0; it < ntpts; ++it, p += nchans ) {
+
+            __m256  ina = _mm256_loadu_ps( p ),
+                    inb = _mm256_loadu_ps( p + 8 ),
+                    oa  = _mm256_add_ps( _mm256_mul_ps( ina, A0 ), z1a ),
+                    ob  = _mm256_add_ps( _mm256_mul_ps( inb, A0 ), z1b );
+
+            z1a = _mm256_sub_ps( _mm256_add_ps( _mm256_mul_ps( ina, A1 ), z2a ), _mm256_mul_ps( B1, oa ) );
+            z1b = _mm256_sub_ps( _mm256_add_ps( _mm256_mul_ps( inb, A1 ), z2b ), _mm256_mul_ps( B1, ob ) );
+            z2a = _mm256_sub_ps( _mm256_mul_ps( ina, A2 ), _mm256_mul_ps( B2, oa ) );
+            z2b = _mm256_sub_ps( _mm256_mul_ps( inb, A2 ), _mm256_mul_ps( B2, ob ) );
+
+            _mm256_storeu_ps( p,     oa );
+            _mm256_storeu_ps( p + 8, ob );
+        }
+
+        _mm256_storeu_ps( z1p,     z1a );
+        _mm256_storeu_ps( z1p + 8, z1b );
+        _mm256_storeu_ps( z2p,     z2a );
+        _mm256_storeu_ps( z2p + 8, z2b );
+    }
+}
+
+
+// As tileSOSFAVX2, for channels [c,c+32). Two vectors in flight
+// hide the latency of each one's recursion.
+//
+BQ_AVX512 static void tileSOSFAVX512(
+    float           *d,
+    int             ntpts,
+    int             nchans,
+    int             nsec,
+    const float     *coef,
+    float           *z1p,
+    float           *z2p,
+    int             zStride )
+{
+    for( int is = 0; is < nsec; ++is, coef += 5, z1p += zStride, z2p += zStride ) {
+
+        const __m512    A0  = _mm512_set1_ps( coef[0] ),
+                        A1  = _mm512_set1_ps( coef[1] ),
+                        A2  = _mm512_set1_ps( coef[2] ),
+                        B1  = _mm512_set1_ps( coef[3] ),
+                        B2  = _mm512_set1_ps( coef[4] );
+        __m512          z1a = _mm512_loadu_ps( z1p ),
+                        z1b = _mm512_loadu_ps( z1p + 16 ),
+                        z2a = _mm512_loadu_ps( z2p ),
+                        z2b = _mm512_loadu_ps( z2p + 16 );
+        float           *p  = d;
+
+        for( int it = 0; it < ntpts; ++it, p += nchans ) {
+
+            __m512  ina = _mm512_loadu_ps( p ),
+                    inb = _mm512_loadu_ps( p + 16 ),
+                    oa  = _mm512_add_ps( _mm512_mul_ps( ina, A0 ), z1a ),
+                    ob  = _mm512_add_ps( _mm512_mul_ps( inb, A0 ), z1b );
+
+            z1a = _mm512_sub_ps( _mm512_add_ps( _mm512_mul_ps( ina, A1 ), z2a ), _mm512_mul_ps( B1, oa ) );
+            z1b = _mm512_sub_ps( _mm512_add_ps( _mm512_mul_ps( inb, A1 ), z2b ), _mm512_mul_ps( B1, ob ) );
+            z2a = _mm512_sub_ps( _mm512_mul_ps( ina, A2 ), _mm512_mul_ps( B2, oa ) );
+            z2b = _mm512_sub_ps( _mm512_mul_ps( inb, A2 ), _mm512_mul_ps( B2, ob ) );
+
+            _mm512_storeu_ps( p,      oa );
+            _mm512_storeu_ps( p + 16, ob );
+        }
+
+        _mm512_storeu_ps( z1p,      z1a );
+        _mm512_storeu_ps( z1p + 16, z1b );
+        _mm512_storeu_ps( z2p,      z2a );
+        _mm512_storeu_ps( z2p + 16, z2b );
+    }
+}
+
+
+// Fixed-point cascade over one tile of channels [c,c+16): two
+// vectors of eight int32 lanes, each lane one channel's sample,
+// residual or state pair. Per sample and section the steps are
+// those of BiquadBank::applyRangeQ; pmaddwd is exact and its sums
+// wrap as that loop's do. The first section's input residuals are
+// zero and skipped.
+//
+template<bool first>
+BQ_AVX2 static inline void stepQAVX2(
+    __m256i         &y,
+    __m256i         &r,
+    __m256i         *S,
+    const __m256i   *K )
+{
+    const __m256i   half    = _mm256_set1_epi32( 1 << 13 );
+    __m256i         &P      = S[0],
+                    &Pr     = S[1],
+                    &Q      = S[2],
+                    &Qr     = S[3],
+                    &E      = S[4],
+                    X       = _mm256_blend_epi16( y, _mm256_slli_epi32( P, 16 ), 0xAA ),
+                    Xr      = _mm256_blend_epi16( r, _mm256_slli_epi32( Pr, 16 ), 0xAA ),
+                    acc     = _mm256_add_epi32(
+                                _mm256_add_epi32(
+                                    _mm256_madd_epi16( X, K[0] ),
+                                    _mm256_madd_epi16( P, K[1] ) ),
+                                _mm256_madd_epi16( Q, K[2] ) ),
+                    xl      = _mm256_madd_epi16( Qr, K[5] ),
+                    s       = _mm256_add_epi32(
+                                _mm256_add_epi32(
+                                    _mm256_madd_epi16( Qr, K[2] ),
+                                    _mm256_madd_epi16( X, K[3] ) ),
+                                _mm256_add_epi32(
+                                    _mm256_madd_epi16( P, K[4] ),
+                                    _mm256_madd_epi16( Q, K[5] ) ) );
+
+    if( !first ) {
+
+        xl = _mm256_add_epi32( xl,
+                _mm256_add_epi32(
+                    _mm256_madd_epi16( Xr, K[3] ),
+                    _mm256_madd_epi16( Pr, K[4] ) ) );
+
+        s = _mm256_add_epi32( s,
+                _mm256_add_epi32(
+                    _mm256_madd_epi16( Xr, K[0] ),
+                    _mm256_madd_epi16( Pr, K[1] ) ) );
+    }
+
+    s = _mm256_add_epi32(
+            _mm256_add_epi32( s, _mm256_madd_epi16( E, K[6] ) ),
+            _mm256_srai_epi32( _mm256_add_epi32( xl, half ), 14 ) );
+
+    __m256i n = _mm256_srai_epi32( _mm256_add_epi32( s, half ), 14 );
+
+    acc = _mm256_add_epi32( acc, n );
+
+    __m256i v = _mm256_srai_epi32( _mm256_add_epi32( acc, half ), 14 );
+
+    r = _mm256_sub_epi32( acc, _mm256_slli_epi32( v, 14 ) );
+    y = _mm256_min_epi32(
+            _mm256_max_epi32( v, _mm256_set1_epi32( -32768 ) ),
+            _mm256_set1_epi32( 32767 ) );
+
+    P   = X;
+    Pr  = Xr;
+    Q   = _mm256_blend_epi16( y, _mm256_slli_epi32( Q, 16 ), 0xAA );
+    Qr  = _mm256_blend_epi16( r, _mm256_slli_epi32( Qr, 16 ), 0xAA );
+    E   = _mm256_blend_epi16(
+            _mm256_sub_epi32( s, _mm256_slli_epi32( n, 14 ) ),
+            _mm256_slli_epi32( E, 16 ), 0xAA );
+}
+
+
+// buf[4*it + {0,1,2,3}] = samples a, b, residuals a, b.
+//
+template<bool first>
+BQ_AVX2 static void sectionQAVX2(
+    __m256i     *buf,
+    int         ntpts,
+    const int   *coefQ,
+    int         *q,
+    int         zStride )
+{
+    __m256i K[7],
+            Sa[5],
+            Sb[5];
+
+    for( int k = 0; k < 7; ++k )
+        K[k] = _mm256_set1_epi32( coefQ[k] );
+
+    for( int k = 0; k < 5; ++k ) {
+        Sa[k] = _mm256_loadu_si256( (const __m256i*)(q + k*zStride) );
+        Sb[k] = _mm256_loadu_si256( (const __m256i*)(q + k*zStride + 8) );
+    }
+
+    for( int it = 0; it < ntpts; ++it, buf += 4 ) {
+        stepQAVX2<first>( buf[0], buf[2], Sa, K );
+        stepQAVX2<first>( buf[1], buf[3], Sb, K );
+    }
+
+    for( int k = 0; k < 5; ++k ) {
+        _mm256_storeu_si256( (__m256i*)(q + k*zStride),     Sa[k] );
+        _mm256_storeu_si256( (__m256i*)(q + k*zStride + 8), Sb[k] );
+    }
+}
+
+
+// Sample plus residual, truncated toward zero.
+//
+BQ_AVX2 static inline __m256i towardZeroAVX2( __m256i y, __m256i r )
+{
+    const __m256i   zero = _mm256_setzero_si256();
+
+    // y > 0 && r < 0: -1;  y < 0 && r > 0: +1
+
+    return _mm256_sub_epi32(
+            _mm256_add_epi32( y,
+                _mm256_and_si256(
+                    _mm256_cmpgt_epi32( y, zero ),
+                    _mm256_cmpgt_epi32( zero, r ) ) ),
+            _mm256_and_si256(
+                _mm256_cmpgt_epi32( zero, y ),
+                _mm256_cmpgt_epi32( r, zero ) ) );
+}
+
+
+BQ_AVX2 static void tileSOSQAVX2(
+    short       *d,
+    int         ntpts,
+    int         nchans,
+    int         nsec,
+    const int   *coefQ,
+    int         maxInt,
+    int         *q,
+    int         zStride )
+{
+    __m256i         buf[4 * BQ_TILE_TPTS];
+    const __m256i   lo  = _mm256_set1_epi16( short(-maxInt) ),
+                    hi  = _mm256_set1_epi16( short(maxInt - 1) );
+    short           *p  = d;
+
+    for( int it = 0; it < ntpts; ++it, p += nchans ) {
+
+        __m256i s = _mm256_loadu_si256( (const __m256i*)p );
+
+        buf[4*it]     = _mm256_cvtepi16_epi32( _mm256_castsi256_si128( s ) );
+        buf[4*it + 1] = _mm256_cvtepi16_epi32( _mm256_extracti128_si256( s, 1 ) );
+        buf[4*it + 2] = _mm256_setzero_si256();
+        buf[4*it + 3] = _mm256_setzero_si256();
+    }
+
+    for( int is = 0; is < nsec; ++is, coefQ += 7, q += 5*zStride ) {
+
+        if( !is )
+            sectionQAVX2<true>( buf, ntpts, coefQ, q, zStride );
+        else
+            sectionQAVX2<false>( buf, ntpts, coefQ, q, zStride );
+    }
+
+    for( int it = 0; it < ntpts; ++it, d += nchans ) {
+
+        __m256i o = _mm256_permute4x64_epi64(
+                        _mm256_packs_epi32(
+                            towardZeroAVX2( buf[4*it],     buf[4*it + 2] ),
+                            towardZeroAVX2( buf[4*it + 1], buf[4*it + 3] ) ),
+                        0xD8 );
+
+        o = _mm256_min_epi16( _mm256_max_epi16( o, lo ), hi );
+
+        _mm256_storeu_si256( (__m256i*)d, o );
+    }
+}
+
+
+// SSE2 form of the above, for channels [c,c+8): without blends or
+// 32-bit min/max, pairs are built with and/or and clamping goes
+// through packs.
+//
+static inline __m128i pairSSE2( __m128i lo, __m128i hi )
+{
+    return _mm_or_si128(
+            _mm_and_si128( lo, _mm_set1_epi32( 0xFFFF ) ),
+            _mm_slli_epi32( hi, 16 ) );
+}
+
+
+template<bool first>
+static inline void stepQSSE2(
+    __m128i         &y,
+    __m128i         &r,
+    __m128i         *S,
+    const __m128i   *K )
+{
+    const __m128i   half    = _mm_set1_epi32( 1 << 13 );
+    __m128i         &P      = S[0],
+                    &Pr     = S[1],
+                    &Q      = S[2],
+                    &Qr     = S[3],
+                    &E      = S[4],
+                    X       = pairSSE2( y, P ),
+                    Xr      = pairSSE2( r, Pr ),
+                    acc     = _mm_add_epi32(
+                                _mm_add_epi32(
+                                    _mm_madd_epi16( X, K[0] ),
+                                    _mm_madd_epi16( P, K[1] ) ),
+                                _mm_madd_epi16( Q, K[2] ) ),
+                    xl      = _mm_madd_epi16( Qr, K[5] ),
+                    s       = _mm_add_epi32(
+                                _mm_add_epi32(
+                                    _mm_madd_epi16( Qr, K[2] ),
+                                    _mm_madd_epi16( X, K[3] ) ),
+                                _mm_add_epi32(
+                                    _mm_madd_epi16( P, K[4] ),
+                                    _mm_madd_epi16( Q, K[5] ) ) );
+
+    if( !first ) {
+
+        xl = _mm_add_epi32( xl,
+                _mm_add_epi32(
+                    _mm_madd_epi16( Xr, K[3] ),
+                    _mm_madd_epi16( Pr, K[4] ) ) );
+
+        s = _mm_add_epi32( s,
+                _mm_add_epi32(
+                    _mm_madd_epi16( Xr, K[0] ),
+                    _mm_madd_epi16( Pr, K[1] ) ) );
+    }
+
+    s = _mm_add_epi32(
+            _mm_add_epi32( s, _mm_madd_epi16( E, K[6] ) ),
+            _mm_srai_epi32( _mm_add_epi32( xl, half ), 14 ) );
+
+    __m128i n = _mm_srai_epi32( _mm_add_epi32( s, half ), 14 );
+
+    acc = _mm_add_epi32( acc, n );
+
+    __m128i v = _mm_srai_epi32( _mm_add_epi32( acc, half ), 14 ),
+            c = _mm_packs_epi32( v, v );
+
+    r = _mm_sub_epi32( acc, _mm_slli_epi32( v, 14 ) );
+    y = _mm_srai_epi32( _mm_unpacklo_epi16( c, c ), 16 );
+
+    P   = X;
+    Pr  = Xr;
+    Q   = pairSSE2( y, Q );
+    Qr  = pairSSE2( r, Qr );
+    E   = pairSSE2( _mm_sub_epi32( s, _mm_slli_epi32( n, 14 ) ), E );
+}
+
+
+template<bool first>
+static void sectionQSSE2(
+    __m128i     *buf,
+    int         ntpts,
+    const int   *coefQ,
+    int         *q,
+    int         zStride )
+{
+    __m128i K[7],
+            Sa[5],
+            Sb[5];
+
+    for( int k = 0; k < 7; ++k )
+        K[k] = _mm_set1_epi32( coefQ[k] );
+
+    for( int k = 0; k < 5; ++k ) {
+        Sa[k] = _mm_loadu_si128( (const __m128i*)(q + k*zStride) );
+        Sb[k] = _mm_loadu_si128( (const __m128i*)(q + k*zStride + 4) );
+    }
+
+    for( int it = 0; it < ntpts; ++it, buf += 4 ) {
+        stepQSSE2<first>( buf[0], buf[2], Sa, K );
+        stepQSSE2<first>( buf[1], buf[3], Sb, K );
+    }
+
+    for( int k = 0; k < 5; ++k ) {
+        _mm_storeu_si128( (__m128i*)(q + k*zStride),     Sa[k] );
+        _mm_storeu_si128( (__m128i*)(q + k*zStride + 4), Sb[k] );
+    }
+}
+
+
+static inline __m128i towardZeroSSE2( __m128i y, __m128i r )
+{
+    const __m128i   zero = _mm_setzero_si128();
+
+    return _mm_sub_epi32(
+            _mm_add_epi32( y,
+                _mm_and_si128(
+                    _mm_cmpgt_epi32( y, zero ),
+                    _mm_cmplt_epi32( r, zero ) ) ),
+            _mm_and_si128(
+                _mm_cmplt_epi32( y, zero ),
+                _mm_cmpgt_epi32( r, zero ) ) );
+}
+
+
+static void tileSOSQSSE2(
+    short       *d,
+    int         ntpts,
+    int         nchans,
+    int         nsec,
+    const int   *coefQ,
+    int         maxInt,
+    int         *q,
+    int         zStride )
+{
+    __m128i         buf[4 * BQ_TILE_TPTS];
+    const __m128i   lo  = _mm_set1_epi16( short(-maxInt) ),
+                    hi  = _mm_set1_epi16( short(maxInt - 1) );
+    short           *p  = d;
+
+    for( int it = 0; it < ntpts; ++it, p += nchans ) {
+
+        __m128i s = _mm_loadu_si128( (const __m128i*)p );
+
+        buf[4*it]     = _mm_srai_epi32( _mm_unpacklo_epi16( s, s ), 16 );
+        buf[4*it + 1] = _mm_srai_epi32( _mm_unpackhi_epi16( s, s ), 16 );
+        buf[4*it + 2] = _mm_setzero_si128();
+        buf[4*it + 3] = _mm_setzero_si128();
+    }
+
+    for( int is = 0; is < nsec; ++is, coefQ += 7, q += 5*zStride ) {
+
+        if( !is )
+            sectionQSSE2<true>( buf, ntpts, coefQ, q, zStride );
+        else
+            sectionQSSE2<false>( buf, ntpts, coefQ, q, zStride );
+    }
+
+    for( int it = 0; it < ntpts; ++it, d += nchans ) {
+
+        __m128i o = _mm_packs_epi32(
+                        towardZeroSSE2( buf[4*it],     buf[4*it + 2] ),
+                        towardZeroSSE2( buf[4*it + 1], buf[4*it + 3] ) );
+
+        _mm_storeu_si128( (__m128i*)d, _mm_min_epi16( _mm_max_epi16( o, lo ), hi ) );
+    }
+}
+
+#endif  // BQ_X86
+
+
+int biquadSimdApply(
+    short           *data,
+    int             maxInt,
+    int             ntpts,
+    int             nchans,
+    int             nc,
+    const double    *coef,
+    double          *vz1,
+    double          *vz2 )
+{
+#ifdef BQ_X86
+    CpuISA  isa = cpuISA();
+
+    if( isa == cpu_isa_base )
+        return 0;
+
+    int     width   = (isa == cpu_isa_avx512 ? 16 : 8),
+            cVec    = nc - nc % width;
+    double  Y       = 1.0 / maxInt,
+            M       = maxInt;
+
+    for( int t0 = 0; t0 < ntpts; t0 += BQ_TILE_TPTS ) {
+
+        int     nt  = std::min( BQ_TILE_TPTS, ntpts - t0 );
+        short   *d  = data + t0 * nchans;
+
+        for( int c = 0; c < cVec; c += width ) {
+
+            if( isa == cpu_isa_avx512 )
+                tileAVX512( d + c, nt, nchans, coef, Y, M, vz1 + c, vz2 + c );
+            else
+                tileAVX2( d + c, nt, nchans, coef, Y, M, vz1 + c, vz2 + c );
+        }
+    }
+
+    return cVec;
+#else
+    return 0;
+#endif
+}
+
+
+
+
+int biquadSimdApplySOS(
+    short           *data,
+    int             maxInt,
+    int             ntpts,
+    int             nchans,
+    int             nc,
+    int             nsec,
+    const double    *coef,
+    double          *vz1,
+    double          *vz2,
+    int             zStride )
+{
+#ifdef BQ_X86
+    CpuISA  isa = cpuISA();
+
+    if( isa == cpu_isa_base )
+        return 0;
+
+    int     width   = (isa == cpu_isa_avx512 ? 16 : 8),
+            cVec    = nc - nc % width;
+    double  Y       = 1.0 / maxInt,
+            M       = maxInt;
+
+    for( int t0 = 0; t0 < ntpts; t0 += BQ_TILE_TPTS ) {
+
+        int     nt  = std::min( BQ_TILE_TPTS, ntpts - t0 );
+        short   *d  = data + t0 * nchans;
+
+        for( int c = 0; c < cVec; c += width ) {
+
+            if( isa == cpu_isa_avx512 ) {
+                tileSOSAVX512( d + c, nt, nchans, nsec, coef, Y, M,
+                    vz1 + c, vz2 + c, zStride );
+            }
+            else {
+                tileSOSAVX2( d + c, nt, nchans, nsec, coef, Y, M,
+                    vz1 + c, vz2 + c, zStride );
+            }
+        }
+    }
+
+    return cVec;
+#else
+    return 0;
+#endif
+}
+
+
+int biquadSimdApplySOSF(
+    float           *data,
+    int             ntpts,
+    int             nchans,
+    int             nc,
+    int             nsec,
+    const float     *coef,
+    float           *vz1,
+    float           *vz2,
+    int             zStride )
+{
+#ifdef BQ_X86
+    CpuISA  isa = cpuISA();
+
+    if( isa == cpu_isa_base )
+        return 0;
+
+    int cVec = nc - nc % 16;
+
+    for( int t0 = 0; t0 < ntpts; t0 += BQ_TILE_TPTS ) {
+
+        int     nt  = std::min( BQ_TILE_TPTS, ntpts - t0 );
+        float   *d  = data + t0 * nchans;
+
+        int c = 0;
+
+        // AVX-512 takes pairs of groups; an odd group is AVX2's
+
+        if( isa == cpu_isa_avx512 ) {
+
+            for( ; c + 32 <= cVec; c += 32 ) {
+                tileSOSFAVX512( d + c, nt, nchans, nsec, coef,
+                    vz1 + c, vz2 + c, zStride );
+            }
+        }
+
+        for( ; c < cVec; c += 16 ) {
+            tileSOSFAVX2( d + c, nt, nchans, nsec, coef,
+                vz1 + c, vz2 + c, zStride );
+        }
+    }
+
+    return cVec;
+#else
+    return 0;
+#endif
+}
+
+
+int biquadSimdApplySOSQ(
+    short           *data,
+    int             maxInt,
+    int             ntpts,
+    int             nchans,
+    int             nc,
+    int             nsec,
+    const int       *coefQ,
+    int             *q,
+    int             zStride )
+{
+#ifdef BQ_X86
+    bool    avx2    = (cpuISA() >= cpu_isa_avx2);
+    int     width   = (avx2 ? 16 : 8),
+            cVec    = nc - nc % width;
+
+    for( int t0 = 0; t0 < ntpts; t0 += BQ_TILE_TPTS ) {
+
+        int     nt  = std::min( BQ_TILE_TPTS, ntpts - t0 );
+        short   *d  = data + t0 * nchans;
+
+        for( int c = 0; c < cVec; c += width ) {
+
+            if( avx2 )
+                tileSOSQAVX2( d + c, nt, nchans, nsec, coefQ, maxInt, q + c, zStride );
+            else
+                tileSOSQSSE2( d + c, nt, nchans, nsec, coefQ, maxInt, q + c, zStride );
+        }
+    }
+
+    return cVec;
+#else
+    return 0;
+#endif
+}
+
+
@@ -0,0 +1,94 @@
+#ifndef BIQUADSIMD_H
+#define BIQUADSIMD_H
+
+/* ---------------------------------------------------------------- */
+/* Functions ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Kernels are AVX2 or AVX-512 as cpuISA() selects (CpuDispatch.h).
+//
+// Vectorized form of Biquad::applyBlockwiseMem, across channels.
+//
+// Filter channels [0,nc) of (ntpts) interleaved timepoints at
+// (data), array stride (nchans). coef[] = {a0,a1,a2,b1,b2}; the
+// state of channel c is (vz1[c], vz2[c]).
+//
+// Channels go in groups of 8 (AVX2) or 16 (AVX-512), in time tiles
+// short enough to stay in cache, with each group's state held in
+// registers across the tile. The arithmetic is the scalar loop's,
+// operation for operation in double precision, so results are
+// identical.
+//
+// Return the number of leading channels done (a multiple of the
+// group size, 0 if no vector ISA); the caller does the rest.
+//
+int biquadSimdApply(
+    short           *data,
+    int             maxInt,
+    int             ntpts,
+    int             nchans,
+    int             nc,
+    const double    *coef,
+    double          *vz1,
+    double          *vz2 );
+
+// As biquadSimdApply, for a cascade of (nsec) sections applied in
+// one pass: coef[5*s + k] are section (s)'s coefficients, and its
+// state for channel c is (vz1[s*zStride + c], vz2[s*zStride + c]).
+// Each time tile is read and written once; samples are carried in
+// double from section to section.
+//
+int biquadSimdApplySOS(
+    short           *data,
+    int             maxInt,
+    int             ntpts,
+    int             nchans,
+    int             nc,
+    int             nsec,
+    const double    *coef,
+    double          *vz1,
+    double          *vz2,
+    int             zStride );
+
+// Float32 form of biquadSimdApplySOS, for data already converted
+// from int16: filtered in place, not rounded or clipped. State and
+// coefficients are float too, so a vector holds twice the channels.
+// Groups are 16 channels (AVX-512 does them in pairs); the count
+// done is a multiple of 16. The scalar reference is
+// BiquadBank::applyRangeF, which gets the same results.
+//
+int biquadSimdApplySOSF(
+    float           *data,
+    int             ntpts,
+    int             nchans,
+    int             nc,
+    int             nsec,
+    const float     *coef,
+    float           *vz1,
+    float           *vz2,
+    int             zStride );
+
+// Fixed-point form of biquadSimdApplySOS (BiquadBank::applyRangeQ
+// is the scalar reference, and gets the same integers). coefQ[7*s]
+// are section (s)'s packed coefficient words; its state pairs for
+// channel c are q[(5*s + k)*zStride + c], k = 0..4.
+//
+// Integer SIMD: groups of 16 channels with AVX2 (or AVX-512, which
+// adds nothing here without AVX-512BW), 8 with SSE2, so unlike the
+// double kernels this one also serves cpu_isa_base. The count done
+// is a multiple of the group size.
+//
+int biquadSimdApplySOSQ(
+    short           *data,
+    int             maxInt,
+    int             ntpts,
+    int             nchans,
+    int             nc,
+    int             nsec,
+    const int       *coefQ,
+    int             *q,
+    int             zStride );
+
+#endif  // BIQUADSIMD_H
+
+
@@ -0,0 +1,892 @@
+
+#include "ChannelMixer.h"
+#include "CpuDispatch.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MIX_X86
+#include <immintrin.h>
+#endif
+
+#if defined(MIX_X86) && !defined(_MSC_VER)
+#define MIX_AVX2    __attribute__((target("avx2")))
+#else
+#define MIX_AVX2
+#endif
+
+// Rows per tile: 32 rows of a 385-channel probe (~49KB) go past
+// each dense panel while it is in L1.
+
+#define MIX_TILE_ROWS   32
+
+
+/* ---------------------------------------------------------------- */
+/* Symmetric eigensystem ------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Householder reduction of symmetric (V) (n x n, row-major) to
+// tridiagonal form (d = diagonal, e = subdiagonal), V accumulating
+// the transformation. After the public-domain JAMA/EISPACK tred2.
+//
+static void tred2( int n, double *V, double *d, double *e )
+{
+    for( int j = 0; j < n; ++j )
+        d[j] = V[(n-1)*n + j];
+
+    for( int i = n - 1; i > 0; --i ) {
+
+        double  scale   = 0,
+                h       = 0;
+
+        for( int k = 0; k < i; ++k )
+            scale += fabs( d[k] );
+
+        if( scale == 0 ) {
+
+            e[i] = d[i-1];
+
+            for( int j = 0; j < i; ++j ) {
+                d[j]        = V[(i-1)*n + j];
+                V[i*n + j]  = 0;
+                V[j*n + i]  = 0;
+            }
+        }
+        else {
+
+            for( int k = 0; k < i; ++k ) {
+                d[k] /= scale;
+                h    += d[k] * d[k];
+            }
+
+            double  f = d[i-1],
+                    g = sqrt( h );
+
+            if( f > 0 )
+                g = -g;
+
+            e[i]    = scale * g;
+            h      -= f * g;
+            d[i-1]  = f - g;
+
+            for( int j = 0; j < i; ++j )
+                e[j] = 0;
+
+            for( int j = 0; j < i; ++j ) {
+
+                f           = d[j];
+                V[j*n + i]  = f;
+                g           = e[j] + V[j*n + j] * f;
+
+                for( int k = j + 1; k <= i - 1; ++k ) {
+                    g    += V[k*n + j] * d[k];
+                    e[k] += V[k*n + j] * f;
+                }
+
+                e[j] = g;
+            }
+
+            f = 0;
+
+            for( int j = 0; j < i; ++j ) {
+                e[j] /= h;
+                f    += e[j] * d[j];
+            }
+
+            double  hh = f / (h + h);
+
+            for( int j = 0; j < i; ++j )
+                e[j] -= hh * d[j];
+
+            for( int j = 0; j < i; ++j ) {
+
+                f = d[j];
+                g = e[j];
+
+                for( int k = j; k <= i - 1; ++k )
+                    V[k*n + j] -= (f * e[k] + g * d[k]);
+
+                d[j]        = V[(i-1)*n + j];
+                V[i*n + j]  = 0;
+            }
+        }
+
+        d[i] = h;
+    }
+
+    for( int i = 0; i < n - 1; ++i ) {
+
+        V[(n-1)*n + i]  = V[i*n + i];
+        V[i*n + i]      = 1;
+
+        double  h = d[i+1];
+
+        if( h != 0 ) {
+
+            for( int k = 0; k <= i; ++k )
+                d[k] = V[k*n + i+1] / h;
+
+            for( int j = 0; j <= i; ++j ) {
+
+                double  g = 0;
+
+                for( int k = 0; k <= i; ++k )
+                    g += V[k*n + i+1] * V[k*n + j];
+
+                for( int k = 0; k <= i; ++k )
+                    V[k*n + j] -= g * d[k];
+            }
+        }
+
+        for( int k = 0; k <= i; ++k )
+            V[k*n + i+1] = 0;
+    }
+
+    for( int j = 0; j < n; ++j ) {
+        d[j]            = V[(n-1)*n + j];
+        V[(n-1)*n + j]  = 0;
+    }
+
+    V[(n-1)*n + n-1]    = 1;
+    e[0]                = 0;
+}
+
+
+// Implicit QL on the tridiagonal (d,e) from tred2: eigenvalues to
+// (d), eigenvectors to the columns of (V). After JAMA tql2.
+//
+static void tql2( int n, double *V, double *d, double *e )
+{
+    for( int i = 1; i < n; ++i )
+        e[i-1] = e[i];
+
+    e[n-1] = 0;
+
+    double  f       = 0,
+            tst1    = 0,
+            eps     = pow( 2.0, -52.0 );
+
+    for( int l = 0; l < n; ++l ) {
+
+        tst1 = std::max( tst1, fabs( d[l] ) + fabs( e[l] ) );
+
+        int m = l;
+
+        while( m < n - 1 && fabs( e[m] ) > eps * tst1 )
+            ++m;
+
+        if( m > l ) {
+
+            do {
+                double  g   = d[l],
+                        p   = (d[l+1] - g) / (2 * e[l]),
+                        r   = hypot( p, 1.0 );
+
+                if( p < 0 )
+                    r = -r;
+
+                d[l]    = e[l] / (p + r);
+                d[l+1]  = e[l] * (p + r);
+
+                double  dl1 = d[l+1],
+                        h   = g - d[l];
+
+                for( int i = l + 2; i < n; ++i )
+                    d[i] -= h;
+
+                f += h;
+
+                p = d[m];
+
+                double  c   = 1,
+                        c2  = c,
+                        c3  = c,
+                        el1 = e[l+1],
+                        s   = 0,
+                        s2  = 0;
+
+                for( int i = m - 1; i >= l; --i ) {
+
+                    c3      = c2;
+                    c2      = c;
+                    s2      = s;
+                    g       = c * e[i];
+                    h       = c * p;
+                    r       = hypot( p, e[i] );
+                    e[i+1]  = s * r;
+                    s       = e[i] / r;
+                    c       = p / r;
+                    p       = c * d[i] - s * g;
+                    d[i+1]  = h + s * (c * g + s * d[i]);
+
+                    for( int k = 0; k < n; ++k ) {
+
+                        double  *vk = &V[k*n];
+
+                        h       = vk[i+1];
+                        vk[i+1] = s * vk[i] + c * h;
+                        vk[i]   = c * vk[i] - s * h;
+                    }
+                }
+
+                p       = -s * s2 * c3 * el1 * e[l] / dl1;
+                e[l]    = s * p;
+                d[l]    = c * p;
+
+            } while( fabs( e[l] ) > eps * tst1 );
+        }
+
+        d[l] += f;
+        e[l]  = 0;
+    }
+}
+
+
+// (A) (n x n covariance) becomes its regularized inverse square
+// root V diag(1/sqrt(lambda + eps)) V'.
+//
+static void invSqrt( std::vector<double> &A, int n )
+{
+    std::vector<double> d( n ), e( n ), w( n );
+
+    tred2( n, &A[0], &d[0], &e[0] );
+    tql2( n, &A[0], &d[0], &e[0] );
+
+    double  mean = 0;
+
+    for( int k = 0; k < n; ++k )
+        mean += std::max( d[k], 0.0 );
+
+    mean /= n;
+
+    for( int k = 0; k < n; ++k )
+        w[k] = 1 / sqrt( std::max( d[k], 0.0 ) + 1e-3 * mean + 1e-30 );
+
+    std::vector<double> M( size_t(n) * n );
+
+    for( int i = 0; i < n; ++i ) {
+
+        for( int j = i; j < n; ++j ) {
+
+            const double    *vi = &A[i*n],
+                            *vj = &A[j*n];
+            double          s   = 0;
+
+            for( int k = 0; k < n; ++k )
+                s += vi[k] * w[k] * vj[k];
+
+            M[i*n + j] = s;
+            M[j*n + i] = s;
+        }
+    }
+
+    A.swap( M );
+}
+
+/* ---------------------------------------------------------------- */
+/* Kernels -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#ifdef MIX_X86
+
+// Rows [0,nr) (nr <= 4) of X (stride ldx) times one packed panel
+// (K rows of 16): 16 outputs per row to Y (stride ldy).
+//
+MIX_AVX2 static void panelAVX2(
+    const float *X,
+    int         ldx,
+    int         nr,
+    const float *P,
+    int         K,
+    float       *Y,
+    int         ldy )
+{
+    const float *x0 = X,
+                *x1 = X + (nr > 1 ? ldx : 0),
+                *x2 = X + (nr > 2 ? 2*ldx : 0),
+                *x3 = X + (nr > 3 ? 3*ldx : 0);
+    __m256      a0l = _mm256_setzero_ps(), a0h = a0l,
+                a1l = a0l, a1h = a0l,
+                a2l = a0l, a2h = a0l,
+                a3l = a0l, a3h = a0l;
+
+    for( int k = 0; k < K; ++k, P += 16 ) {
+
+        __m256  bl = _mm256_loadu_ps( P ),
+                bh = _mm256_loadu_ps( P + 8 ),
+                v;
+
+        v   = _mm256_broadcast_ss( x0 + k );
+        a0l = _mm256_add_ps( a0l, _mm256_mul_ps( v, bl ) );
+        a0h = _mm256_add_ps( a0h, _mm256_mul_ps( v, bh ) );
+        v   = _mm256_broadcast_ss( x1 + k );
+        a1l = _mm256_add_ps( a1l, _mm256_mul_ps( v, bl ) );
+        a1h = _mm256_add_ps( a1h, _mm256_mul_ps( v, bh ) );
+        v   = _mm256_broadcast_ss( x2 + k );
+        a2l = _mm256_add_ps( a2l, _mm256_mul_ps( v, bl ) );
+        a2h = _mm256_add_ps( a2h, _mm256_mul_ps( v, bh ) );
+        v   = _mm256_broadcast_ss( x3 + k );
+        a3l = _mm256_add_ps( a3l, _mm256_mul_ps( v, bl ) );
+        a3h = _mm256_add_ps( a3h, _mm256_mul_ps( v, bh ) );
+    }
+
+    _mm256_storeu_ps( Y,     a0l );
+    _mm256_storeu_ps( Y + 8, a0h );
+
+    if( nr > 1 ) {
+        _mm256_storeu_ps( Y + ldy,     a1l );
+        _mm256_storeu_ps( Y + ldy + 8, a1h );
+    }
+
+    if( nr > 2 ) {
+        _mm256_storeu_ps( Y + 2*ldy,     a2l );
+        _mm256_storeu_ps( Y + 2*ldy + 8, a2h );
+    }
+
+    if( nr > 3 ) {
+        _mm256_storeu_ps( Y + 3*ldy,     a3l );
+        _mm256_storeu_ps( Y + 3*ldy + 8, a3h );
+    }
+}
+
+
+// One row through the banded form: y[i] = sum_k D[k][i] x[i+k],
+// (x) already offset by -b and zero-padded. Returns channels done
+// (a multiple of 8); the caller does the rest.
+//
+MIX_AVX2 static int bandAVX2(
+    const float *x,
+    const float *D,
+    int         nchans,
+    int         ndiag,
+    float       *y )
+{
+    int nVec = nchans - nchans % 8;
+
+    for( int i = 0; i < nVec; i += 8 ) {
+
+        __m256  acc = _mm256_setzero_ps();
+
+        for( int k = 0; k < ndiag; ++k ) {
+
+            acc = _mm256_add_ps( acc,
+                    _mm256_mul_ps(
+                        _mm256_loadu_ps( D + size_t(k) * nchans + i ),
+                        _mm256_loadu_ps( x + i + k ) ) );
+        }
+
+        _mm256_storeu_ps( y + i, acc );
+    }
+
+    return nVec;
+}
+
+
+// Upper triangle of C (n x n) += sum over the 4 rows r of V (stride
+// n) of V[r]' V[r].
+//
+MIX_AVX2 static void rank4AVX2( double *C, int n, const double *V )
+{
+    for( int i = 0; i < n; ++i ) {
+
+        __m256d u0  = _mm256_set1_pd( V[i] ),
+                u1  = _mm256_set1_pd( V[n + i] ),
+                u2  = _mm256_set1_pd( V[2*n + i] ),
+                u3  = _mm256_set1_pd( V[3*n + i] );
+        double  *ci = C + size_t(i) * n;
+        int     j   = i;
+
+        for( ; j + 4 <= n; j += 4 ) {
+
+            __m256d acc = _mm256_add_pd(
+                            _mm256_add_pd(
+                                _mm256_mul_pd( u0, _mm256_loadu_pd( V + j ) ),
+                                _mm256_mul_pd( u1, _mm256_loadu_pd( V + n + j ) ) ),
+                            _mm256_add_pd(
+                                _mm256_mul_pd( u2, _mm256_loadu_pd( V + 2*n + j ) ),
+                                _mm256_mul_pd( u3, _mm256_loadu_pd( V + 3*n + j ) ) ) );
+
+            _mm256_storeu_pd( ci + j, _mm256_add_pd( _mm256_loadu_pd( ci + j ), acc ) );
+        }
+
+        for( ; j < n; ++j ) {
+
+            ci[j] += (V[i] * V[j] + V[n + i] * V[n + j])
+                    + (V[2*n + i] * V[2*n + j] + V[3*n + i] * V[3*n + j]);
+        }
+    }
+}
+
+#endif  // MIX_X86
+
+/* ---------------------------------------------------------------- */
+/* ChannelMixer --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+ChannelMixer::ChannelMixer()
+    :   mode(mix_none), nchans(0), b(-1),
+        nGot(0), nWant(0), stride(1), phase(0), nNbr(32)
+{
+}
+
+
+void ChannelMixer::setChannels(
+    const std::vector<int>      &group,
+    const std::vector<float>    &x,
+    const std::vector<float>    &z,
+    int                         nNbr )
+{
+    this->group = group;
+    this->x     = x;
+    this->z     = z;
+    this->nNbr  = nNbr;
+    nchans      = int(group.size());
+
+    // Tile scratch for the widest shapes: a banded W has 4(2b+1) <=
+    // nchans; a dense one pads Y rows to whole panels.
+
+    X.assign( size_t(MIX_TILE_ROWS) * (nchans + nchans / 4), 0.0f );
+    Y.assign( size_t(MIX_TILE_ROWS) * 16 * ((nchans + 15) / 16), 0.0f );
+
+    inc.clear();
+
+    for( int c = 0; c < nchans; ++c ) {
+
+        if( group[c] >= 0 )
+            inc.push_back( c );
+    }
+
+    W.clear();
+    panel.clear();
+    diag.clear();
+    b       = -1;
+    mode    = mix_none;
+    nGot    = 0;
+    nWant   = 0;
+}
+
+
+void ChannelMixer::begin( MixMode mode, int nScans, int stride )
+{
+    W.clear();
+    panel.clear();
+    diag.clear();
+    b = -1;
+
+    int ni = int(inc.size());
+
+    this->mode      = (ni ? mode : mix_none);
+    this->stride    = std::max( 1, stride );
+    nWant           = (this->mode != mix_none ? std::max( nScans, 2 ) : 0);
+    nGot            = 0;
+    phase           = 0;
+
+    cov.assign( this->mode != mix_none ? size_t(ni) * ni : 0, 0 );
+    sum.assign( this->mode != mix_none ? ni : 0, 0 );
+    pend.assign( this->mode != mix_none ? 4 * ni : 0, 0 );
+}
+
+
+void ChannelMixer::accumulate( const short *data, int ntpts, int nchans )
+{
+    if( estimating() && nchans == this->nchans )
+        addScans( data, ntpts );
+}
+
+
+void ChannelMixer::accumulate( const float *data, int ntpts, int nchans )
+{
+    if( estimating() && nchans == this->nchans )
+        addScans( data, ntpts );
+}
+
+
+// Upper triangle of the sum of x x' over included channels. Taken
+// rows are buffered and added four at a time, so the covariance is
+// swept once per four rows.
+//
+template<typename T>
+void ChannelMixer::addScans( const T *data, int ntpts )
+{
+    int ni = int(inc.size());
+
+    for( int it = 0; it < ntpts && nGot < nWant; ++it, data += nchans ) {
+
+        if( phase++ % stride )
+            continue;
+
+        int     np  = nGot % 4;
+        double  *v  = &pend[size_t(np) * ni];
+
+        for( int i = 0; i < ni; ++i ) {
+            v[i]    = data[inc[i]];
+            sum[i] += v[i];
+        }
+
+        ++nGot;
+
+        if( np == 3 || nGot == nWant )
+            addPending( np + 1 );
+
+        if( nGot == nWant )
+            estimate();
+    }
+}
+
+
+void ChannelMixer::addPending( int nv )
+{
+    int ni = int(inc.size());
+
+#ifdef MIX_X86
+    if( nv == 4 && cpuISA() >= cpu_isa_avx2 ) {
+        rank4AVX2( &cov[0], ni, &pend[0] );
+        return;
+    }
+#endif
+
+    for( int r = 0; r < nv; ++r ) {
+
+        const double    *v = &pend[size_t(r) * ni];
+
+        for( int i = 0; i < ni; ++i ) {
+
+            double  vi  = v[i],
+                    *ci = &cov[size_t(i) * ni];
+
+            for( int j = i; j < ni; ++j )
+                ci[j] += vi * v[j];
+        }
+    }
+}
+
+
+void ChannelMixer::estimate()
+{
+    int                 ni = int(inc.size());
+    std::vector<double> C( size_t(ni) * ni );
+
+    for( int i = 0; i < ni; ++i ) {
+
+        for( int j = i; j < ni; ++j ) {
+
+            double  c = (cov[size_t(i)*ni + j] - sum[i] * sum[j] / nGot)
+                        / (nGot - 1);
+
+            C[size_t(i)*ni + j] = c;
+            C[size_t(j)*ni + i] = c;
+        }
+    }
+
+    cov.clear();
+    sum.clear();
+    pend.clear();
+
+// Output scale: median channel RMS
+
+    std::vector<double> var( ni );
+
+    for( int i = 0; i < ni; ++i )
+        var[i] = C[size_t(i)*ni + i];
+
+    std::nth_element( var.begin(), var.begin() + ni/2, var.end() );
+
+    double  scale = sqrt( std::max( var[ni/2], 0.0 ) );
+
+// Identity for excluded channels
+
+    std::vector<float>  Wn( size_t(nchans) * nchans, 0.0f );
+
+    for( int c = 0; c < nchans; ++c ) {
+
+        if( group[c] < 0 )
+            Wn[size_t(c)*nchans + c] = 1;
+    }
+
+    if( mode == mix_zca ) {
+
+        invSqrt( C, ni );
+
+        for( int i = 0; i < ni; ++i ) {
+
+            for( int j = 0; j < ni; ++j )
+                Wn[size_t(inc[i])*nchans + inc[j]] = float(scale * C[size_t(i)*ni + j]);
+        }
+    }
+    else {
+
+        std::vector<std::pair<float,int> >  nbr;
+        std::vector<int>                    L;
+        std::vector<double>                 Cl;
+
+        for( int i = 0; i < ni; ++i ) {
+
+            int ci = inc[i];
+
+            // Nearest same-shank sites, self first
+
+            nbr.clear();
+
+            for( int j = 0; j < ni; ++j ) {
+
+                int cj = inc[j];
+
+                if( group[cj] != group[ci] )
+                    continue;
+
+                float   dx = x[cj] - x[ci],
+                        dz = z[cj] - z[ci];
+
+                nbr.push_back( std::make_pair( dx*dx + dz*dz, j ) );
+            }
+
+            int nl = std::min( nNbr, int(nbr.size()) );
+
+            std::partial_sort( nbr.begin(), nbr.begin() + nl, nbr.end() );
+
+            L.resize( nl );
+
+            for( int k = 0; k < nl; ++k )
+                L[k] = nbr[k].second;
+
+            std::sort( L.begin(), L.end() );
+
+            Cl.resize( size_t(nl) * nl );
+
+            for( int r = 0; r < nl; ++r ) {
+
+                for( int s = 0; s < nl; ++s )
+                    Cl[size_t(r)*nl + s] = C[size_t(L[r])*ni + L[s]];
+            }
+
+            invSqrt( Cl, nl );
+
+            int self = int(std::find( L.begin(), L.end(), i ) - L.begin());
+
+            for( int s = 0; s < nl; ++s )
+                Wn[size_t(ci)*nchans + inc[L[s]]] = float(scale * Cl[size_t(self)*nl + s]);
+        }
+    }
+
+    setMatrix( Wn );
+}
+
+
+void ChannelMixer::setMatrix( const std::vector<float> &W )
+{
+    if( W.size() != size_t(nchans) * nchans )
+        return;
+
+    this->W = W;
+
+// Half bandwidth
+
+    b = 0;
+
+    for( int i = 0; i < nchans; ++i ) {
+
+        for( int j = 0; j < nchans; ++j ) {
+
+            if( W[size_t(i)*nchans + j] != 0 )
+                b = std::max( b, abs( i - j ) );
+        }
+    }
+
+    panel.clear();
+    diag.clear();
+
+    // mixRows leaves the row pads of X alone: zero them for this b
+
+    std::fill( X.begin(), X.end(), 0.0f );
+
+    if( 4 * (2*b + 1) <= nchans ) {
+
+        // D[k][i] = W[i][i+k-b]
+
+        int nd = 2*b + 1;
+
+        diag.assign( size_t(nd) * nchans, 0.0f );
+
+        for( int k = 0; k < nd; ++k ) {
+
+            for( int i = 0; i < nchans; ++i ) {
+
+                int j = i + k - b;
+
+                if( j >= 0 && j < nchans )
+                    diag[size_t(k)*nchans + i] = W[size_t(i)*nchans + j];
+            }
+        }
+    }
+    else {
+
+        // P[p][j][q] = W[16p+q][j]
+
+        int np = (nchans + 15) / 16;
+
+        b = -1;
+        panel.assign( size_t(np) * nchans * 16, 0.0f );
+
+        for( int p = 0; p < np; ++p ) {
+
+            for( int j = 0; j < nchans; ++j ) {
+
+                for( int q = 0; q < 16 && 16*p + q < nchans; ++q ) {
+
+                    panel[(size_t(p)*nchans + j)*16 + q] =
+                        W[size_t(16*p + q)*nchans + j];
+                }
+            }
+        }
+    }
+}
+
+
+void ChannelMixer::apply( short *data, int ntpts, int nchans )
+{
+    if( ready() && nchans == this->nchans )
+        mixRows( data, ntpts );
+}
+
+
+void ChannelMixer::apply( float *data, int ntpts, int nchans )
+{
+    if( ready() && nchans == this->nchans )
+        mixRows( data, ntpts );
+}
+
+
+static inline void putSample( short &d, float v )
+{
+    d = short(std::max( -32768.0f, std::min( 32767.0f, std::floor( v + 0.5f ) ) ));
+}
+
+
+static inline void putSample( float &d, float v )
+{
+    d = v;
+}
+
+
+// Copy each tile of rows out (the mix needs a row's old values
+// until it's done), mix into (Y), and write back. (X) and (Y) are
+// sized by setChannels(); the pads of (X) stay zero.
+//
+template<typename T>
+void ChannelMixer::mixRows( T *data, int ntpts )
+{
+    int pad = std::max( b, 0 ),
+        ldx = nchans + 2*pad,
+        ldy = (b >= 0 ? nchans : 16 * ((nchans + 15) / 16));
+
+    for( int t0 = 0; t0 < ntpts; t0 += MIX_TILE_ROWS ) {
+
+        int nt  = std::min( MIX_TILE_ROWS, ntpts - t0 );
+        T   *d  = data + size_t(t0) * nchans;
+
+        for( int r = 0; r < nt; ++r ) {
+
+            const T *src = d + size_t(r) * nchans;
+            float   *dst = &X[size_t(r) * ldx + pad];
+
+            for( int c = 0; c < nchans; ++c )
+                dst[c] = src[c];
+        }
+
+        mixTile( &X[0], nt, &Y[0] );
+
+        for( int r = 0; r < nt; ++r ) {
+
+            T           *dst = d + size_t(r) * nchans;
+            const float *src = &Y[size_t(r) * ldy];
+
+            for( int c = 0; c < nchans; ++c )
+                putSample( dst[c], src[c] );
+        }
+    }
+}
+
+
+// (X) holds (nt) rows, stride nchans + 2*max(b,0), each offset by
+// max(b,0) zeros. (Y) gets the mixed rows, stride nchans (banded)
+// or nchans rounded up to 16 (dense).
+//
+void ChannelMixer::mixTile( const float *X, int nt, float *Y ) const
+{
+    bool    vec = false;
+
+#ifdef MIX_X86
+    vec = (cpuISA() >= cpu_isa_avx2);
+#endif
+
+    if( b >= 0 ) {
+
+        int ldx = nchans + 2*b,
+            nd  = 2*b + 1;
+
+        for( int r = 0; r < nt; ++r ) {
+
+            const float *x  = X + size_t(r) * ldx;
+            float       *y  = Y + size_t(r) * nchans;
+            int         i   = 0;
+
+#ifdef MIX_X86
+            if( vec )
+                i = bandAVX2( x, &diag[0], nchans, nd, y );
+#endif
+
+            for( ; i < nchans; ++i ) {
+
+                float   acc = 0;
+
+                for( int k = 0; k < nd; ++k )
+                    acc += diag[size_t(k)*nchans + i] * x[i + k];
+
+                y[i] = acc;
+            }
+        }
+
+        return;
+    }
+
+    int ldy = 16 * ((nchans + 15) / 16);
+
+#ifdef MIX_X86
+    if( vec ) {
+
+        for( int p = 0; p < ldy / 16; ++p ) {
+
+            const float *P = &panel[size_t(p) * nchans * 16];
+
+            for( int r = 0; r < nt; r += 4 ) {
+
+                panelAVX2( X + size_t(r) * nchans, nchans,
+                    std::min( 4, nt - r ), P, nchans,
+                    Y + size_t(r) * ldy + 16*p, ldy );
+            }
+        }
+
+        return;
+    }
+#endif
+
+    for( int r = 0; r < nt; ++r ) {
+
+        const float *x = X + size_t(r) * nchans;
+        float       *y = Y + size_t(r) * ldy;
+
+        for( int i = 0; i < nchans; ++i ) {
+
+            const float *w      = &W[size_t(i) * nchans];
+            float       acc     = 0;
+
+            for( int j = 0; j < nchans; ++j )
+                acc += w[j] * x[j];
+
+            y[i] = acc;
+        }
+    }
+}
+
+
@@ -0,0 +1,126 @@
+#ifndef CHANNELMIXER_H
+#define CHANNELMIXER_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include <vector>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+enum MixMode {
+    mix_none = 0,
+    mix_zca,        // whiten all channels together
+    mix_local       // whiten each channel against its neighbors
+};
+
+/* ---------------------------------------------------------------- */
+/* ChannelMixer --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Linear channel mixing for interleaved data: at each timepoint the
+// row x becomes W x, for an (nchans x nchans) matrix W.
+//
+// W is set directly (setMatrix) or estimated as a whitening matrix
+// from the covariance of data fed to accumulate(), collected after
+// begin(). The estimate is
+//
+//  - mix_zca:   C^(-1/2) over all included channels, or
+//  - mix_local: for each channel, the matching row of C^(-1/2) over
+//               just its (nNbr) nearest sites on the same shank,
+//
+// scaled by the median channel RMS, so whitened data stay in the
+// input's units and thresholds keep their meaning. Eigenvalues are
+// regularized by 1/1000 of their mean. Excluded channels (group
+// < 0: sync, unused, reference) pass through untouched.
+//
+// Two kernels apply W, chosen from its shape:
+//
+//  - banded: if every nonzero is within (b) of the diagonal, and
+//    the 2b+1 diagonals are under a quarter of the channels, W is
+//    held by diagonal. Each diagonal is then a contiguous multiply
+//    along the row. Local whitening is banded when channel order
+//    follows the shank, as on Neuropixels probes.
+//  - dense: W is packed into 16-column panels of its transpose, and
+//    rows go through in tiles: each panel (~25KB) stays in L1 while
+//    a tile's rows, four at a time, stream past it.
+//
+// Both are AVX2 where cpuISA() allows, else scalar. Arithmetic is
+// float, accumulating over channels in order.
+//
+class ChannelMixer
+{
+private:
+    std::vector<float>  W,          // [out][in]
+                        panel,      // dense: [panel][in][16]
+                        diag,       // banded: [2b+1][nchans]
+                        X,          // mixRows tiles: rows in,
+                        Y;          // mixed rows out
+    std::vector<double> cov,        // accumulating: [ni][ni]
+                        sum,        // [ni]
+                        pend;       // [4][ni] rows not yet in cov
+    std::vector<int>    group,
+                        inc;        // included channels
+    std::vector<float>  x, z;
+    MixMode             mode;
+    int                 nchans,
+                        b,          // half bandwidth, -1 = dense
+                        nGot,
+                        nWant,
+                        stride,
+                        phase,
+                        nNbr;
+
+public:
+    ChannelMixer();
+
+    // (group[c]) is channel c's shank, or < 0 to pass it through.
+    // (x,z) are site positions, for local whitening. Drops any W.
+    void setChannels(
+        const std::vector<int>      &group,
+        const std::vector<float>    &x,
+        const std::vector<float>    &z,
+        int                         nNbr = 32 );
+
+    int nChans() const      {return nchans;}
+
+    // Start estimating a (mode) matrix from the next (nScans) scans
+    // fed to accumulate(), taking one in (stride). Until it's done
+    // ready() is false and apply() does nothing.
+    void begin( MixMode mode, int nScans, int stride );
+
+    bool estimating() const {return mode != mix_none && nGot < nWant;}
+    bool ready() const      {return !W.empty();}
+    bool banded() const     {return b >= 0;}
+    int bandwidth() const   {return b;}
+
+    // Add (ntpts) scans, array stride (nchans), to the covariance.
+    // The matrix is estimated by the call that completes it.
+    void accumulate( const short *data, int ntpts, int nchans );
+    void accumulate( const float *data, int ntpts, int nchans );
+
+    // (W) row-major, y[i] = sum_j W[i*nchans + j] x[j].
+    void setMatrix( const std::vector<float> &W );
+    const std::vector<float> &matrix() const    {return W;}
+
+    // Mix (ntpts) timepoints in place. int16 outputs are rounded
+    // and clipped.
+    void apply( short *data, int ntpts, int nchans );
+    void apply( float *data, int ntpts, int nchans );
+
+private:
+    template<typename T>
+    void addScans( const T *data, int ntpts );
+    void addPending( int nv );
+    template<typename T>
+    void mixRows( T *data, int ntpts );
+    void estimate();
+    void mixTile( const float *X, int nt, float *Y ) const;
+};
+
+#endif  // CHANNELMIXER_H
+
+
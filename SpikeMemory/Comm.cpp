@@ -1,6 +1,7 @@
 
 #include "Comm.h"
 
+#include <chrono>
 #include <string.h>
 
 /* ---------------------------------------------------------------- */
@@ -9,6 +10,14 @@
 
 NetClientMap    Comm::m_clientMap;
 int             Comm::m_nextHandle = 0;
+std::mutex      Comm::m_mapMutex;
+
+
+static double getTime()
+{
+    return std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
 
 /* ---------------------------------------------------------------- */
 /* Comm ----------------------------------------------------------- */
@@ -18,11 +27,26 @@ int             Comm::m_nextHandle = 0;
 /* Public --------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// In session mode, a reply completed within the heartbeat window
+// already proves the link, so the NOOP is skipped. If the last
+// command never completed its reply, the socket may still hold
+// part of it, so we reconnect rather than trust the NOOP.
+//
 bool Comm::checkConn( t_sglxconn *S ) noexcept(false)
 {
     if( S->in_checkconn )
         return true;
 
+    if( !S->pending.empty() )
+        return error( "checkConn: Asynchronous fetches outstanding." );
+
+    if( S->heartbeat > 0 && S->handle != -1 && !S->in_cmd
+        && getTime() - S->last_io < S->heartbeat ) {
+
+        S->err.clear();
+        return true;
+    }
+
     S->in_checkconn = true;
     S->err.clear();
 
@@ -40,9 +64,13 @@ bool Comm::checkConn( t_sglxconn *S ) noexcept(false)
     else {
 
         try {
+            if( S->in_cmd )
+                error( "checkConn: Previous reply incomplete." );
+
             string  s;
             sendString( S, "NOOP\n" );
             read_1s_srvside( s, S );
+            endCmd( S );
         }
         catch( const exception &e ) {
 
@@ -50,6 +78,8 @@ bool Comm::checkConn( t_sglxconn *S ) noexcept(false)
                 S->in_checkconn = false;
                 ok = error( "checkConn: Still unable to connect to server." );
             }
+
+            S->in_cmd = false;
         }
     }
 
@@ -112,6 +142,8 @@ bool Comm::sendString( t_sglxconn *S, const string &s ) noexcept(false)
     if( !nc )
         return error( "sendString: Invalid handle." );
 
+    S->in_cmd = true;
+
     uint    nsent = nc->sendString( s );
 
     if( !nsent )
@@ -136,8 +168,10 @@ bool Comm::read_1s_srvside( string &s, t_sglxconn *S ) noexcept(false)
     nc->rcvLine( line );
     s = &line[0];
 
-    if( 0 == s.find( "ERROR", 0 ) )
+    if( 0 == s.find( "ERROR", 0 ) ) {
+        endCmd( S );
         return error( &line[0] );
+    }
 
     return true;
 }
@@ -165,8 +199,10 @@ bool Comm::read_resp( string &resp, t_sglxconn *S, bool srvside ) noexcept(false
             if( !strcmp( s, "OK" ) )
                 break;
 
-            if( !strncmp( s, "ERROR", 5 ) )
+            if( !strncmp( s, "ERROR", 5 ) ) {
+                endCmd( S );
                 return error( s );
+            }
 
             if( srvside )
                 resp = s;
@@ -175,6 +211,7 @@ bool Comm::read_resp( string &resp, t_sglxconn *S, bool srvside ) noexcept(false
         }
     }
 
+    endCmd( S );
     return true;
 }
 
@@ -201,13 +238,16 @@ bool Comm::read_client_vs( T_sglx_get_strs &vs, t_sglxconn *S ) noexcept(false)
             if( !strcmp( s, "OK" ) )
                 break;
 
-            if( !strncmp( s, "ERROR", 5 ) )
+            if( !strncmp( s, "ERROR", 5 ) ) {
+                endCmd( S );
                 return error( s );
+            }
 
             vs._dispatch( vs, s );
         }
     }
 
+    endCmd( S );
     return true;
 }
 
@@ -222,6 +262,7 @@ bool Comm::receiveOK( t_sglxconn *S, const string &cmd ) noexcept(false)
         return error( s.c_str() );
     }
 
+    endCmd( S );
     return true;
 }
 
@@ -279,8 +320,65 @@ bool Comm::error( const char *msg ) noexcept(false)
 }
 
 
+// Wait for any of the (n) connections (vS[]) to have reply data.
+// Data already buffered count as ready without waiting.
+// Return number ready, or -1 if error.
+//
+int Comm::waitReplies( t_sglxconn *const *vS, int n, bool *ready, int waitMS )
+{
+    vector<Socket*> vC( n );
+    int             nBuf = 0;
+
+    for( int i = 0; i < n; ++i ) {
+
+        NetClient   *nc = mapFind( vS[i]->handle );
+
+        vC[i] = nc;
+
+        if( nc && nc->nBuffered() )
+            ++nBuf;
+    }
+
+    int nR = Socket::waitAny( &vC[0], n, ready, nBuf ? 0 : waitMS );
+
+    if( nBuf ) {
+
+        nR = 0;
+
+        for( int i = 0; i < n; ++i ) {
+
+            if( vC[i] && static_cast<NetClient*>(vC[i])->nBuffered() )
+                ready[i] = true;
+
+            nR += ready[i];
+        }
+    }
+
+    return nR;
+}
+
+
+bool Comm::replyReady( t_sglxconn *S ) noexcept(false)
+{
+    NetClient   *nc = mapFind( S->handle );
+
+    return nc && (nc->nBuffered() || nc->nReadyForRead());
+}
+
+
+// Note reply to last command fully read.
+//
+void Comm::endCmd( t_sglxconn *S )
+{
+    S->in_cmd   = false;
+    S->last_io  = getTime();
+}
+
+
 NetClient *Comm::mapFind( int handle )
 {
+    std::lock_guard<std::mutex> lock( m_mapMutex );
+
     NetClientMap::iterator  it = m_clientMap.find( handle );
 
     if( it == m_clientMap.end() )
@@ -290,26 +388,39 @@ NetClient *Comm::mapFind( int handle )
 }
 
 
-void Comm::mapPut( NetClient *client )
+int Comm::mapPut( NetClient *client )
 {
-    NetClient   *old = mapFind( ++m_nextHandle );
+    std::lock_guard<std::mutex> lock( m_mapMutex );
 
-    if( old )
-        delete old;
+    NetClientMap::iterator  it = m_clientMap.find( ++m_nextHandle );
+
+    if( it != m_clientMap.end() )
+        delete it->second;
 
     m_clientMap[m_nextHandle] = client;
+
+    return m_nextHandle;
 }
 
 
 void Comm::mapDestroy( int handle ) noexcept(false)
 {
-    NetClientMap::iterator  it = m_clientMap.find( handle );
+    NetClient   *nc = 0;
 
-    if( it != m_clientMap.end() ) {
+    {
+        std::lock_guard<std::mutex> lock( m_mapMutex );
 
-        delete it->second;
-        m_clientMap.erase( it );
+        NetClientMap::iterator  it = m_clientMap.find( handle );
+
+        if( it != m_clientMap.end() ) {
+
+            nc = it->second;
+            m_clientMap.erase( it );
+        }
     }
+
+    if( nc )
+        delete nc;
     else
         error( "MapDestroy: Invalid or unknown handle." );
 }
@@ -317,8 +428,7 @@ void Comm::mapDestroy( int handle ) noexcept(false)
 
 int Comm::create( t_sglxconn *S )
 {
-    mapPut( new NetClient( S->host, S->port ) );
-    return m_nextHandle;
+    return mapPut( new NetClient( S->host, S->port ) );
 }
 
 
@@ -336,6 +446,7 @@ bool Comm::tryConnection( int handle ) noexcept(false)
     if( !nc )
         return error( "tryConnection: Invalid handle." );
 
+    nc->dropBuffered();
     return nc->tcpConnect();
 }
 
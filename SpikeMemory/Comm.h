@@ -8,6 +8,8 @@
 #include "SglxApi.h"
 #include "NetClient.h"
 
+#include <mutex>
+
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -18,11 +20,17 @@ typedef map<int,NetClient*> NetClientMap;
 /* Comm ----------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// The handle map is shared by every connection in the process, and
+// connections may be driven from several threads at once, so all
+// map access is serialized by m_mapMutex. A given t_sglxconn must
+// still only be used by one thread at a time.
+//
 class Comm
 {
 private:
     static NetClientMap m_clientMap;
     static int          m_nextHandle;
+    static std::mutex   m_mapMutex;
 
 public:
     bool checkConn( t_sglxconn *S ) noexcept(false);
@@ -43,11 +51,15 @@ public:
     bool sendBinary( t_sglxconn *S, const void *data, int nBytes ) noexcept(false);
     bool readBinary( void *data, int nBytes, t_sglxconn *S ) noexcept(false);
 
+    int waitReplies( t_sglxconn *const *vS, int n, bool *ready, int waitMS );
+    bool replyReady( t_sglxconn *S ) noexcept(false);
+
 private:
     bool error( const char *msg ) noexcept(false);
+    void endCmd( t_sglxconn *S );
 
     NetClient *mapFind( int handle );
-    void mapPut( NetClient *client );
+    int mapPut( NetClient *client );
     void mapDestroy( int handle ) noexcept(false);
 
     int create( t_sglxconn *S );
@@ -0,0 +1,138 @@
+
+#include "CpuDispatch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CPU_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+
+#ifdef _MSC_VER
+#define strcasecmp  _stricmp
+#endif
+
+
+/* ---------------------------------------------------------------- */
+/* Detection ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+static CpuISA detectISA()
+{
+#if !defined(CPU_X86)
+    return cpu_isa_base;
+#elif defined(_MSC_VER)
+    int r[4];
+
+    __cpuid( r, 0 );
+
+    if( r[0] < 7 )
+        return cpu_isa_base;
+
+    __cpuid( r, 1 );
+
+    // OS saves YMM state (OSXSAVE, then XCR0 bits 1,2)
+
+    if( !(r[2] & (1 << 27)) || (_xgetbv( 0 ) & 0x06) != 0x06 )
+        return cpu_isa_base;
+
+    unsigned long long  xcr0 = _xgetbv( 0 );
+
+    __cpuidex( r, 7, 0 );
+
+    // AVX-512F, with opmask/ZMM state saved (XCR0 bits 5,6,7)
+
+    if( (r[1] & (1 << 16)) && (xcr0 & 0xE0) == 0xE0 )
+        return cpu_isa_avx512;
+
+    if( r[1] & (1 << 5) )
+        return cpu_isa_avx2;
+
+    return cpu_isa_base;
+#else
+    // gcc/clang builtins check the OS state bits too
+
+    __builtin_cpu_init();
+
+    if( __builtin_cpu_supports( "avx512f" ) )
+        return cpu_isa_avx512;
+
+    if( __builtin_cpu_supports( "avx2" ) )
+        return cpu_isa_avx2;
+
+    return cpu_isa_base;
+#endif
+}
+
+
+// Apply SPIKEMEMORY_ISA, if set, to the (detected) level.
+//
+static CpuISA chooseISA( CpuISA detected )
+{
+    const char  *env = getenv( "SPIKEMEMORY_ISA" );
+
+    if( !env || !*env )
+        return detected;
+
+    CpuISA  want;
+
+    if( !strcasecmp( env, "sse2" ) || !strcasecmp( env, "base" ) )
+        want = cpu_isa_base;
+    else if( !strcasecmp( env, "avx2" ) )
+        want = cpu_isa_avx2;
+    else if( !strcasecmp( env, "avx512" ) || !strcasecmp( env, "avx-512" ) )
+        want = cpu_isa_avx512;
+    else {
+        fprintf( stderr,
+            "SPIKEMEMORY_ISA=%s not understood (sse2, avx2, avx512);"
+            " using %s.\n", env, cpuISAName( detected ) );
+        return detected;
+    }
+
+    if( want > detected ) {
+        fprintf( stderr,
+            "SPIKEMEMORY_ISA=%s: this CPU only has %s.\n",
+            env, cpuISAName( detected ) );
+        return detected;
+    }
+
+    return want;
+}
+
+
+CpuISA cpuDetectedISA()
+{
+    static CpuISA   isa = detectISA();
+
+    return isa;
+}
+
+
+CpuISA cpuISA()
+{
+    static CpuISA   isa = chooseISA( cpuDetectedISA() );
+
+    return isa;
+}
+
+
+const char *cpuISAName( CpuISA isa )
+{
+    switch( isa ) {
+        case cpu_isa_avx2:      return "AVX2";
+        case cpu_isa_avx512:    return "AVX-512";
+        default:
+#ifdef CPU_X86
+            return "SSE2";
+#else
+            return "generic";
+#endif
+    }
+}
+
+
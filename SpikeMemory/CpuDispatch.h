@@ -0,0 +1,37 @@
+#ifndef CPUDISPATCH_H
+#define CPUDISPATCH_H
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Instruction set levels the DSP kernels are built for, in order.
+// cpu_isa_base is whatever the compiler targets by default: SSE2
+// on x86-64, plain C++ elsewhere.
+//
+enum CpuISA {
+    cpu_isa_base = 0,
+    cpu_isa_avx2,
+    cpu_isa_avx512
+};
+
+/* ---------------------------------------------------------------- */
+/* Functions ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Best level this CPU (and OS) supports, decided once.
+//
+CpuISA cpuDetectedISA();
+
+// Level the kernels use, decided once: the detected one, unless
+// environment variable SPIKEMEMORY_ISA (sse2, avx2 or avx512) asks
+// for a lower one, as for A/B benchmarks. Asking for more than the
+// CPU has is ignored with a warning, so any setting is safe.
+//
+CpuISA cpuISA();
+
+const char *cpuISAName( CpuISA isa );
+
+#endif  // CPUDISPATCH_H
+
+
@@ -0,0 +1,270 @@
+
+#include "DataSource.h"
+#include "FetchCursor.h"
+#include "SglxCppClient.h"
+#include "SglxFile.h"
+
+#include <algorithm>
+
+/* ---------------------------------------------------------------- */
+/* FileReader ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Reads a channel subset of scans [from, to) of an SglxFile; one
+// gather from the page cache straight into the ring block.
+//
+class FileReader : public StreamReader
+{
+private:
+    const SglxFile      &F;
+    std::vector<int>    cols;
+    t_ull               nextCt,
+                        endCt;
+    int                 ds;
+
+public:
+    FileReader(
+        const SglxFile          &F,
+        const std::vector<int>  &cols,
+        int                     ds,
+        t_ull                   from,
+        t_ull                   to )
+    :   F(F), cols(cols), nextCt(from),
+        endCt(std::min( to, F.fileScans() )), ds(ds > 0 ? ds : 1)  {}
+
+    virtual int read( SampleBlock *B, int maxScans );
+    virtual bool atEnd() const  {return nextCt >= endCt;}
+    virtual t_ull next() const  {return nextCt;}
+};
+
+
+int FileReader::read( SampleBlock *B, int maxScans )
+{
+    if( atEnd() )
+        return 0;
+
+    t_ull   avail   = (endCt - nextCt + ds - 1) / ds;
+    int     n       = int(std::min( avail, t_ull(maxScans) ));
+
+    F.gather( B->data, cols, nextCt, n, ds );
+
+    B->headCt   = nextCt;
+    B->gap      = false;
+    nextCt     += t_ull(n) * ds;
+
+    return n;
+}
+
+/* ---------------------------------------------------------------- */
+/* SglxSource ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+SglxSource::~SglxSource()
+{
+    if( hSglx ) {
+        sglx_close( hSglx );
+        sglx_destroyHandle( hSglx );
+    }
+}
+
+
+bool SglxSource::open()
+{
+    if( !hSglx )
+        hSglx = connect( err );
+
+    return hSglx != 0;
+}
+
+
+int SglxSource::nProbes()
+{
+    int np = 0;
+    sglx_getStreamNP( np, hSglx, 2 );
+    return np;
+}
+
+
+double SglxSource::sampleRate( int js, int ip )
+{
+    return sglx_getStreamSampleRate( hSglx, js, ip );
+}
+
+
+std::vector<int> SglxSource::acqChanCounts( int js, int ip )
+{
+    cppClient_sglx_get_ints chanCounts;
+    sglx_getStreamAcqChans( chanCounts, hSglx, js, ip );
+    return chanCounts.vint;
+}
+
+
+std::vector<std::string> SglxSource::geomMap( int ip )
+{
+    cppClient_sglx_get_strs geom;
+    sglx_getGeomMap( geom, hSglx, ip );
+    return geom.vstr;
+}
+
+
+StreamReader* SglxSource::newReader( const T_sglx_fetch &io, bool ownConn )
+{
+    void    *h = hSglx;
+
+    if( ownConn && !(h = connect( err )) )
+        return 0;
+
+    return new FetchCursor( h, io, sglx_getStreamSampleCount( h, io.js, io.ip ), ownConn );
+}
+
+
+// Open a connection in session mode: acquisition fetches every
+// period, so per-command NOOPs would only double the round trips.
+//
+void* SglxSource::connect( std::string &err )
+{
+    void    *h = sglx_createHandle_std();
+
+    if( !sglx_connect( h, host.c_str(), port ) ) {
+        err = sglx_getError( h );
+        sglx_destroyHandle( h );
+        return 0;
+    }
+
+    sglx_setSessionMode( h, heartbeatMS );
+    return h;
+}
+
+/* ---------------------------------------------------------------- */
+/* FileSource ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+FileSource::~FileSource()
+{
+    for( int i = 0, n = int(files.size()); i < n; ++i )
+        delete files[i];
+}
+
+
+bool FileSource::open()
+{
+    if( !files.empty() )
+        return true;
+
+    int nOB = 0,
+        nIM = 0;
+
+    for( int i = 0, n = int(paths.size()); i < n; ++i ) {
+
+        int         js = SglxFile::streamOf( paths[i] );
+        SglxFile    *F = new SglxFile( js == 2 ? nIM++ : (js == 1 ? nOB++ : 0) );
+
+        err = F->open( paths[i] );
+
+        if( !err.empty() ) {
+            delete F;
+            return false;
+        }
+
+        files.push_back( F );
+    }
+
+    if( files.empty() ) {
+        err = "No files given.";
+        return false;
+    }
+
+    return true;
+}
+
+
+int FileSource::nProbes()
+{
+    int np = 0;
+
+    for( int i = 0, n = int(files.size()); i < n; ++i )
+        np += (files[i]->getJS() == 2);
+
+    return np;
+}
+
+
+double FileSource::sampleRate( int js, int ip )
+{
+    SglxFile    *F = find( js, ip );
+    return (F ? F->sampleRate() : 0);
+}
+
+
+std::vector<int> FileSource::acqChanCounts( int js, int ip )
+{
+    SglxFile    *F = find( js, ip );
+    return (F ? F->acqChanCounts() : std::vector<int>());
+}
+
+
+std::vector<std::string> FileSource::geomMap( int ip )
+{
+    SglxFile    *F = find( 2, ip );
+    return (F ? F->geomMap() : std::vector<std::string>());
+}
+
+
+StreamReader* FileSource::newReader( const T_sglx_fetch &io, bool )
+{
+    SglxFile            *F = find( io.js, io.ip );
+    std::vector<int>    cols;
+
+    if( !F ) {
+        err = "No file for stream js=" + std::to_string( io.js )
+                + " ip=" + std::to_string( io.ip ) + ".";
+        return 0;
+    }
+
+    if( !F->columns( cols, io.channel_subset, io.n_cs ) ) {
+        err = "Requested channel not saved in file.";
+        return 0;
+    }
+
+    t_ull   to = (toSec < 0 ? F->fileScans() : scanAt( io.js, io.ip, toSec ));
+
+    return new FileReader( *F, cols, io.downsample,
+                scanAt( io.js, io.ip, fromSec ), to );
+}
+
+
+double FileSource::seconds() const
+{
+    double  sec = 0;
+
+    for( int i = 0, n = int(files.size()); i < n; ++i ) {
+
+        double  fsec = files[i]->fileScans() / files[i]->sampleRate();
+
+        if( !i || fsec < sec )
+            sec = fsec;
+    }
+
+    return sec;
+}
+
+
+t_ull FileSource::scanAt( int js, int ip, double sec ) const
+{
+    SglxFile    *F = find( js, ip );
+    return (F && sec > 0 ? t_ull(sec * F->sampleRate() + 0.5) : 0);
+}
+
+
+SglxFile* FileSource::find( int js, int ip ) const
+{
+    for( int i = 0, n = int(files.size()); i < n; ++i ) {
+
+        if( files[i]->getJS() == js && files[i]->getIP() == ip )
+            return files[i];
+    }
+
+    return 0;
+}
+
+
@@ -0,0 +1,184 @@
+#ifndef DATASOURCE_H
+#define DATASOURCE_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include "SampleRing.h"
+
+#include <string>
+#include <vector>
+
+class SglxFile;
+
+/* ---------------------------------------------------------------- */
+/* StreamReader --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Sequential reader of one stream's scans, made by a DataSource.
+// Used only by the acquisition thread.
+//
+class StreamReader
+{
+public:
+    virtual ~StreamReader() {}
+
+    // Read up to (maxScans) next scans into (B), which has room for
+    // that many. Sets B->headCt and B->gap.
+    // Return scans delivered (possibly 0), or -1 if error.
+    virtual int read( SampleBlock *B, int maxScans ) = 0;
+
+    // True if no more scans will ever come.
+    virtual bool atEnd() const  {return false;}
+
+    // Stream index (headCt units) of the next scan to read.
+    virtual t_ull next() const = 0;
+
+    // Scans known to exist at the source, same units. More than
+    // next() means the reader is behind by the difference.
+    virtual t_ull sourceCount() const   {return next();}
+
+    // Gap events so far, and scans lost in them.
+    virtual t_ull gaps() const  {return 0;}
+    virtual t_ull lost() const  {return 0;}
+
+    // Optional split read, so one thread can have requests for
+    // several streams in flight at once. post() sends the request
+    // for what read() would deliver; the reply arrives through
+    // sglx_pollAsync on connection(). Once every request posted on
+    // that connection has its reply, finish() completes this one,
+    // returning as read() would (it may issue commands of its own).
+    // Readers that can't split have no connection() and post()
+    // returns false.
+    virtual void* connection() const                    {return 0;}
+    virtual bool post( SampleBlock*, int )              {return false;}
+    virtual int finish( SampleBlock *B, int maxScans )  {return read( B, maxScans );}
+};
+
+/* ---------------------------------------------------------------- */
+/* DataSource ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Where SpikeVM gets its data: stream layout queries on the GUI
+// thread at startup, then one StreamReader per stream for the
+// acquisition thread. Stream selectors (js, ip) are as in SpikeGLX.
+//
+// Live sources run in real time; scans not read in time are lost.
+// Non-live sources wait for the reader, so they can be consumed as
+// fast as processing allows and nothing is ever dropped.
+//
+class DataSource
+{
+protected:
+    std::string err;
+
+public:
+    virtual ~DataSource()   {}
+
+    const std::string &error() const    {return err;}
+
+    // Connect or open; on failure return false and set error().
+    virtual bool open() = 0;
+
+    virtual bool isLive() const = 0;
+
+    virtual int nProbes() = 0;
+    virtual double sampleRate( int js, int ip ) = 0;
+    virtual std::vector<int> acqChanCounts( int js, int ip ) = 0;
+    virtual std::vector<std::string> geomMap( int ip ) = 0;
+
+    // Reader for (io)'s (js, ip, channel_subset, downsample), from
+    // the current sample (live) or the first (recorded). If (ownConn)
+    // the reader gets a connection of its own, where that applies.
+    // Return 0 and set error() on failure.
+    virtual StreamReader* newReader( const T_sglx_fetch &io, bool ownConn ) = 0;
+};
+
+/* ---------------------------------------------------------------- */
+/* SglxSource ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Live SpikeGLX over TCP. Readers are FetchCursors; those sharing
+// the main connection must all run on one thread.
+//
+class SglxSource : public DataSource
+{
+private:
+    enum { heartbeatMS = 1000 };
+
+    std::string host;
+    void        *hSglx;
+    int         port;
+
+public:
+    SglxSource( const std::string &host, int port )
+    :   host(host), hSglx(0), port(port)    {}
+    virtual ~SglxSource();
+
+    virtual bool open();
+    virtual bool isLive() const     {return true;}
+
+    virtual int nProbes();
+    virtual double sampleRate( int js, int ip );
+    virtual std::vector<int> acqChanCounts( int js, int ip );
+    virtual std::vector<std::string> geomMap( int ip );
+
+    virtual StreamReader* newReader( const T_sglx_fetch &io, bool ownConn );
+
+private:
+    void* connect( std::string &err );
+};
+
+/* ---------------------------------------------------------------- */
+/* FileSource ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Recorded SpikeGLX .bin/.meta files, memory-mapped. Probes take
+// ip in the order their files are given.
+//
+// Readers cover the whole recording unless setWindow() restricts
+// them to [fromSec, toSec). Each stream converts those times to its
+// own scan indices, so adjacent windows tile every stream exactly.
+//
+class FileSource : public DataSource
+{
+private:
+    std::vector<std::string>    paths;
+    std::vector<SglxFile*>      files;
+    double                      fromSec,
+                                toSec;
+
+public:
+    FileSource( const std::vector<std::string> &paths )
+    :   paths(paths), fromSec(0), toSec(-1)   {}
+    virtual ~FileSource();
+
+    virtual bool open();
+    virtual bool isLive() const     {return false;}
+
+    // Seconds recorded in every stream (the shortest file); call
+    // after open().
+    double seconds() const;
+
+    // Restrict subsequent readers; (toSec) < 0 means end of file.
+    void setWindow( double fromSec, double toSec )
+        {this->fromSec = fromSec; this->toSec = toSec;}
+
+    // Scan index of time (sec) in stream (js, ip).
+    t_ull scanAt( int js, int ip, double sec ) const;
+
+    virtual int nProbes();
+    virtual double sampleRate( int js, int ip );
+    virtual std::vector<int> acqChanCounts( int js, int ip );
+    virtual std::vector<std::string> geomMap( int ip );
+
+    virtual StreamReader* newReader( const T_sglx_fetch &io, bool ownConn );
+
+private:
+    SglxFile* find( int js, int ip ) const;
+};
+
+#endif  // DATASOURCE_H
+
+
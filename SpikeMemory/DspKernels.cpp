@@ -0,0 +1,648 @@
+
+#include "DspKernels.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define DSP_X86
+#include <immintrin.h>
+#endif
+
+// Every level must match the scalar loops bit for bit, so no fusing
+// mul/add pairs into FMA (AVX-512 targets imply FMA to gcc).
+
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+// As in BiquadSimd.cpp: gcc/clang want each function marked with
+// the ISA it may use; MSVC compiles any intrinsic as is.
+
+#if defined(DSP_X86) && !defined(_MSC_VER)
+#define DSP_AVX2    __attribute__((target("avx2")))
+#define DSP_AVX512  __attribute__((target("avx512f")))
+#else
+#define DSP_AVX2
+#define DSP_AVX512
+#endif
+
+
+/* ---------------------------------------------------------------- */
+/* Channel statistics --------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Scalar loops, also the tail of each vector form: channels
+// [c0, nchans), sums already in mean[], rms[].
+
+template<typename T>
+static void sumScalar(
+    const T *data,
+    int     ntpts,
+    int     nchans,
+    int     c0,
+    double  *mean )
+{
+    const T *row = data;
+
+    for( int i = 0; i < ntpts; ++i, row += nchans ) {
+
+        for( int c = c0; c < nchans; ++c )
+            mean[c] += row[c];
+    }
+}
+
+
+template<typename T>
+static void sumSqScalar(
+    const T         *data,
+    int             ntpts,
+    int             nchans,
+    int             c0,
+    const double    *mean,
+    double          *rms )
+{
+    const T *row = data;
+
+    for( int i = 0; i < ntpts; ++i, row += nchans ) {
+
+        for( int c = c0; c < nchans; ++c ) {
+
+            double  dev = row[c] - mean[c];
+
+            rms[c] += dev * dev;
+        }
+    }
+}
+
+
+static void zeroStats( int nchans, double *mean, double *rms )
+{
+    memset( mean, 0, nchans * sizeof(double) );
+    memset( rms, 0, nchans * sizeof(double) );
+}
+
+
+static void finishMean( int ntpts, int nchans, double *mean )
+{
+    for( int c = 0; c < nchans; ++c )
+        mean[c] /= ntpts;
+}
+
+
+static void finishRms( int ntpts, int nchans, double *rms )
+{
+    for( int c = 0; c < nchans; ++c )
+        rms[c] = sqrt( rms[c] / ntpts );
+}
+
+
+template<typename T>
+static void meanRmsBase(
+    const T *data,
+    int     ntpts,
+    int     nchans,
+    double  *mean,
+    double  *rms )
+{
+    zeroStats( nchans, mean, rms );
+    sumScalar( data, ntpts, nchans, 0, mean );
+    finishMean( ntpts, nchans, mean );
+    sumSqScalar( data, ntpts, nchans, 0, mean, rms );
+    finishRms( ntpts, nchans, rms );
+}
+
+#ifdef DSP_X86
+
+// Vector forms: rows in memory order, the channel sums (in L1)
+// updated a vector at a time.
+//
+// Loaders widen W int16 or float samples to W doubles.
+
+static inline __m128d load2( const short *p )
+{
+    int x;
+
+    memcpy( &x, p, 4 );
+
+    __m128i v = _mm_cvtsi32_si128( x );
+
+    return _mm_cvtepi32_pd( _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 ) );
+}
+
+static inline __m128d load2( const float *p )
+{
+    return _mm_cvtps_pd( _mm_castsi128_ps( _mm_loadl_epi64( (const __m128i*)p ) ) );
+}
+
+DSP_AVX2 static inline __m256d load4( const short *p )
+{
+    return _mm256_cvtepi32_pd( _mm_cvtepi16_epi32( _mm_loadl_epi64( (const __m128i*)p ) ) );
+}
+
+DSP_AVX2 static inline __m256d load4( const float *p )
+{
+    return _mm256_cvtps_pd( _mm_loadu_ps( p ) );
+}
+
+// The unmasked 512-bit converts pass gcc 12 its own _mm512_undefined_*
+// placeholder (PR 105593, -Wmaybe-uninitialized); the zero-masked forms
+// with every lane selected give the same instruction without it.
+
+DSP_AVX512 static inline __m512d load8( const short *p )
+{
+    return _mm512_maskz_cvtepi32_pd( 0xFF,
+            _mm256_cvtepi16_epi32( _mm_loadu_si128( (const __m128i*)p ) ) );
+}
+
+DSP_AVX512 static inline __m512d load8( const float *p )
+{
+    return _mm512_maskz_cvtps_pd( 0xFF, _mm256_loadu_ps( p ) );
+}
+
+
+template<typename T>
+static void meanRmsSSE2(
+    const T *data,
+    int     ntpts,
+    int     nchans,
+    double  *mean,
+    double  *rms )
+{
+    int     cVec    = nchans - nchans % 2;
+    const T *row;
+
+    zeroStats( nchans, mean, rms );
+
+    row = data;
+
+    for( int i = 0; i < ntpts; ++i, row += nchans ) {
+
+        for( int c = 0; c < cVec; c += 2 )
+            _mm_storeu_pd( mean + c, _mm_add_pd( _mm_loadu_pd( mean + c ), load2( row + c ) ) );
+    }
+
+    sumScalar( data, ntpts, nchans, cVec, mean );
+    finishMean( ntpts, nchans, mean );
+
+    row = data;
+
+    for( int i = 0; i < ntpts; ++i, row += nchans ) {
+
+        for( int c = 0; c < cVec; c += 2 ) {
+
+            __m128d dev = _mm_sub_pd( load2( row + c ), _mm_loadu_pd( mean + c ) );
+
+            _mm_storeu_pd( rms + c, _mm_add_pd( _mm_loadu_pd( rms + c ), _mm_mul_pd( dev, dev ) ) );
+        }
+    }
+
+    sumSqScalar( data, ntpts, nchans, cVec, mean, rms );
+    finishRms( ntpts, nchans, rms );
+}
+
+
+template<typename T>
+DSP_AVX2 static void meanRmsAVX2(
+    const T *data,
+    int     ntpts,
+    int     nchans,
+    double  *mean,
+    double  *rms )
+{
+    int     cVec    = nchans - nchans % 4;
+    const T *row;
+
+    zeroStats( nchans, mean, rms );
+
+    row = data;
+
+    for( int i = 0; i < ntpts; ++i, row += nchans ) {
+
+        for( int c = 0; c < cVec; c += 4 )
+            _mm256_storeu_pd( mean + c, _mm256_add_pd( _mm256_loadu_pd( mean + c ), load4( row + c ) ) );
+    }
+
+    sumScalar( data, ntpts, nchans, cVec, mean );
+    finishMean( ntpts, nchans, mean );
+
+    row = data;
+
+    for( int i = 0; i < ntpts; ++i, row += nchans ) {
+
+        for( int c = 0; c < cVec; c += 4 ) {
+
+            __m256d dev = _mm256_sub_pd( load4( row + c ), _mm256_loadu_pd( mean + c ) );
+
+            _mm256_storeu_pd( rms + c, _mm256_add_pd( _mm256_loadu_pd( rms + c ), _mm256_mul_pd( dev, dev ) ) );
+        }
+    }
+
+    sumSqScalar( data, ntpts, nchans, cVec, mean, rms );
+    finishRms( ntpts, nchans, rms );
+}
+
+
+template<typename T>
+DSP_AVX512 static void meanRmsAVX512(
+    const T *data,
+    int     ntpts,
+    int     nchans,
+    double  *mean,
+    double  *rms )
+{
+    int     cVec    = nchans - nchans % 8;
+    const T *row;
+
+    zeroStats( nchans, mean, rms );
+
+    row = data;
+
+    for( int i = 0; i < ntpts; ++i, row += nchans ) {
+
+        for( int c = 0; c < cVec; c += 8 )
+            _mm512_storeu_pd( mean + c, _mm512_add_pd( _mm512_loadu_pd( mean + c ), load8( row + c ) ) );
+    }
+
+    sumScalar( data, ntpts, nchans, cVec, mean );
+    finishMean( ntpts, nchans, mean );
+
+    row = data;
+
+    for( int i = 0; i < ntpts; ++i, row += nchans ) {
+
+        for( int c = 0; c < cVec; c += 8 ) {
+
+            __m512d dev = _mm512_sub_pd( load8( row + c ), _mm512_loadu_pd( mean + c ) );
+
+            _mm512_storeu_pd( rms + c, _mm512_add_pd( _mm512_loadu_pd( rms + c ), _mm512_mul_pd( dev, dev ) ) );
+        }
+    }
+
+    sumSqScalar( data, ntpts, nchans, cVec, mean, rms );
+    finishRms( ntpts, nchans, rms );
+}
+
+#endif  // DSP_X86
+
+/* ---------------------------------------------------------------- */
+/* Threshold crossings -------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Scalar loop, also the tail of each vector form: channels
+// [c0, nchans) of one scan, into a mask already zeroed.
+
+template<typename T>
+static inline void crossScalar(
+    const T     *row,
+    int         nchans,
+    int         c0,
+    const T     *hi,
+    const T     *lo,
+    uint64_t    *mask )
+{
+    for( int c = c0; c < nchans; ++c ) {
+
+        if( row[c] > hi[c] || row[c] < lo[c] )
+            mask[c >> 6] |= uint64_t(1) << (c & 63);
+    }
+}
+
+
+template<typename T>
+static void crossMaskBase(
+    const T     *data,
+    int         ntpts,
+    int         nchans,
+    const T     *hi,
+    const T     *lo,
+    uint64_t    *mask,
+    int         maskWords )
+{
+    memset( mask, 0, size_t(ntpts) * maskWords * sizeof(uint64_t) );
+
+    for( int it = 0; it < ntpts; ++it, data += nchans, mask += maskWords )
+        crossScalar( data, nchans, 0, hi, lo, mask );
+}
+
+#ifdef DSP_X86
+
+// Vector forms: compare a scan's channels a vector at a time and
+// shift each group's movemask bits into place in a 64-bit word, W
+// channels per group, W a power of two <= 64. A word is stored whole
+// once full; a partial last word is stored before the scalar tail
+// ORs in the rest.
+
+template<int W>
+static inline void putBits( uint64_t *mask, uint64_t &w, int c, unsigned bits )
+{
+    w |= uint64_t(bits) << (c & 63);
+
+    if( !((c + W) & 63) ) {
+        mask[c >> 6] = w;
+        w = 0;
+    }
+}
+
+
+static void crossMask16SSE2(
+    const short *data,
+    int         ntpts,
+    int         nchans,
+    const short *hi,
+    const short *lo,
+    uint64_t    *mask,
+    int         maskWords )
+{
+    int cVec = nchans - nchans % 16;
+
+    memset( mask, 0, size_t(ntpts) * maskWords * sizeof(uint64_t) );
+
+    for( int it = 0; it < ntpts; ++it, data += nchans, mask += maskWords ) {
+
+        uint64_t    w = 0;
+
+        for( int c = 0; c < cVec; c += 16 ) {
+
+            __m128i a   = _mm_loadu_si128( (const __m128i*)(data + c) ),
+                    b   = _mm_loadu_si128( (const __m128i*)(data + c + 8) ),
+                    xa  = _mm_or_si128(
+                            _mm_cmpgt_epi16( a, _mm_loadu_si128( (const __m128i*)(hi + c) ) ),
+                            _mm_cmplt_epi16( a, _mm_loadu_si128( (const __m128i*)(lo + c) ) ) ),
+                    xb  = _mm_or_si128(
+                            _mm_cmpgt_epi16( b, _mm_loadu_si128( (const __m128i*)(hi + c + 8) ) ),
+                            _mm_cmplt_epi16( b, _mm_loadu_si128( (const __m128i*)(lo + c + 8) ) ) );
+
+            putBits<16>( mask, w, c, uint16_t(_mm_movemask_epi8( _mm_packs_epi16( xa, xb ) )) );
+        }
+
+        if( cVec & 63 )
+            mask[cVec >> 6] = w;
+
+        crossScalar( data, nchans, cVec, hi, lo, mask );
+    }
+}
+
+
+DSP_AVX2 static void crossMask16AVX2(
+    const short *data,
+    int         ntpts,
+    int         nchans,
+    const short *hi,
+    const short *lo,
+    uint64_t    *mask,
+    int         maskWords )
+{
+    int cVec = nchans - nchans % 32;
+
+    memset( mask, 0, size_t(ntpts) * maskWords * sizeof(uint64_t) );
+
+    for( int it = 0; it < ntpts; ++it, data += nchans, mask += maskWords ) {
+
+        uint64_t    w = 0;
+
+        for( int c = 0; c < cVec; c += 32 ) {
+
+            __m256i a   = _mm256_loadu_si256( (const __m256i*)(data + c) ),
+                    b   = _mm256_loadu_si256( (const __m256i*)(data + c + 16) ),
+                    xa  = _mm256_or_si256(
+                            _mm256_cmpgt_epi16( a, _mm256_loadu_si256( (const __m256i*)(hi + c) ) ),
+                            _mm256_cmpgt_epi16( _mm256_loadu_si256( (const __m256i*)(lo + c) ), a ) ),
+                    xb  = _mm256_or_si256(
+                            _mm256_cmpgt_epi16( b, _mm256_loadu_si256( (const __m256i*)(hi + c + 16) ) ),
+                            _mm256_cmpgt_epi16( _mm256_loadu_si256( (const __m256i*)(lo + c + 16) ), b ) );
+
+            // packs works within 128-bit lanes: restore channel order
+
+            putBits<32>( mask, w, c, uint32_t(_mm256_movemask_epi8(
+                                        _mm256_permute4x64_epi64(
+                                            _mm256_packs_epi16( xa, xb ), 0xD8 ) )) );
+        }
+
+        if( cVec & 63 )
+            mask[cVec >> 6] = w;
+
+        crossScalar( data, nchans, cVec, hi, lo, mask );
+    }
+}
+
+
+// AVX-512F has no 16-bit compares (those are AVX-512BW), so widen;
+// zero-masked as in load8 to keep gcc 12 warning-free.
+
+DSP_AVX512 static inline __m512i widen16( const short *p )
+{
+    return _mm512_maskz_cvtepi16_epi32( 0xFFFF,
+            _mm256_loadu_si256( (const __m256i*)p ) );
+}
+
+DSP_AVX512 static void crossMask16AVX512(
+    const short *data,
+    int         ntpts,
+    int         nchans,
+    const short *hi,
+    const short *lo,
+    uint64_t    *mask,
+    int         maskWords )
+{
+    int cVec = nchans - nchans % 16;
+
+    memset( mask, 0, size_t(ntpts) * maskWords * sizeof(uint64_t) );
+
+    for( int it = 0; it < ntpts; ++it, data += nchans, mask += maskWords ) {
+
+        uint64_t    w = 0;
+
+        for( int c = 0; c < cVec; c += 16 ) {
+
+            __m512i x = widen16( data + c );
+
+            putBits<16>( mask, w, c,
+                _mm512_cmpgt_epi32_mask( x, widen16( hi + c ) )
+                | _mm512_cmplt_epi32_mask( x, widen16( lo + c ) ) );
+        }
+
+        if( cVec & 63 )
+            mask[cVec >> 6] = w;
+
+        crossScalar( data, nchans, cVec, hi, lo, mask );
+    }
+}
+
+
+static void crossMaskFSSE2(
+    const float *data,
+    int         ntpts,
+    int         nchans,
+    const float *hi,
+    const float *lo,
+    uint64_t    *mask,
+    int         maskWords )
+{
+    int cVec = nchans - nchans % 8;
+
+    memset( mask, 0, size_t(ntpts) * maskWords * sizeof(uint64_t) );
+
+    for( int it = 0; it < ntpts; ++it, data += nchans, mask += maskWords ) {
+
+        uint64_t    w = 0;
+
+        for( int c = 0; c < cVec; c += 8 ) {
+
+            __m128  a   = _mm_loadu_ps( data + c ),
+                    b   = _mm_loadu_ps( data + c + 4 );
+            int     xa  = _mm_movemask_ps( _mm_or_ps(
+                            _mm_cmpgt_ps( a, _mm_loadu_ps( hi + c ) ),
+                            _mm_cmplt_ps( a, _mm_loadu_ps( lo + c ) ) ) ),
+                    xb  = _mm_movemask_ps( _mm_or_ps(
+                            _mm_cmpgt_ps( b, _mm_loadu_ps( hi + c + 4 ) ),
+                            _mm_cmplt_ps( b, _mm_loadu_ps( lo + c + 4 ) ) ) );
+
+            putBits<8>( mask, w, c, unsigned(xa | (xb << 4)) );
+        }
+
+        if( cVec & 63 )
+            mask[cVec >> 6] = w;
+
+        crossScalar( data, nchans, cVec, hi, lo, mask );
+    }
+}
+
+
+DSP_AVX2 static void crossMaskFAVX2(
+    const float *data,
+    int         ntpts,
+    int         nchans,
+    const float *hi,
+    const float *lo,
+    uint64_t    *mask,
+    int         maskWords )
+{
+    int cVec = nchans - nchans % 8;
+
+    memset( mask, 0, size_t(ntpts) * maskWords * sizeof(uint64_t) );
+
+    for( int it = 0; it < ntpts; ++it, data += nchans, mask += maskWords ) {
+
+        uint64_t    w = 0;
+
+        for( int c = 0; c < cVec; c += 8 ) {
+
+            __m256  x = _mm256_loadu_ps( data + c );
+
+            putBits<8>( mask, w, c, unsigned(_mm256_movemask_ps( _mm256_or_ps(
+                            _mm256_cmp_ps( x, _mm256_loadu_ps( hi + c ), _CMP_GT_OQ ),
+                            _mm256_cmp_ps( x, _mm256_loadu_ps( lo + c ), _CMP_LT_OQ ) ) )) );
+        }
+
+        if( cVec & 63 )
+            mask[cVec >> 6] = w;
+
+        crossScalar( data, nchans, cVec, hi, lo, mask );
+    }
+}
+
+
+DSP_AVX512 static void crossMaskFAVX512(
+    const float *data,
+    int         ntpts,
+    int         nchans,
+    const float *hi,
+    const float *lo,
+    uint64_t    *mask,
+    int         maskWords )
+{
+    int cVec = nchans - nchans % 16;
+
+    memset( mask, 0, size_t(ntpts) * maskWords * sizeof(uint64_t) );
+
+    for( int it = 0; it < ntpts; ++it, data += nchans, mask += maskWords ) {
+
+        uint64_t    w = 0;
+
+        for( int c = 0; c < cVec; c += 16 ) {
+
+            __m512  x = _mm512_loadu_ps( data + c );
+
+            putBits<16>( mask, w, c,
+                _mm512_cmp_ps_mask( x, _mm512_loadu_ps( hi + c ), _CMP_GT_OQ )
+                | _mm512_cmp_ps_mask( x, _mm512_loadu_ps( lo + c ), _CMP_LT_OQ ) );
+        }
+
+        if( cVec & 63 )
+            mask[cVec >> 6] = w;
+
+        crossScalar( data, nchans, cVec, hi, lo, mask );
+    }
+}
+
+#endif  // DSP_X86
+
+/* ---------------------------------------------------------------- */
+/* Tables --------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#ifdef DSP_X86
+
+static const DspKernels kernelsBase = {
+    cpu_isa_base,
+    meanRmsSSE2<short>,
+    meanRmsSSE2<float>,
+    crossMask16SSE2,
+    crossMaskFSSE2
+};
+
+static const DspKernels kernelsAVX2 = {
+    cpu_isa_avx2,
+    meanRmsAVX2<short>,
+    meanRmsAVX2<float>,
+    crossMask16AVX2,
+    crossMaskFAVX2
+};
+
+static const DspKernels kernelsAVX512 = {
+    cpu_isa_avx512,
+    meanRmsAVX512<short>,
+    meanRmsAVX512<float>,
+    crossMask16AVX512,
+    crossMaskFAVX512
+};
+
+#else
+
+static const DspKernels kernelsBase = {
+    cpu_isa_base,
+    meanRmsBase<short>,
+    meanRmsBase<float>,
+    crossMaskBase<short>,
+    crossMaskBase<float>
+};
+
+#endif
+
+
+const DspKernels &dspKernelsFor( CpuISA isa )
+{
+#ifdef DSP_X86
+    switch( isa ) {
+        case cpu_isa_avx512:    return kernelsAVX512;
+        case cpu_isa_avx2:      return kernelsAVX2;
+        default:                return kernelsBase;
+    }
+#else
+    (void)isa;
+    return kernelsBase;
+#endif
+}
+
+
+const DspKernels &dspKernels()
+{
+    static const DspKernels &K = dspKernelsFor( cpuISA() );
+
+    return K;
+}
+
+
@@ -0,0 +1,99 @@
+#ifndef DSPKERNELS_H
+#define DSPKERNELS_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include "CpuDispatch.h"
+
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/* ---------------------------------------------------------------- */
+/* DspKernels ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Per-block loops of the SpikeVM pipeline, each built for every
+// CpuISA level (gcc/clang target attributes, so one binary runs on
+// any x86-64), reached through a table picked once at startup.
+//
+// Each level's kernels give the same results, bit for bit: vectors
+// run across channels, so every channel sees the scalar loop's
+// operations in the scalar loop's order.
+//
+// The filter kernels (BiquadSimd.h) pick their level by cpuISA()
+// too.
+//
+struct DspKernels
+{
+    CpuISA  isa;
+
+    // Mean and RMS about the mean of each channel over (ntpts)
+    // interleaved scans, array stride (nchans), into mean[nchans]
+    // and rms[nchans]. Two passes, accumulating in double.
+    void    (*meanRms16)(
+                const short *data,
+                int         ntpts,
+                int         nchans,
+                double      *mean,
+                double      *rms );
+    void    (*meanRmsF)(
+                const float *data,
+                int         ntpts,
+                int         nchans,
+                double      *mean,
+                double      *rms );
+
+    // Threshold crossings of (ntpts) interleaved scans, array stride
+    // (nchans): bit c of scan it's mask is set where the sample is
+    // above hi[c] or below lo[c]. Each scan's mask is (maskWords)
+    // uint64s, at least (nchans + 63)/64; unused bits are zero.
+    void    (*crossMask16)(
+                const short *data,
+                int         ntpts,
+                int         nchans,
+                const short *hi,
+                const short *lo,
+                uint64_t    *mask,
+                int         maskWords );
+    void    (*crossMaskF)(
+                const float *data,
+                int         ntpts,
+                int         nchans,
+                const float *hi,
+                const float *lo,
+                uint64_t    *mask,
+                int         maskWords );
+};
+
+// Index of the lowest set bit of (x), which must not be 0.
+//
+inline int lowestBit64( uint64_t x )
+{
+#ifdef _MSC_VER
+    unsigned long   i;
+
+    _BitScanForward64( &i, x );
+
+    return int(i);
+#else
+    return __builtin_ctzll( x );
+#endif
+}
+
+// The table for cpuISA().
+//
+const DspKernels &dspKernels();
+
+// The table for (isa), or the nearest lower level this build has,
+// for comparing levels. The caller must know the CPU can run it.
+//
+const DspKernels &dspKernelsFor( CpuISA isa );
+
+#endif  // DSPKERNELS_H
+
+
@@ -0,0 +1,130 @@
+
+#include "FetchCursor.h"
+
+#include <algorithm>
+
+
+
+
+FetchCursor::FetchCursor(
+    void                *hSglx,
+    const T_sglx_fetch  &src,
+    t_ull               startCt,
+    bool                ownHandle )
+    :   hSglx(hSglx), nextCt(startCt), replyCt(0), srcCt(startCt),
+        nGaps(0), nLost(0),
+        gapPending(false), ownHandle(ownHandle)
+{
+    io.channel_subset   = src.channel_subset;
+    io.n_cs             = src.n_cs;
+    io.downsample       = (src.downsample > 0 ? src.downsample : 1);
+    io.js               = src.js;
+    io.ip               = src.ip;
+
+    hFetch = sglx_prepareFetch( io );
+}
+
+
+FetchCursor::~FetchCursor()
+{
+    sglx_destroyFetch( hFetch );
+
+    if( ownHandle ) {
+        sglx_close( hSglx );
+        sglx_destroyHandle( hSglx );
+    }
+}
+
+
+int FetchCursor::read( SampleBlock *B, int maxScans )
+{
+    io.max_samps = maxScans;
+    io.setBlock( B, maxScans * io.n_cs );
+
+    return complete( B, maxScans, sglx_fetchPrepared( io, hSglx, hFetch, nextCt ) );
+}
+
+
+bool FetchCursor::post( SampleBlock *B, int maxScans )
+{
+    io.max_samps = maxScans;
+    io.setBlock( B, maxScans * io.n_cs );
+    replyCt = 0;
+
+    return sglx_fetchAsync( io, hSglx, hFetch, nextCt, replied, this );
+}
+
+
+int FetchCursor::finish( SampleBlock *B, int maxScans )
+{
+    return complete( B, maxScans, replyCt );
+}
+
+
+void SGLX_CALL FetchCursor::replied( void *ctx, t_ull headCt )
+{
+    static_cast<FetchCursor*>(ctx)->replyCt = headCt;
+}
+
+
+// Account for a fetch from the cursor that returned (headCt).
+//
+// On error we ask for the sample count, once, to tell "nothing new
+// yet" from "our range is gone". In the latter case we resync to the
+// most recent (maxScans).
+//
+int FetchCursor::complete( SampleBlock *B, int maxScans, t_ull headCt )
+{
+    if( headCt < 1 ) {
+
+        t_ull   count = sglx_getStreamSampleCount( hSglx, io.js, io.ip );
+
+        if( !count )
+            return -1;
+
+        srcCt = std::max( srcCt, count );
+
+        if( count <= nextCt )
+            return 0;
+
+        t_ull   span = t_ull(maxScans) * io.downsample,
+                from = (count - nextCt > span ? count - span : nextCt);
+
+        io.setBlock( B, maxScans * io.n_cs );
+
+        if( (headCt = sglx_fetchPrepared( io, hSglx, hFetch, from )) < 1 )
+            return -1;
+    }
+
+    int     nscans  = io.take();
+    bool    skipped = (headCt != nextCt);
+
+    if( skipped ) {
+
+        ++nGaps;
+
+        if( headCt > nextCt )
+            nLost += headCt - nextCt;
+    }
+
+    // A gap with no data to carry it is flagged on the next block.
+
+    B->headCt   = headCt;
+    B->gap      = skipped || gapPending;
+    gapPending  = B->gap && !nscans;
+
+    nextCt = headCt + t_ull(nscans) * io.downsample;
+
+    if( nscans < maxScans )
+        srcCt = nextCt;
+    else {
+        srcCt = std::max(
+                    srcCt,
+                    sglx_getStreamSampleCount( hSglx, io.js, io.ip ) );
+        srcCt = std::max( srcCt, nextCt );
+    }
+
+    return nscans;
+}
+
+
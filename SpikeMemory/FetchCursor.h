@@ -0,0 +1,91 @@
+#ifndef FETCHCURSOR_H
+#define FETCHCURSOR_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include "DataSource.h"
+
+/* ---------------------------------------------------------------- */
+/* FetchCursor ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Streaming read position in one SpikeGLX stream.
+//
+// Each call to read() asks the server, in a single FETCH command,
+// for everything from the cursor up to (maxScans). The server sends
+// however many it has, along with the stream index (headCt) of the
+// first one, and the cursor advances past what arrived. So there's
+// no need to ask for the sample count first.
+//
+// Gaps are reported, not hidden:
+// - headCt > cursor: the server no longer had the scans we asked
+//   for and started later; the skipped scans are lost.
+// - fetch error with new data on the server: we resync to the
+//   latest (maxScans), counting the skipped scans as lost.
+// Either way the delivered block is flagged (gap) and the cursor
+// continues from the new position.
+//
+// Stream indices are in acquisition-rate units; with downsampling
+// each delivered scan advances the cursor by (downsample).
+//
+// A short block means the server had nothing more, so the cursor is
+// caught up. After a full block we ask for the sample count, so the
+// caller learns how far behind it is (sourceCount) and can catch up.
+//
+class FetchCursor : public StreamReader
+{
+private:
+    SampleRingFetch io;
+    void            *hSglx,
+                    *hFetch;
+    t_ull           nextCt,
+                    replyCt,
+                    srcCt,
+                    nGaps,
+                    nLost;
+    bool            gapPending,
+                    ownHandle;
+
+public:
+    // (src) supplies (js, ip, channel_subset, downsample).
+    // If (ownHandle), the cursor closes (hSglx) when destroyed.
+    FetchCursor(
+        void                *hSglx,
+        const T_sglx_fetch  &src,
+        t_ull               startCt,
+        bool                ownHandle = false );
+    virtual ~FetchCursor();
+
+    int js() const          {return io.js;}
+    int ip() const          {return io.ip;}
+    int nChans() const      {return io.n_cs;}
+    virtual t_ull next() const          {return nextCt;}
+    virtual t_ull sourceCount() const   {return srcCt;}
+    virtual t_ull gaps() const          {return nGaps;}
+    virtual t_ull lost() const          {return nLost;}
+
+    void seek( t_ull ct )   {nextCt = ct;}
+
+    // Fetch up to (maxScans) from the cursor into (B), which must
+    // have room for that many. Sets B->headCt and B->gap.
+    // Return scans delivered (possibly 0), or -1 if error.
+    virtual int read( SampleBlock *B, int maxScans );
+
+    // Same read, split around sglx_fetchAsync.
+    virtual void* connection() const    {return hSglx;}
+    virtual bool post( SampleBlock *B, int maxScans );
+    virtual int finish( SampleBlock *B, int maxScans );
+
+private:
+    static void SGLX_CALL replied( void *ctx, t_ull headCt );
+    int complete( SampleBlock *B, int maxScans, t_ull headCt );
+
+    FetchCursor( const FetchCursor& );
+    FetchCursor& operator=( const FetchCursor& );
+};
+
+#endif  // FETCHCURSOR_H
+
+
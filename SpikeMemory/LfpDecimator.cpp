@@ -0,0 +1,211 @@
+
+#include "LfpDecimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define LFP_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifndef M_PI
+#define M_PI    3.14159265358979323846
+#endif
+
+
+// Zeroth-order modified Bessel function, for the Kaiser window.
+//
+static double besselI0( double x )
+{
+    double  sum     = 1,
+            term    = 1,
+            q       = x * x / 4;
+
+    for( int k = 1; k < 50 && term > 1e-12 * sum; ++k ) {
+
+        term *= q / (double(k) * k);
+        sum  += term;
+    }
+
+    return sum;
+}
+
+/* ---------------------------------------------------------------- */
+/* LfpDecimator --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+LfpDecimator::LfpDecimator(
+    int     nchans,
+    double  srate,
+    double  outRate,
+    double  hpHz,
+    double  ringSec )
+    :   firstCt(0), nIn(0), nOut(0), nchans(nchans),
+        M(std::max( 1, int(std::round( srate / outRate )) )),
+        started(false)
+{
+// Kaiser-windowed sinc, cutoff at half the output rate.
+// beta 5.65 gives ~60 dB stopband.
+
+    double  beta    = 5.65,
+            fc      = 0.5 / M,
+            norm    = 0;
+    int     ntaps   = 9 * M + 1;
+
+    D = (ntaps - 1) / 2;
+    h.resize( ntaps );
+
+    for( int j = 0; j < ntaps; ++j ) {
+
+        double  t = j - D,
+                r = t / D,
+                s = (t ? sin( 2 * M_PI * fc * t ) / (M_PI * t) : 2 * fc),
+                w = besselI0( beta * sqrt( std::max( 0.0, 1 - r * r ) ) )
+                    / besselI0( beta );
+
+        h[j]  = float(s * w);
+        norm += h[j];
+    }
+
+    for( int j = 0; j < ntaps; ++j )
+        h[j] = float(h[j] / norm);
+
+    hp.addSection( bq_type_highpass, hpHz * M / srate );
+
+    capScans = std::max( 1, int(std::round( ringSec * srate / M )) );
+    ring.resize( size_t(capScans) * nchans );
+}
+
+
+void LfpDecimator::feed( const short *data, int ntpts, t_ull headCt, bool gap )
+{
+    if( gap || !started )
+        restart( headCt );
+
+    if( ntpts <= 0 )
+        return;
+
+// Append block to history: hist row r is input (nIn - (ntaps-1) + r)
+
+    int     nh  = nTaps() - 1;
+    size_t  n0  = size_t(nh) * nchans,
+            n   = size_t(ntpts) * nchans;
+
+    hist.resize( n0 + n );
+
+    for( size_t i = 0; i < n; ++i )
+        hist[n0 + i] = data[i];
+
+// Output k is due once input kM + D is in, its newest FIR input
+
+    t_ull   nDue = (nIn + ntpts > t_ull(D) ? (nIn + ntpts - 1 - D) / M + 1 : 0);
+    int     nNew = int(nDue - nOut);
+
+    out.resize( size_t(nNew) * nchans );
+
+    for( int io = 0; io < nNew; ++io ) {
+
+        t_ull   in = (nOut + io) * M + D;
+
+        filterRow( &out[size_t(io) * nchans], int(in + nh - nIn) );
+    }
+
+    if( nNew ) {
+
+        hp.applyBlockwiseMem( &out[0], nNew, nchans, 0, nchans );
+
+        for( int io = 0; io < nNew; ++io, ++nOut ) {
+
+            const float *src = &out[size_t(io) * nchans];
+            short       *dst = &ring[size_t(nOut % capScans) * nchans];
+
+            for( int c = 0; c < nchans; ++c ) {
+
+                float   v = std::round( src[c] );
+
+                dst[c] = short(std::max( -32768.0f, std::min( 32767.0f, v ) ));
+            }
+        }
+    }
+
+// Keep the last (ntaps-1) inputs
+
+    memmove( &hist[0], &hist[n], n0 * sizeof(float) );
+    hist.resize( n0 );
+
+    nIn += ntpts;
+}
+
+
+int LfpDecimator::read( short *dst, t_ull from, int nscans ) const
+{
+    from = std::max( from, oldest() );
+
+    if( nscans <= 0 || from >= nOut )
+        return 0;
+
+    int n = int(std::min( t_ull(nscans), nOut - from ));
+
+    for( int i = 0; i < n; ++i, dst += nchans ) {
+
+        memcpy( dst, &ring[size_t((from + i) % capScans) * nchans],
+            nchans * sizeof(short) );
+    }
+
+    return n;
+}
+
+
+// Start from zero history (so the first outputs ramp in) and fresh
+// high-pass state.
+//
+void LfpDecimator::restart( t_ull headCt )
+{
+    hist.assign( size_t(nTaps() - 1) * nchans, 0 );
+    hp.clearMem();
+
+    firstCt = headCt;
+    nIn     = 0;
+    nOut    = 0;
+    started = true;
+}
+
+
+// (acc) = sum over taps j of h[j] * hist row (r - j), all channels.
+// Rows are contiguous, so each tap is one sweep along a row.
+//
+void LfpDecimator::filterRow( float *acc, int r ) const
+{
+    std::fill( acc, acc + nchans, 0.0f );
+
+    int nVec = 0;
+
+#ifdef LFP_SSE2
+    nVec = nchans - nchans % 4;
+#endif
+
+    for( int j = 0, ntaps = nTaps(); j < ntaps; ++j ) {
+
+        const float *row    = &hist[size_t(r - j) * nchans];
+        float       hj      = h[j];
+        int         c       = 0;
+
+#ifdef LFP_SSE2
+        __m128  vh = _mm_set1_ps( hj );
+
+        for( ; c < nVec; c += 4 ) {
+
+            _mm_storeu_ps( &acc[c],
+                _mm_add_ps( _mm_loadu_ps( &acc[c] ),
+                    _mm_mul_ps( vh, _mm_loadu_ps( &row[c] ) ) ) );
+        }
+#endif
+
+        for( ; c < nchans; ++c )
+            acc[c] += hj * row[c];
+    }
+}
+
+
@@ -0,0 +1,94 @@
+#ifndef LFPDECIMATOR_H
+#define LFPDECIMATOR_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include "BiquadBank.h"
+#include "SglxApi.h"
+
+#include <vector>
+
+/* ---------------------------------------------------------------- */
+/* LfpDecimator --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// LFP band of a probe, decimated from its raw AP-band data.
+//
+// Blocks of interleaved int16 scans go in at the full rate (srate);
+// every channel comes out low-passed and decimated by M =
+// round(srate/outRate), then high-passed at (hpHz). With the default
+// 1 kHz output that is a 1-300 Hz band at ~1 kHz.
+//
+// The anti-alias filter is a linear-phase FIR (Kaiser-windowed sinc,
+// 9M+1 taps, cutoff at the output Nyquist rate): flat to 0.3 of the
+// output rate, and at least 60 dB down from 0.7 of it, the band that
+// would alias onto the passband. Only the retained outputs are ever
+// computed, each from the last 9M+1 inputs, so the cost is that of
+// one polyphase branch set per output rather than a filter at full
+// rate: 1/M of the work of filtering then subsampling.
+//
+// Outputs go to a ring holding the last (ringSec) seconds, as int16
+// in the input's units. Output k is centered on AP scan scanAt(k):
+// the FIR delay is taken out. A gap in the input starts everything
+// over (count() returns to zero).
+//
+// Not thread-safe: feed and read from the same thread.
+//
+class LfpDecimator
+{
+private:
+    std::vector<float>  h,          // FIR taps
+                        hist,       // [ntaps-1 + block][nchans]
+                        out;        // a block's outputs, before ring
+    std::vector<short>  ring;       // [capScans][nchans]
+    BiquadBank          hp;
+    t_ull               firstCt,    // AP scan of first input
+                        nIn,        // inputs since start
+                        nOut;       // outputs since start
+    int                 nchans,
+                        M,
+                        D,          // FIR delay = (ntaps-1)/2
+                        capScans;
+    bool                started;
+
+public:
+    LfpDecimator(
+        int     nchans,
+        double  srate,
+        double  outRate = 1000,
+        double  hpHz    = 1,
+        double  ringSec = 10 );
+
+    int nChans() const      {return nchans;}
+    int factor() const      {return M;}
+    int nTaps() const       {return int(h.size());}
+
+    void reset()            {started = false;}
+
+    // Decimate (ntpts) scans at (data), array stride nchans, the
+    // first at AP stream index (headCt). Set (gap) if scans were
+    // lost since the last call.
+    void feed( const short *data, int ntpts, t_ull headCt, bool gap );
+
+    // Outputs since start; the ring holds [oldest(), count()).
+    t_ull count() const     {return nOut;}
+    t_ull oldest() const
+        {return (nOut > t_ull(capScans) ? nOut - capScans : 0);}
+
+    t_ull scanAt( t_ull k ) const   {return firstCt + k * M;}
+
+    // Copy outputs [from, from+nscans), clipped to what the ring
+    // holds, to (dst) as interleaved scans. Return the number of
+    // scans copied, starting at max( from, oldest() ).
+    int read( short *dst, t_ull from, int nscans ) const;
+
+private:
+    void restart( t_ull headCt );
+    void filterRow( float *acc, int r ) const;
+};
+
+#endif  // LFPDECIMATOR_H
+
+
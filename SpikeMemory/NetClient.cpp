@@ -21,8 +21,6 @@ uint NetClient::sendData( const void *src, uint srcBytes ) noexcept(false)
 {
     static const uint maxsend = 2*1024*1024;
 
-    vbuf.clear();   // clear response
-
     if( !srcBytes )
         return 0;
 
@@ -64,7 +62,7 @@ uint NetClient::receiveData( void *dst, uint dstBytes ) noexcept(false)
         memcpy( buf, &vbuf[0], recvd );
 
         if( (nB -= recvd) > 0 )
-            memcpy( &vbuf[0], &vbuf[recvd], nB );
+            memmove( &vbuf[0], &vbuf[recvd], nB );
 
         vbuf.resize( nB );
     }
@@ -106,8 +104,6 @@ uint NetClient::receiveData( void *dst, uint dstBytes ) noexcept(false)
 
 uint NetClient::sendString( const string &s ) noexcept(false)
 {
-    vbuf.clear();   // clear response
-
     return Socket::sendData( s.data(), uint(s.length()) );
 }
 
@@ -145,7 +141,7 @@ void NetClient::rcvLine( vector<char> &line ) noexcept(false)
             // -----------------------
 
             if( (nB -= nL) > 0 )
-                memcpy( v0, vN, nB );
+                memmove( v0, vN, nB );
 
             vbuf.resize( nB );
             break;
@@ -157,11 +153,8 @@ void NetClient::rcvLine( vector<char> &line ) noexcept(false)
 
         uint    nR = nReadyForRead();
 
-        if( nR ) {
-
-            vbuf.resize( nB + nR );
-            Socket::receiveData( &vbuf[nB], nR );
-        }
+        if( nR )
+            bufferMore( nB, nR );
         else if( !waitData( 1000 * read_timeout_secs ) ) {
 
             // nothing to read - quit.
@@ -174,10 +167,8 @@ void NetClient::rcvLine( vector<char> &line ) noexcept(false)
 
             uint    nR = nReadyForRead();
 
-            if( nR ) {
-                vbuf.resize( nB + nR );
-                Socket::receiveData( &vbuf[nB], nR );
-            }
+            if( nR )
+                bufferMore( nB, nR );
             else {
                 // In this failure mode...
                 // flush out garbage character for next time
@@ -190,6 +181,23 @@ void NetClient::rcvLine( vector<char> &line ) noexcept(false)
 }
 
 
+// Append up to (nR) ready bytes to vbuf, one recv. Reads are capped
+// so that little of the binary payload after a BINARY_DATA header is
+// drawn in with it: receiveData takes what's buffered first, then
+// reads the rest straight into the caller's buffer.
+//
+void NetClient::bufferMore( uint nB, uint nR ) noexcept(false)
+{
+    static const uint maxline = 4096;
+
+    if( nR > maxline )
+        nR = maxline;
+
+    vbuf.resize( nB + nR );
+    vbuf.resize( nB + Socket::receiveData( &vbuf[nB], nR ) );
+}
+
+
 // Return true if OK received, data excludes OK.
 // Return false if ERROR received, ERROR line is thrown.
 //
@@ -34,8 +34,17 @@ public:
 
     uint sendString( const string &s ) noexcept(false);
 
+    // Bytes already drawn from the socket but not yet consumed.
+    // They may begin the next of several pipelined replies, so only
+    // a new connection drops them.
+    uint nBuffered() const  {return uint(vbuf.size());}
+    void dropBuffered()     {vbuf.clear();}
+
     void rcvLine( vector<char> &line ) noexcept(false);
     bool rcvLines( vector<vector<char> > &vlines ) noexcept(false);
+
+private:
+    void bufferMore( uint nB, uint nR ) noexcept(false);
 };
 
 #endif  // NETCLIENT_H
@@ -0,0 +1,329 @@
+
+#include "Referencer.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define REF_SSE2
+#include <emmintrin.h>
+#endif
+
+
+/* ---------------------------------------------------------------- */
+/* Referencer ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void Referencer::setGroups( const std::vector<int> &group, bool perShank )
+{
+    nchans = int(group.size());
+
+    groupOf.assign( nchans, -1 );
+    vG.clear();
+
+// Number groups in order of first appearance
+
+    std::vector<int>    shankG;
+
+    for( int c = 0; c < nchans; ++c ) {
+
+        if( group[c] < 0 )
+            continue;
+
+        int s = (perShank ? group[c] : 0);
+
+        if( s >= int(shankG.size()) )
+            shankG.resize( s + 1, -1 );
+
+        if( shankG[s] < 0 ) {
+
+            shankG[s] = int(vG.size());
+            vG.push_back( Group() );
+
+            Group   &G = vG.back();
+
+            G.mask.assign( nchans, 0 );
+            G.maskF.assign( nchans, 0 );
+            G.n         = 0;
+            G.vFirst    = c / 8;
+            G.vLim      = 0;
+        }
+
+        Group   &G = vG[shankG[s]];
+
+        G.mask[c]   = short(0xFFFF);
+        G.maskF[c]  = -1;
+        G.member.push_back( c );
+        G.vLim      = c / 8 + 1;
+        ++G.n;
+        groupOf[c]  = shankG[s];
+    }
+}
+
+
+void Referencer::apply( short *data, int ntpts, int nchans, RefMode mode ) const
+{
+    if( mode == ref_none || nchans != this->nchans || vG.empty() )
+        return;
+
+    int ng = nGroups();
+
+    std::vector<int>    ref( ng );
+
+    for( int it = 0; it < ntpts; ++it, data += nchans ) {
+
+        // All references from the row as it came in, then subtract
+
+        for( int ig = 0; ig < ng; ++ig ) {
+
+            if( mode == ref_cmr )
+                ref[ig] = groupMedian( data, ig );
+            else {
+                int n   = vG[ig].n,
+                    sum = groupSum( data, ig );
+
+                ref[ig] = (sum >= 0 ? sum + n/2 : sum - n/2) / n;
+            }
+        }
+
+        for( int ig = 0; ig < ng; ++ig )
+            subtract( data, ig, ref[ig] );
+    }
+}
+
+
+void Referencer::apply( float *data, int ntpts, int nchans, RefMode mode ) const
+{
+    if( mode == ref_none || nchans != this->nchans || vG.empty() )
+        return;
+
+    int ng = nGroups();
+
+    std::vector<float>  ref( ng ),
+                        scratch( nchans );
+
+    for( int it = 0; it < ntpts; ++it, data += nchans ) {
+
+        for( int ig = 0; ig < ng; ++ig ) {
+
+            if( mode == ref_cmr )
+                ref[ig] = groupMedian( data, ig, &scratch[0] );
+            else
+                ref[ig] = groupSum( data, ig ) / vG[ig].n;
+        }
+
+        for( int ig = 0; ig < ng; ++ig )
+            subtract( data, ig, ref[ig] );
+    }
+}
+
+
+// Vectors cover channels [0, 8*(nchans/8)); the few channels past
+// that are scalar, so rows are never read past their end.
+
+int Referencer::groupSum( const short *row, int ig ) const
+{
+    const Group &G      = vG[ig];
+    int         vLim    = std::min( G.vLim, nchans / 8 ),
+                sum     = 0,
+                c       = 8 * std::max( vLim, G.vFirst );
+
+#ifdef REF_SSE2
+    __m128i acc     = _mm_setzero_si128(),
+            ones    = _mm_set1_epi16( 1 );
+
+    for( int iv = G.vFirst; iv < vLim; ++iv ) {
+
+        __m128i x = _mm_and_si128(
+                        _mm_loadu_si128( (const __m128i*)&row[8*iv] ),
+                        _mm_loadu_si128( (const __m128i*)&G.mask[8*iv] ) );
+
+        acc = _mm_add_epi32( acc, _mm_madd_epi16( x, ones ) );
+    }
+
+    acc = _mm_add_epi32( acc, _mm_srli_si128( acc, 8 ) );
+    acc = _mm_add_epi32( acc, _mm_srli_si128( acc, 4 ) );
+    sum = _mm_cvtsi128_si32( acc );
+#else
+    c = 8 * G.vFirst;
+#endif
+
+    for( int cLim = std::min( nchans, 8 * G.vLim ); c < cLim; ++c ) {
+
+        if( G.mask[c] )
+            sum += row[c];
+    }
+
+    return sum;
+}
+
+
+// Smallest value v with at least (n+1)/2 members <= v.
+//
+int Referencer::groupMedian( const short *row, int ig ) const
+{
+    const Group &G      = vG[ig];
+    int         vLim    = std::min( G.vLim, nchans / 8 ),
+                cTail   = 8 * std::max( vLim, G.vFirst ),
+                cLim    = std::min( nchans, 8 * G.vLim ),
+                k       = (G.n + 1) / 2,
+                lo      = -32768,
+                hi      = 32767;
+
+#ifndef REF_SSE2
+    cTail = 8 * G.vFirst;
+#endif
+
+    while( lo < hi ) {
+
+        int mid = lo + (hi - lo) / 2,
+            cnt = 0;
+
+#ifdef REF_SSE2
+        __m128i vmid    = _mm_set1_epi16( short(mid) ),
+                acc     = _mm_setzero_si128();
+
+        for( int iv = G.vFirst; iv < vLim; ++iv ) {
+
+            __m128i gt = _mm_cmpgt_epi16(
+                            _mm_loadu_si128( (const __m128i*)&row[8*iv] ),
+                            vmid );
+
+            // members not above mid count -1 each
+
+            acc = _mm_sub_epi16( acc,
+                    _mm_andnot_si128( gt,
+                        _mm_loadu_si128( (const __m128i*)&G.mask[8*iv] ) ) );
+        }
+
+        acc = _mm_madd_epi16( acc, _mm_set1_epi16( 1 ) );
+        acc = _mm_add_epi32( acc, _mm_srli_si128( acc, 8 ) );
+        acc = _mm_add_epi32( acc, _mm_srli_si128( acc, 4 ) );
+        cnt = _mm_cvtsi128_si32( acc );
+#endif
+
+        for( int c = cTail; c < cLim; ++c ) {
+
+            if( G.mask[c] && row[c] <= mid )
+                ++cnt;
+        }
+
+        if( cnt >= k )
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    return lo;
+}
+
+
+void Referencer::subtract( short *row, int ig, int ref ) const
+{
+    const Group &G      = vG[ig];
+    int         vLim    = std::min( G.vLim, nchans / 8 ),
+                c       = 8 * std::max( vLim, G.vFirst );
+
+    ref = std::max( -32768, std::min( 32767, ref ) );
+
+#ifdef REF_SSE2
+    __m128i vref = _mm_set1_epi16( short(ref) );
+
+    for( int iv = G.vFirst; iv < vLim; ++iv ) {
+
+        __m128i *p = (__m128i*)&row[8*iv];
+
+        _mm_storeu_si128( p,
+            _mm_subs_epi16( _mm_loadu_si128( p ),
+                _mm_and_si128( vref,
+                    _mm_loadu_si128( (const __m128i*)&G.mask[8*iv] ) ) ) );
+    }
+#else
+    c = 8 * G.vFirst;
+#endif
+
+    for( int cLim = std::min( nchans, 8 * G.vLim ); c < cLim; ++c ) {
+
+        if( G.mask[c] )
+            row[c] = short(std::max( -32768, std::min( 32767, row[c] - ref ) ));
+    }
+}
+
+
+// Float rows: vectors of 4 over the group's span [8*vFirst, cLim),
+// then a scalar tail.
+
+float Referencer::groupSum( const float *row, int ig ) const
+{
+    const Group &G      = vG[ig];
+    int         c       = 8 * G.vFirst,
+                cLim    = std::min( nchans, 8 * G.vLim );
+    float       sum     = 0;
+
+#ifdef REF_SSE2
+    __m128  acc = _mm_setzero_ps();
+
+    for( ; c + 4 <= cLim; c += 4 ) {
+
+        acc = _mm_add_ps( acc,
+                _mm_and_ps(
+                    _mm_loadu_ps( &row[c] ),
+                    _mm_loadu_ps( (const float*)&G.maskF[c] ) ) );
+    }
+
+    acc = _mm_add_ps( acc, _mm_movehl_ps( acc, acc ) );
+    acc = _mm_add_ss( acc, _mm_shuffle_ps( acc, acc, 1 ) );
+    sum = _mm_cvtss_f32( acc );
+#endif
+
+    for( ; c < cLim; ++c ) {
+
+        if( G.maskF[c] )
+            sum += row[c];
+    }
+
+    return sum;
+}
+
+
+// Lower median, as for int16 rows.
+//
+float Referencer::groupMedian( const float *row, int ig, float *scratch ) const
+{
+    const Group &G  = vG[ig];
+    int         n   = G.n;
+
+    for( int i = 0; i < n; ++i )
+        scratch[i] = row[G.member[i]];
+
+    std::nth_element( scratch, scratch + (n - 1) / 2, scratch + n );
+
+    return scratch[(n - 1) / 2];
+}
+
+
+void Referencer::subtract( float *row, int ig, float ref ) const
+{
+    const Group &G      = vG[ig];
+    int         c       = 8 * G.vFirst,
+                cLim    = std::min( nchans, 8 * G.vLim );
+
+#ifdef REF_SSE2
+    __m128  vref = _mm_set1_ps( ref );
+
+    for( ; c + 4 <= cLim; c += 4 ) {
+
+        _mm_storeu_ps( &row[c],
+            _mm_sub_ps( _mm_loadu_ps( &row[c] ),
+                _mm_and_ps( vref,
+                    _mm_loadu_ps( (const float*)&G.maskF[c] ) ) ) );
+    }
+#endif
+
+    for( ; c < cLim; ++c ) {
+
+        if( G.maskF[c] )
+            row[c] -= ref;
+    }
+}
+
+
@@ -0,0 +1,82 @@
+#ifndef REFERENCER_H
+#define REFERENCER_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include <vector>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+enum RefMode {
+    ref_none = 0,
+    ref_car,        // subtract common average
+    ref_cmr         // subtract common median
+};
+
+/* ---------------------------------------------------------------- */
+/* Referencer ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Common-mode removal for interleaved int16 data.
+//
+// At each timepoint, the average (CAR) or median (CMR) of a group's
+// channels is subtracted from each of them. Groups are all channels
+// of the probe, or one per shank. Channels in no group (sync, unused
+// or reference sites) are left alone and don't count.
+//
+// Work is SSE2 over whole rows: each group has a lane mask, so sums,
+// counts and the subtraction are masked vector ops, confined to the
+// span of vectors the group occupies. The median is exact: a binary
+// search on value, 16 masked compare-and-count passes, no sorting.
+// For an even count it is the lower median.
+//
+// Float32 rows get the same references, unrounded: SSE sums and
+// subtraction four channels at a time, and the median by selection
+// (nth_element) over the group's members.
+//
+class Referencer
+{
+private:
+    struct Group {
+        std::vector<short>  mask;   // 0xFFFF = member, per channel
+        std::vector<int>    maskF,  // 0xFFFFFFFF = member, float rows
+                            member; // channels, ascending
+        int                 n,
+                            vFirst, // vectors holding members
+                            vLim;
+    };
+
+    std::vector<Group>  vG;
+    std::vector<int>    groupOf;    // per channel, -1 = none
+    int                 nchans;
+
+public:
+    Referencer() : nchans(0)    {}
+
+    // (group[c]) is channel c's shank, or < 0 to exclude it.
+    // If (perShank) false, all included channels are one group.
+    void setGroups( const std::vector<int> &group, bool perShank );
+
+    int nGroups() const     {return int(vG.size());}
+
+    // Re-reference (ntpts) timepoints in place. The array stride
+    // (nchans) must match the setGroups() channel count.
+    void apply( short *data, int ntpts, int nchans, RefMode mode ) const;
+    void apply( float *data, int ntpts, int nchans, RefMode mode ) const;
+
+private:
+    int groupSum( const short *row, int ig ) const;
+    int groupMedian( const short *row, int ig ) const;
+    void subtract( short *row, int ig, int ref ) const;
+    float groupSum( const float *row, int ig ) const;
+    float groupMedian( const float *row, int ig, float *scratch ) const;
+    void subtract( float *row, int ig, float ref ) const;
+};
+
+#endif  // REFERENCER_H
+
+
@@ -0,0 +1,143 @@
+
+#include "SampleRing.h"
+
+#include <algorithm>
+#include <string.h>
+
+
+
+
+SampleRing::SampleRing( int nchans, int capScans, int maxBlocks )
+    :   buf(size_t(nchans) * capScans), vB(maxBlocks),
+        head(0), tail(0), nOverrun(0),
+        nchans(nchans), capScans(capScans), wrPos(0)
+{
+}
+
+
+// Find (nscans) of contiguous room that doesn't overlap any
+// unreleased block. The oldest unreleased block starts at (r).
+// The test against (r) is strict so that wrPos never lands
+// exactly on (r), which would be indistinguishable from empty.
+//
+SampleBlock* SampleRing::reserve( int nscans )
+{
+    unsigned    h   = head.load( std::memory_order_relaxed ),
+                t   = tail.load( std::memory_order_acquire ),
+                nB  = unsigned(vB.size());
+    int         start;
+
+    if( nscans <= 0 || nscans > capScans || h - t >= nB )
+        return 0;
+
+    if( h == t )
+        start = (capScans - wrPos >= nscans ? wrPos : 0);
+    else {
+
+        int r = vB[t % nB].offset;
+
+        if( wrPos >= r ) {
+
+            if( capScans - wrPos >= nscans )
+                start = wrPos;
+            else if( nscans < r )
+                start = 0;
+            else
+                return 0;
+        }
+        else if( r - wrPos > nscans )
+            start = wrPos;
+        else
+            return 0;
+    }
+
+    SampleBlock &B = vB[h % nB];
+
+    B.data      = &buf[size_t(start) * nchans];
+    B.headCt    = 0;
+    B.offset    = start;
+    B.nscans    = 0;
+    B.gap       = false;
+
+    return &B;
+}
+
+
+void SampleRing::commit( int nscans )
+{
+    if( nscans <= 0 )
+        return;
+
+    unsigned    h = head.load( std::memory_order_relaxed );
+    SampleBlock &B = vB[h % vB.size()];
+
+    B.nscans    = nscans;
+    wrPos       = B.offset + nscans;
+
+    head.store( h + 1, std::memory_order_release );
+}
+
+
+SampleBlock* SampleRing::front()
+{
+    unsigned    t = tail.load( std::memory_order_relaxed ),
+                h = head.load( std::memory_order_acquire );
+
+    if( t == h )
+        return 0;
+
+    return &vB[t % vB.size()];
+}
+
+
+void SampleRing::release()
+{
+    unsigned    t = tail.load( std::memory_order_relaxed );
+
+    if( t != head.load( std::memory_order_acquire ) )
+        tail.store( t + 1, std::memory_order_release );
+}
+
+/* ---------------------------------------------------------------- */
+/* SampleRingFetch ------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+void SampleRingFetch::setBlock( SampleBlock *B, int room )
+{
+    this->B     = B;
+    this->room  = room;
+    got         = 0;
+    spilled     = false;
+}
+
+
+short* SampleRingFetch::base_addr( int nshort )
+{
+    got = nshort;
+
+    if( nshort <= room )
+        return B->data;
+
+    if( spill.size() < size_t(nshort) )
+        spill.resize( nshort );
+
+    spilled = true;
+    return &spill[0];
+}
+
+
+int SampleRingFetch::take()
+{
+    if( !n_cs )
+        return 0;
+
+    if( spilled ) {
+        got = std::min( got, room );
+        memcpy( B->data, &spill[0], got * sizeof(short) );
+    }
+
+    return got / n_cs;
+}
+
+
+
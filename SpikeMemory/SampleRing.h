@@ -0,0 +1,128 @@
+#ifndef SAMPLERING_H
+#define SAMPLERING_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include "SglxApi.h"
+
+#include <atomic>
+#include <vector>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// One contiguous run of interleaved int16 scans held in a SampleRing.
+// - data   = base address of (nscans * nchans) shorts.
+// - headCt = stream index of the first scan.
+// - offset = scan offset of data within the ring storage.
+// - gap    = true if samples were lost ahead of this block.
+//
+struct SampleBlock {
+    short   *data;
+    t_ull   headCt;
+    int     offset,
+            nscans;
+    bool    gap;
+};
+
+/* ---------------------------------------------------------------- */
+/* SampleRing ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Lock-free single-producer/single-consumer ring of scan blocks.
+//
+// All storage is allocated once, up front. The producer (the
+// acquisition thread) reserves room for up to N scans, fills it
+// and commits however many it actually got. The consumer (the
+// processing side) gets the oldest block with front(), works on
+// it in place, and hands it back with release().
+//
+// Each block is contiguous in memory: if a reservation won't fit
+// ahead of the end of storage it wraps to offset zero. Hence the
+// consumer can filter a block in place, and the producer can have
+// the socket read straight into it.
+//
+// Neither side ever blocks or locks. If the consumer falls so far
+// behind that there's no room, reserve() returns 0 and the caller
+// decides what to do (typically leave the data on the server and
+// try again next pass).
+//
+class SampleRing
+{
+private:
+    std::vector<short>          buf;
+    std::vector<SampleBlock>    vB;     // block descriptors
+    std::atomic<unsigned>       head,   // descriptors committed
+                                tail;   // descriptors released
+    std::atomic<t_ull>          nOverrun;
+    int                         nchans,
+                                capScans,
+                                wrPos;  // producer scan offset
+
+public:
+    SampleRing( int nchans, int capScans, int maxBlocks = 256 );
+
+    int nChans() const          {return nchans;}
+    int capacity() const        {return capScans;}
+
+    // Producer side -------------------------------------------------
+
+    // Return a block with room for (nscans), or 0 if no room.
+    SampleBlock* reserve( int nscans );
+
+    // Publish the reserved block holding (nscans) <= reserved.
+    // Committing zero scans discards the reservation.
+    void commit( int nscans );
+
+    void noteOverrun()          {++nOverrun;}
+
+    // Consumer side -------------------------------------------------
+
+    // Return oldest committed block, or 0 if none.
+    SampleBlock* front();
+
+    // Return front() block to producer.
+    void release();
+
+    // Either side ---------------------------------------------------
+
+    int blocks() const          {return int(head.load() - tail.load());}
+    t_ull overruns() const      {return nOverrun;}
+};
+
+/* ---------------------------------------------------------------- */
+/* SampleRingFetch ------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Fetch container that has sglx_fetch deliver straight into a
+// reserved SampleRing block: point it at the block with setBlock(),
+// then fetch at most (room / n_cs) scans. With NetClient reading
+// binary payloads directly into base_addr(), the samples are never
+// copied after leaving the socket.
+//
+// Should the server send more than the reservation holds, the data
+// land in (spill) and take() copies what fits. That costs a copy
+// but not correctness.
+//
+struct SampleRingFetch : public T_sglx_fetch {
+    SampleBlock         *B;
+    std::vector<short>  spill;
+    int                 room,   // shorts reserved at B->data
+                        got;    // shorts delivered by last fetch
+    bool                spilled;
+
+    SampleRingFetch() : B(0), room(0), got(0), spilled(false)  {}
+
+    void setBlock( SampleBlock *B, int room );
+    virtual short* base_addr( int nshort );
+
+    // Return scans now held in B (after spill copy, if any).
+    int take();
+};
+
+#endif  // SAMPLERING_H
+
+
@@ -2,6 +2,7 @@
 #include "SglxApi.h"
 #include "Comm.h"
 
+#include <memory>
 #include <sstream>
 #include <string.h>
 using namespace std;
@@ -15,6 +16,38 @@ using namespace std;
         return false;}
 
 
+// Prepared fetch: the constant tail of a FETCH command.
+// (cmd) is kept here so its capacity is reused across calls.
+//
+struct t_sglxfetch {
+    string  cmd,
+            tail;   // " <chan#chan#...> <downsample>\n"
+    short   js,
+            ip;
+};
+
+#define HF  reinterpret_cast<t_sglxfetch*>(hFetch)
+
+
+// Fail every outstanding async fetch on (S) with (msg); return how
+// many. Replies may still be on the way, so the next command must
+// reconnect. Callbacks may queue new requests: detach the queue first.
+//
+static int failAsync( t_sglxconn *S, const string &msg )
+{
+    deque<t_sglxasync>  Q;
+    Q.swap( S->pending );
+
+    S->err      = msg;
+    S->in_cmd   = true;
+
+    for( int i = 0, n = int(Q.size()); i < n; ++i )
+        Q[i].done( Q[i].ctx, 0 );
+
+    return int(Q.size());
+}
+
+
 //-----------------------------------------------------------
 // Develop/debug tools
 #if 0
@@ -54,6 +87,11 @@ SGLX_EXPORT void* SGLX_CALL sglx_createHandle(
     S->cpp_zer_str      = cpp_zer_str;
     S->cpp_set_str      = cpp_set_str;
     S->cpp_get_str      = cpp_get_str;
+    S->handle           = -1;
+    S->in_checkconn     = false;
+    S->heartbeat        = 0;
+    S->last_io          = 0;
+    S->in_cmd           = false;
 
     return S;
 }
@@ -77,11 +115,16 @@ SGLX_EXPORT bool SGLX_CALL sglx_connect(
     const char  *host,
     int         port )
 {
+    if( !HS->pending.empty() )
+        failAsync( HS, "sglx_connect: Connection reset." );
+
     HS->vers.clear();
     HS->host            = host;
     HS->port            = port;
     HS->handle          = -1;
     HS->in_checkconn    = false;
+    HS->last_io         = 0;
+    HS->in_cmd          = false;
 
     Comm    C;
 
@@ -97,6 +140,9 @@ SGLX_EXPORT bool SGLX_CALL sglx_close( void *hSglx )
     if( !hSglx )
         return true;
 
+    if( !HS->pending.empty() )
+        failAsync( HS, "sglx_close: Connection closed." );
+
     Comm    C;
 
     try {
@@ -107,6 +153,15 @@ SGLX_EXPORT bool SGLX_CALL sglx_close( void *hSglx )
 }
 
 
+SGLX_EXPORT bool SGLX_CALL sglx_cancelAsync( void *hSglx )
+{
+    if( !HS->pending.empty() )
+        failAsync( HS, "sglx_cancelAsync: Canceled." );
+
+    return true;
+}
+
+
 SGLX_EXPORT bool SGLX_CALL sglx_consoleHide( void *hSglx )
 {
     Comm    C;
@@ -145,37 +200,58 @@ SGLX_EXPORT bool SGLX_CALL sglx_enumDataDir(
 }
 
 
-SGLX_EXPORT t_ull SGLX_CALL sglx_fetch( T_sglx_fetch &io, void *hSglx, t_ull start_samp )
+// Format " <chan#chan#...> <downsample>\n" part of FETCH command.
+//
+static string fetchTail( const T_sglx_fetch &io )
+{
+    ostringstream   ss;
+
+    ss << " ";
+
+    for( int i = 0; i < io.n_cs; ++i )
+        ss << io.channel_subset[i] << "#";
+
+    if( !io.n_cs )
+        ss << "-1#";
+
+    ss << " " << io.downsample << "\n";
+
+    return ss.str();
+}
+
+
+// Read BINARY_DATA reply to a FETCH command into (io).
+//
+static t_ull fetchReply( Comm &C, T_sglx_fetch &io, void *hSglx ) noexcept(false)
 {
-    Comm    C;
     string  s;
-    char    cmd[32];
+    C.read_1s_srvside( s, HS );
 
-    try {
-        C.checkConn( HS );
-        sprintf( cmd, "FETCH %d %d %llu %d ", io.js, io.ip, start_samp, io.max_samps );
+    t_ull   headCt;
+    int     nchans, nsamps;
+    sscanf( s.c_str(), "BINARY_DATA %d %d uint64(%llu)", &nchans, &nsamps, &headCt );
 
-        ostringstream   ss;
+    C.readBinary( io._dispatch( io, nchans * nsamps ),
+        nchans * nsamps * sizeof(short), HS );
 
-        for( int i = 0; i < io.n_cs; ++i )
-            ss << io.channel_subset[i] << "#";
+    C.receiveOK( HS, "FETCH" );
 
-        if( !ss.str().size() )
-            ss << "-1#";
+    return headCt;
+}
 
-        ss << " " << io.downsample << "\n";
 
-        C.sendString( HS, cmd + ss.str() );
-        C.read_1s_srvside( s, HS );
+SGLX_EXPORT t_ull SGLX_CALL sglx_fetch( T_sglx_fetch &io, void *hSglx, t_ull start_samp )
+{
+    Comm    C;
+    char    cmd[64];
 
-        t_ull   headCt;
-        int     nchans, nsamps;
-        sscanf( s.c_str(), "BINARY_DATA %d %d uint64(%llu)", &nchans, &nsamps, &headCt );
+    try {
+        C.checkConn( HS );
+        sprintf( cmd, "FETCH %d %d %llu %d", io.js, io.ip, start_samp, io.max_samps );
 
-        C.readBinary( io._dispatch( io, nchans * nsamps ),
-            nchans * nsamps * sizeof(short), HS );
+        C.sendString( HS, cmd + fetchTail( io ) );
 
-        C.receiveOK( HS, "FETCH" );
+        t_ull   headCt = fetchReply( C, io, hSglx );
 
         if( !headCt )
             HS->cpp_set_str( HS->err, "sglx_fetch: Stream not running." );
@@ -186,6 +262,43 @@ SGLX_EXPORT t_ull SGLX_CALL sglx_fetch( T_sglx_fetch &io, void *hSglx, t_ull sta
 }
 
 
+SGLX_EXPORT bool SGLX_CALL sglx_fetchAsync(
+    T_sglx_fetch        &io,
+    void                *hSglx,
+    void                *hFetch,
+    t_ull               start_samp,
+    Tsglx_fetch_done    done,
+    void                *ctx )
+{
+    Comm    C;
+    char    cmd[64];
+
+    try {
+        // Behind outstanding requests, skip the liveness check;
+        // their replies will show whether the link is up.
+
+        if( HS->pending.empty() )
+            C.checkConn( HS );
+
+        if( hFetch ) {
+            sprintf( cmd, "FETCH %d %d %llu %d", HF->js, HF->ip, start_samp, io.max_samps );
+            HF->cmd.assign( cmd );
+            HF->cmd.append( HF->tail );
+            C.sendString( HS, HF->cmd );
+        }
+        else {
+            sprintf( cmd, "FETCH %d %d %llu %d", io.js, io.ip, start_samp, io.max_samps );
+            C.sendString( HS, cmd + fetchTail( io ) );
+        }
+
+        t_sglxasync A = {&io, done, ctx};
+        HS->pending.push_back( A );
+        return true;
+    }
+    CATCH()
+}
+
+
 SGLX_EXPORT t_ull SGLX_CALL sglx_fetchLatest( T_sglx_fetch &io, void *hSglx )
 {
     t_ull   cur_samps = sglx_getStreamSampleCount( HS, io.js, io.ip );
@@ -202,6 +315,34 @@ SGLX_EXPORT t_ull SGLX_CALL sglx_fetchLatest( T_sglx_fetch &io, void *hSglx )
 }
 
 
+SGLX_EXPORT t_ull SGLX_CALL sglx_fetchPrepared(
+    T_sglx_fetch    &io,
+    void            *hSglx,
+    void            *hFetch,
+    t_ull           start_samp )
+{
+    Comm    C;
+    char    cmd[64];
+
+    try {
+        C.checkConn( HS );
+        sprintf( cmd, "FETCH %d %d %llu %d", HF->js, HF->ip, start_samp, io.max_samps );
+
+        HF->cmd.assign( cmd );
+        HF->cmd.append( HF->tail );
+        C.sendString( HS, HF->cmd );
+
+        t_ull   headCt = fetchReply( C, io, hSglx );
+
+        if( !headCt )
+            HS->cpp_set_str( HS->err, "sglx_fetchPrepared: Stream not running." );
+
+        return headCt;
+    }
+    CATCH()
+}
+
+
 SGLX_EXPORT bool SGLX_CALL sglx_getDataDir(
     std::string &dir,
     void        *hSglx,
@@ -847,6 +988,118 @@ SGLX_EXPORT bool SGLX_CALL sglx_par2(
 }
 
 
+// A reply that fails with an ERROR line is complete, so only its
+// own request fails. Any other failure leaves the reply stream in
+// an unknown state, so every request still pending fails with it.
+//
+SGLX_EXPORT int SGLX_CALL sglx_pollAsync(
+    void    *const *hSglx,
+    int     n,
+    int     timeout_ms )
+{
+    Comm                C;
+    vector<t_sglxconn*> vS;
+
+    for( int i = 0; i < n; ++i ) {
+
+        t_sglxconn  *S = reinterpret_cast<t_sglxconn*>(hSglx[i]);
+
+        if( S && !S->pending.empty() )
+            vS.push_back( S );
+    }
+
+    int ns = int(vS.size());
+
+    if( !ns )
+        return 0;
+
+    unique_ptr<bool[]>  ready( new bool[ns] );
+
+    if( C.waitReplies( &vS[0], ns, ready.get(), timeout_ms ) < 0 ) {
+
+        for( int i = 0; i < ns; ++i )
+            vS[i]->cpp_set_str( vS[i]->err, "sglx_pollAsync: Wait failed." );
+
+        return -1;
+    }
+
+    int nDone = 0;
+
+    for( int i = 0; i < ns; ++i ) {
+
+        if( !ready[i] )
+            continue;
+
+        t_sglxconn  *S = vS[i];
+
+        // Complete replies in order for as long as they keep coming
+
+        do {
+            t_sglxasync A = S->pending.front();
+            t_ull       headCt;
+
+            try {
+                // Replies share the connection: one just completed
+                // cleared in_cmd, so only a full ERROR line may clear
+                // it for this one.
+
+                S->in_cmd = true;
+                headCt = fetchReply( C, *A.io, S );
+
+                if( !headCt )
+                    S->cpp_set_str( S->err, "sglx_pollAsync: Stream not running." );
+            }
+            catch( const exception &e ) {
+
+                string  msg = string(__func__) + ": " + e.what();
+
+                if( S->in_cmd ) {
+                    nDone += failAsync( S, msg );
+                    break;
+                }
+
+                S->err = msg;
+                headCt = 0;
+            }
+
+            S->pending.pop_front();
+            A.done( A.ctx, headCt );
+            ++nDone;
+
+            try {
+                if( S->pending.empty() || !C.replyReady( S ) )
+                    break;
+            }
+            catch( const exception &e ) {
+                nDone += failAsync( S, string(__func__) + ": " + e.what() );
+                break;
+            }
+        } while( true );
+    }
+
+    return nDone;
+}
+
+
+SGLX_EXPORT void* SGLX_CALL sglx_prepareFetch( const T_sglx_fetch &io )
+{
+    t_sglxfetch *F = new t_sglxfetch;
+
+    F->tail = fetchTail( io );
+    F->js   = io.js;
+    F->ip   = io.ip;
+
+    return F;
+}
+
+
+SGLX_EXPORT void SGLX_CALL sglx_destroyFetch( void *hFetch )
+{
+    if( hFetch )
+        delete HF;
+}
+
+
 SGLX_EXPORT bool SGLX_CALL sglx_setAnatomy_Pinpoint(
     void                *hSglx,
     const std::string   &shankdat )
@@ -1102,6 +1355,13 @@ SGLX_EXPORT bool SGLX_CALL sglx_setRunName(
 }
 
 
+SGLX_EXPORT bool SGLX_CALL sglx_setSessionMode( void *hSglx, int heartbeat_ms )
+{
+    HS->heartbeat = (heartbeat_ms > 0 ? heartbeat_ms / 1000.0 : 0);
+    return true;
+}
+
+
 SGLX_EXPORT bool SGLX_CALL sglx_setTriggerOffBeep(
     void    *hSglx,
     int     hertz,
@@ -5,6 +5,7 @@
 /* C++ API -------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+#include <deque>
 #include <map>
 #include <string>
 #include <vector>
@@ -216,6 +217,22 @@ struct t_sglxshankmap {
 
 typedef unsigned long long t_ull;
 
+/* ---------------------------------------------------------------- */
+/* Asynchronous fetch --------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Completion callback for sglx_fetchAsync; (ctx) is as given there.
+// (headCt) is what sglx_fetch would have returned: zero if error,
+// in which case sglx_getError() on the connection has the reason.
+typedef void (SGLX_CALL *Tsglx_fetch_done)( void *ctx, t_ull headCt );
+
+// One request awaiting its reply.
+struct t_sglxasync {
+    T_sglx_fetch        *io;
+    Tsglx_fetch_done    done;
+    void                *ctx;
+};
+
 /* ---------------------------------------------------------------- */
 /* Private server-side handle ------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -234,6 +251,14 @@ struct t_sglxconn {
                         handle;
     bool                in_checkconn;
 
+    // Session mode (see sglx_setSessionMode)
+    double              heartbeat,  // secs; 0 = NOOP every command
+                        last_io;    // secs; last complete reply
+    bool                in_cmd;     // command sent, reply not complete
+
+    // Fetches sent by sglx_fetchAsync, oldest first
+    std::deque<t_sglxasync>             pending;
+
     // C client data storage
     std::string                         xstr;
     std::vector<int>                    xvint;
@@ -294,9 +319,16 @@ SGLX_EXPORT bool SGLX_CALL sglx_connect(
     int         port    = 4142 );
 
 // Close connection and release network resources.
+// Outstanding sglx_fetchAsync requests fail, as by sglx_cancelAsync.
 //
 SGLX_EXPORT bool SGLX_CALL sglx_close( void *hSglx );
 
+// Fail every outstanding sglx_fetchAsync on this connection: each
+// callback runs, with headCt = 0. Any replies still to come are
+// abandoned, so the next command reconnects first.
+//
+SGLX_EXPORT bool SGLX_CALL sglx_cancelAsync( void *hSglx );
+
 // Hide console/log window to reduce screen clutter.
 //
 SGLX_EXPORT bool SGLX_CALL sglx_consoleHide( void *hSglx );
@@ -327,6 +359,29 @@ SGLX_EXPORT bool SGLX_CALL sglx_enumDataDir(
 //
 SGLX_EXPORT t_ull SGLX_CALL sglx_fetch( T_sglx_fetch &io, void *hSglx, t_ull start_samp );
 
+// Send the same request as sglx_fetchPrepared (or, if hFetch = 0,
+// as sglx_fetch) but return without waiting for the reply. The
+// reply is read into (io), and done(ctx, headCt) is called, from
+// within a later sglx_pollAsync on this connection. (io) must stay
+// valid until then.
+//
+// Several requests may be in flight on one connection; replies
+// come back, and callbacks run, in the order the requests were
+// sent. While any are outstanding, the connection accepts only
+// more sglx_fetchAsync calls; other commands fail until
+// sglx_pollAsync (or sglx_cancelAsync) has completed them all.
+//
+// Return true if the request was sent. If false, no callback
+// will be made.
+//
+SGLX_EXPORT bool SGLX_CALL sglx_fetchAsync(
+    T_sglx_fetch        &io,
+    void                *hSglx,
+    void                *hFetch,
+    t_ull               start_samp,
+    Tsglx_fetch_done    done,
+    void                *ctx );
+
 // Get binary stream data as linear array.
 // Samp count = MIN(max_samps,available).
 // Each sample contains N 16-bit channels, N depends upon channel_subset.
@@ -340,6 +395,20 @@ SGLX_EXPORT t_ull SGLX_CALL sglx_fetch( T_sglx_fetch &io, void *hSglx, t_ull sta
 //
 SGLX_EXPORT t_ull SGLX_CALL sglx_fetchLatest( T_sglx_fetch &io, void *hSglx );
 
+// Same as sglx_fetch, but the (js, ip, channel_subset, downsample)
+// part of the command comes from a handle made by sglx_prepareFetch,
+// so a large channel list isn't re-serialized on every call. Only
+// io.max_samps is read from (io); data are returned through (io)
+// as usual.
+//
+// Return headCt = index of first sample, or zero if error.
+//
+SGLX_EXPORT t_ull SGLX_CALL sglx_fetchPrepared(
+    T_sglx_fetch    &io,
+    void            *hSglx,
+    void            *hFetch,
+    t_ull           start_samp );
+
 // Get ith global data directory.
 // Get main data directory by setting idir=0 or omitting it.
 //
@@ -598,6 +667,33 @@ SGLX_EXPORT bool SGLX_CALL sglx_par2(
     char                op,
     const std::string   &file );
 
+// Event loop step for sglx_fetchAsync: wait up to (timeout_ms) for
+// a reply on any of the (n) connections (hSglx[]), in one select
+// over all their sockets. Then complete every reply that has
+// arrived, calling its callback. A connection that fails gets all
+// its outstanding callbacks, with headCt = 0.
+//
+// Return the number of requests completed (0 if timed out), or -1
+// if the wait itself failed.
+//
+SGLX_EXPORT int SGLX_CALL sglx_pollAsync(
+    void    *const *hSglx,
+    int     n,
+    int     timeout_ms );
+
+// Serialize the stream selectors, channel list and downsample
+// factor of (io) once, for repeated use with sglx_fetchPrepared.
+// Later changes to those fields of (io) are not seen by the handle.
+// The handle is not tied to any connection.
+//
+// Return handle, to be released with sglx_destroyFetch.
+//
+SGLX_EXPORT void* SGLX_CALL sglx_prepareFetch( const T_sglx_fetch &io );
+
+// Release a handle made by sglx_prepareFetch.
+//
+SGLX_EXPORT void SGLX_CALL sglx_destroyFetch( void *hFetch );
+
 // Set anatomy data string with Pinpoint format:
 // [probe-id,shank-id](startpos,endpos,R,G,B,rgnname)(startpos,endpos,R,G,B,rgnname)…()
 //    - probe-id: SpikeGLX logical probe id.
@@ -741,6 +837,18 @@ SGLX_EXPORT bool SGLX_CALL sglx_setRunName(
     void                *hSglx,
     const std::string   &name );
 
+// By default, every command is preceded by a NOOP round trip
+// to verify the connection. Setting heartbeat_ms > 0 enables
+// session mode: the NOOP is sent only if no reply has completed
+// within the last heartbeat_ms, so a client issuing a steady
+// stream of commands pays one round trip per command. If a
+// command fails partway through its reply, the next command
+// reconnects first. Set heartbeat_ms = 0 to restore default.
+//
+// This is client-side only; nothing is sent to the server.
+//
+SGLX_EXPORT bool SGLX_CALL sglx_setSessionMode( void *hSglx, int heartbeat_ms );
+
 // During a run, set frequency and duration of Windows
 // beep signaling file closure. hertz=0 disables the beep.
 //
@@ -0,0 +1,359 @@
+
+#include "SglxFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32    // WINDOWS
+#include <windows.h>
+#else           // UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <fstream>
+
+
+
+
+SglxFile::SglxFile( int ip )
+    :   base(0), mapBytes(0), nScans(0), srate(0),
+        nCols(0), js(-1), ip(ip)
+{
+}
+
+
+SglxFile::~SglxFile()
+{
+    if( base ) {
+#ifdef WIN32
+        UnmapViewOfFile( base );
+#else
+        munmap( (void*)base, mapBytes );
+#endif
+    }
+}
+
+
+int SglxFile::streamOf( const std::string &bin )
+{
+    if( bin.find( ".nidq." ) != std::string::npos )
+        return 0;
+
+    if( bin.find( ".obx." ) != std::string::npos )
+        return 1;
+
+    if( bin.find( ".ap." ) != std::string::npos )
+        return 2;
+
+    return -1;
+}
+
+
+std::string SglxFile::open( const std::string &bin )
+{
+    if( (js = streamOf( bin )) < 0 )
+        return "Unrecognized stream type: " + bin;
+
+    size_t  dot = bin.rfind( ".bin" );
+
+    if( dot == std::string::npos )
+        return "Not a .bin file: " + bin;
+
+    std::string metaPath = bin.substr( 0, dot ) + ".meta";
+
+    if( !parseMeta( metaPath ) )
+        return "Can't read metadata: " + metaPath;
+
+// Rate, channel counts per type
+
+    const char  *rateKey, *typeKey;
+
+    if( js == 0 ) {
+        rateKey = "niSampRate";
+        typeKey = "snsMnMaXaDw";
+    }
+    else if( js == 1 ) {
+        rateKey = "obSampRate";
+        typeKey = "snsXaDwSy";
+    }
+    else {
+        rateKey = "imSampRate";
+        typeKey = "snsApLfSy";
+    }
+
+    if( !(srate = metaDbl( rateKey )) )
+        return std::string("Missing ") + rateKey + " in " + metaPath;
+
+    acqChans.clear();
+
+    std::string types = meta[typeKey];
+    int         nAcq  = 0;
+
+    for( const char *p = types.c_str(); *p; ) {
+
+        char    *end;
+        long    n = strtol( p, &end, 10 );
+
+        if( end == p )
+            break;
+
+        acqChans.push_back( int(n) );
+        nAcq += int(n);
+        p = (*end == ',' ? end + 1 : end);
+    }
+
+    if( !nAcq )
+        return std::string("Missing ") + typeKey + " in " + metaPath;
+
+    if( !(nCols = int(metaDbl( "nSavedChans" ))) )
+        return "Missing nSavedChans in " + metaPath;
+
+    acq2col.assign( nAcq, -1 );
+
+    if( !parseSaveSubset( meta["snsSaveChanSubset"] ) )
+        return "Bad snsSaveChanSubset in " + metaPath;
+
+// Map binary
+
+#ifdef WIN32
+    HANDLE  hf = CreateFileA( bin.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                    0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0 );
+
+    if( hf == INVALID_HANDLE_VALUE )
+        return "Can't open " + bin;
+
+    LARGE_INTEGER   sz;
+    GetFileSizeEx( hf, &sz );
+
+    mapBytes    = size_t(sz.QuadPart);
+    nScans      = mapBytes / (sizeof(short) * nCols);
+
+    if( !nScans ) {
+        CloseHandle( hf );
+        return "Empty file " + bin;
+    }
+
+    HANDLE  hm  = CreateFileMappingA( hf, 0, PAGE_READONLY, 0, 0, 0 );
+    void    *p  = (hm ? MapViewOfFile( hm, FILE_MAP_READ, 0, 0, 0 ) : 0);
+
+    if( hm )
+        CloseHandle( hm );
+    CloseHandle( hf );
+
+    if( !p )
+        return "Can't map " + bin;
+#else
+    int fd = ::open( bin.c_str(), O_RDONLY );
+
+    if( fd < 0 )
+        return "Can't open " + bin;
+
+    struct stat st;
+    fstat( fd, &st );
+
+    mapBytes    = size_t(st.st_size);
+    nScans      = mapBytes / (sizeof(short) * nCols);
+
+    if( !nScans ) {
+        ::close( fd );
+        return "Empty file " + bin;
+    }
+
+    void    *p = mmap( 0, mapBytes, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+
+    if( p == MAP_FAILED )
+        return "Can't map " + bin;
+
+    madvise( p, mapBytes, MADV_SEQUENTIAL );
+#endif
+    base = static_cast<const short*>(p);
+
+    return "";
+}
+
+
+// ~snsGeomMap=(part,nshanks,pitch,width)(s:x:z:u)(s:x:z:u)...
+// Entries follow the saved channels of the first type (AP).
+//
+std::vector<std::string> SglxFile::geomMap() const
+{
+    std::vector<std::string>    lines;
+
+    auto    it = meta.find( "~snsGeomMap" );
+
+    if( it == meta.end() )
+        return lines;
+
+    const std::string   &s = it->second;
+    size_t              L  = s.find( '(' ),
+                        R  = s.find( ')', L );
+
+    if( L == std::string::npos || R == std::string::npos )
+        return lines;
+
+    char    part[64];
+    int     ns, pitch, width;
+
+    if( 4 != sscanf( s.substr( L + 1, R - L - 1 ).c_str(),
+                "%63[^,],%d,%d,%d", part, &ns, &pitch, &width ) ) {
+
+        return lines;
+    }
+
+    lines.push_back( std::string("head_partNumber=") + part );
+    lines.push_back( "head_numShanks=" + std::to_string( ns ) );
+    lines.push_back( "head_shankPitch=" + std::to_string( pitch ) );
+    lines.push_back( "head_shankWidth=" + std::to_string( width ) );
+
+    int nAP = (acqChans.empty() ? 0 : acqChans[0]),
+        ic  = 0;
+
+    while( (L = s.find( '(', R )) != std::string::npos
+            && (R = s.find( ')', L )) != std::string::npos ) {
+
+        int sh, x, z, u;
+
+        if( 4 != sscanf( s.c_str() + L + 1, "%d:%d:%d:%d", &sh, &x, &z, &u ) )
+            break;
+
+        // next saved AP channel
+        while( ic < nAP && acq2col[ic] < 0 )
+            ++ic;
+
+        if( ic >= nAP )
+            break;
+
+        std::string ch = "ch" + std::to_string( ic++ );
+
+        lines.push_back( ch + "_s=" + std::to_string( sh ) );
+        lines.push_back( ch + "_x=" + std::to_string( x ) );
+        lines.push_back( ch + "_z=" + std::to_string( z ) );
+        lines.push_back( ch + "_u=" + std::to_string( u ) );
+    }
+
+    return lines;
+}
+
+
+bool SglxFile::columns( std::vector<int> &cols, const int *chans, int nc ) const
+{
+    cols.resize( nc );
+
+    for( int ic = 0; ic < nc; ++ic ) {
+
+        int c = chans[ic];
+
+        if( c < 0 || c >= nAcqChans() || acq2col[c] < 0 )
+            return false;
+
+        cols[ic] = acq2col[c];
+    }
+
+    return true;
+}
+
+
+void SglxFile::gather(
+    short                   *dst,
+    const std::vector<int>  &cols,
+    t_ull                   from,
+    int                     n,
+    int                     ds ) const
+{
+    int nc = int(cols.size());
+
+    for( int i = 0; i < n; ++i, dst += nc ) {
+
+        const short *row = base + ((from + t_ull(i) * ds) % nScans) * nCols;
+
+        for( int ic = 0; ic < nc; ++ic )
+            dst[ic] = row[cols[ic]];
+    }
+}
+
+
+bool SglxFile::parseMeta( const std::string &path )
+{
+    std::ifstream   in( path );
+
+    if( !in )
+        return false;
+
+    std::string line;
+
+    while( std::getline( in, line ) ) {
+
+        if( !line.empty() && line.back() == '\r' )
+            line.pop_back();
+
+        size_t  eq = line.find( '=' );
+
+        if( eq != std::string::npos )
+            meta[line.substr( 0, eq )] = line.substr( eq + 1 );
+    }
+
+    return !meta.empty();
+}
+
+
+// "all" or comma-separated list of channels and ranges "a:b".
+// The i-th saved channel is column i of the binary file.
+//
+bool SglxFile::parseSaveSubset( const std::string &s )
+{
+    int nAcq = nAcqChans(),
+        col  = 0;
+
+    if( s.empty() || s == "all" ) {
+
+        if( nCols != nAcq )
+            return false;
+
+        for( int c = 0; c < nAcq; ++c )
+            acq2col[c] = c;
+
+        return true;
+    }
+
+    for( const char *p = s.c_str(); *p; ) {
+
+        char    *end;
+        long    a = strtol( p, &end, 10 ),
+                b = a;
+
+        if( end == p )
+            return false;
+
+        if( *end == ':' ) {
+            p = end + 1;
+            b = strtol( p, &end, 10 );
+        }
+
+        for( long c = a; c <= b; ++c ) {
+
+            if( c < 0 || c >= nAcq || col >= nCols )
+                return false;
+
+            acq2col[c] = col++;
+        }
+
+        p = (*end == ',' ? end + 1 : end);
+    }
+
+    return col == nCols;
+}
+
+
+double SglxFile::metaDbl( const std::string &key ) const
+{
+    auto    it = meta.find( key );
+
+    return (it != meta.end() ? atof( it->second.c_str() ) : 0);
+}
+
+
@@ -0,0 +1,89 @@
+#ifndef SGLXFILE_H
+#define SGLXFILE_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include <map>
+#include <string>
+#include <vector>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+typedef unsigned long long t_ull;
+
+/* ---------------------------------------------------------------- */
+/* SglxFile ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// One recorded SpikeGLX stream: a read-only memory-mapped .bin and
+// its parsed .meta. No Qt; shared with SglxReplay.
+//
+// Channels are addressed by acquired channel index, as in FETCH.
+// Only those saved in the file (snsSaveChanSubset) can be read.
+//
+// The stream selectors follow from the file name:
+//      *.nidq.bin      -> js = 0
+//      *.obx.bin       -> js = 1
+//      *.ap.bin        -> js = 2
+// (ip) is supplied by the caller.
+//
+class SglxFile
+{
+private:
+    std::map<std::string,std::string>   meta;
+    std::vector<int>                    acqChans,   // per type
+                                        acq2col;    // -1 = not saved
+    const short                         *base;
+    size_t                              mapBytes;
+    t_ull                               nScans;
+    double                              srate;
+    int                                 nCols,
+                                        js,
+                                        ip;
+
+public:
+    SglxFile( int ip = 0 );
+    virtual ~SglxFile();
+
+    // Return js for (bin) by file name, or -1 if unrecognized.
+    static int streamOf( const std::string &bin );
+
+    // Map (bin) and parse its .meta. Return error string, or "".
+    std::string open( const std::string &bin );
+
+    int getJS() const                               {return js;}
+    int getIP() const                               {return ip;}
+    double sampleRate() const                       {return srate;}
+    const std::vector<int> &acqChanCounts() const   {return acqChans;}
+    int nAcqChans() const                           {return int(acq2col.size());}
+    bool isSaved( int c ) const                     {return acq2col[c] >= 0;}
+    t_ull fileScans() const                         {return nScans;}
+
+    // Lines as GETGEOMMAP returns them, or empty if no ~snsGeomMap.
+    std::vector<std::string> geomMap() const;
+
+    // File columns of acquired channels (chans); false if any unsaved.
+    bool columns( std::vector<int> &cols, const int *chans, int nc ) const;
+
+    // Copy scans (from + i*ds), i in [0,n), of file columns (cols)
+    // into (dst), interleaved. Scan indices wrap at end of file.
+    void gather(
+        short                   *dst,
+        const std::vector<int>  &cols,
+        t_ull                   from,
+        int                     n,
+        int                     ds ) const;
+
+private:
+    bool parseMeta( const std::string &path );
+    bool parseSaveSubset( const std::string &s );
+    double metaDbl( const std::string &key ) const;
+};
+
+#endif  // SGLXFILE_H
+
+
@@ -5,6 +5,7 @@
 
 #include <cstring>
 #include <cstdlib>
+#include <mutex>
 
 #define CONNCLOSED  std::runtime_error("Connection closed by peer.")
 
@@ -368,6 +369,51 @@ bool Socket::waitData( uint waitMS ) noexcept(false)
 }
 
 
+int Socket::waitAny( Socket *const *vS, int n, bool *ready, uint waitMS )
+{
+    fd_set  readfds;
+    FD_ZERO( &readfds );
+
+    Sock_t  maxSock = -1;
+
+    for( int i = 0; i < n; ++i ) {
+
+        ready[i] = false;
+
+        if( vS[i] && vS[i]->isValid() ) {
+
+            FD_SET( vS[i]->m_sock, &readfds );
+
+            if( vS[i]->m_sock > maxSock )
+                maxSock = vS[i]->m_sock;
+        }
+    }
+
+    if( maxSock < 0 )
+        return -1;
+
+    int sec = waitMS / 1000,
+        ms  = waitMS - 1000 * sec;
+
+    struct timeval  tv;
+    tv.tv_sec   = sec;
+    tv.tv_usec  = 1000 * ms;
+
+    int ret = select( maxSock + 1, &readfds, 0, 0, &tv );
+
+    if( ret <= 0 )
+        return ret;
+
+    for( int i = 0; i < n; ++i ) {
+
+        if( vS[i] && vS[i]->isValid() )
+            ready[i] = FD_ISSET( vS[i]->m_sock, &readfds ) != 0;
+    }
+
+    return ret;
+}
+
+
 uint Socket::nReadyForRead() noexcept(false)
 {
     if( !isValid() )
@@ -406,6 +452,12 @@ void Socket::resolveHostAddr(
     const std::string   &host,
     uint16              port )
 {
+// gethostbyname returns static storage; serialize resolution
+// for clients that connect from several threads.
+
+    static std::mutex           resolveMutex;
+    std::lock_guard<std::mutex> lock( resolveMutex );
+
     struct hostent  *he = gethostbyname( host.c_str() );
 
     if( !he ) {
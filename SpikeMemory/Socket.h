@@ -65,6 +65,11 @@ public:
     bool waitData( uint waitMS = 10 ) noexcept(false);
     uint nReadyForRead() noexcept(false);
 
+    // Wait up to (waitMS) until any of the (n) sockets (vS[], null
+    // entries skipped) has something to read, or was closed. Set
+    // ready[i] for each that has. Return how many, or -1 if error.
+    static int waitAny( Socket *const *vS, int n, bool *ready, uint waitMS );
+
 private:
     void resolveHostAddr();
     static void resolveHostAddr(
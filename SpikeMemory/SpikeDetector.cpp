@@ -0,0 +1,660 @@
+
+#include "SpikeDetector.h"
+#include "DspKernels.h"
+
+#include <algorithm>
+#include <type_traits>
+
+#include <math.h>
+
+
+/* ---------------------------------------------------------------- */
+/* Bounds --------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// A sample crosses if it is above hi or below lo, tested in the
+// data's own type. For int16, x > hi exactly when x > floor(hi),
+// and x < lo when x < ceil(lo). For float, the nearest floats on
+// the inside. NaN bounds never cross.
+
+static short boundAbove16( double hi )
+{
+    if( !(hi < 32767) )
+        return 32767;
+
+    return short(std::max( floor( hi ), -32768.0 ));
+}
+
+
+static short boundBelow16( double lo )
+{
+    if( !(lo > -32768) )
+        return -32768;
+
+    return short(std::min( ceil( lo ), 32767.0 ));
+}
+
+
+static float boundAboveF( double hi )
+{
+    float   f = float(hi);
+
+    return (f > hi ? nextafterf( f, -INFINITY ) : f);
+}
+
+
+static float boundBelowF( double lo )
+{
+    float   f = float(lo);
+
+    return (f < lo ? nextafterf( f, INFINITY ) : f);
+}
+
+/* ---------------------------------------------------------------- */
+/* Policies ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// energy:  detect on the nonlinear energy, not the samples.
+// bounds:  channel (c)'s crossing bounds, given the block's inputs
+//          and (energyMean), the policy's own per-channel baseline.
+
+struct Absolute {
+    enum {energy = 0};
+
+    static void bounds(
+        const SpikeDetector::Input  &in,
+        const double                *energyMean,
+        int                         c,
+        double                      &hi,
+        double                      &lo )
+    {
+        (void)energyMean;
+        hi = in.mean[c] + in.threshold;
+        lo = in.mean[c] - in.threshold;
+    }
+};
+
+
+struct RmsScaled {
+    enum {energy = 0};
+
+    static void bounds(
+        const SpikeDetector::Input  &in,
+        const double                *energyMean,
+        int                         c,
+        double                      &hi,
+        double                      &lo )
+    {
+        (void)energyMean;
+        double  span = in.threshold * in.rms[c];
+
+        hi = in.mean[c] + span;
+        lo = in.mean[c] - span;
+    }
+};
+
+
+struct Neo {
+    enum {energy = 1};
+
+    static void bounds(
+        const SpikeDetector::Input  &in,
+        const double                *energyMean,
+        int                         c,
+        double                      &hi,
+        double                      &lo )
+    {
+        hi = in.threshold * energyMean[c];
+        lo = -INFINITY;
+    }
+};
+
+/* ---------------------------------------------------------------- */
+/* Helpers -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Sample (t, c) of a block, or for t < 0 of the tail before it;
+// (tailEnd) points one scan past the tail.
+//
+template<typename T>
+static inline float sampleAt(
+    const float *tailEnd,
+    const T     *data,
+    int         nc,
+    int         t,
+    int         c )
+{
+    if( t < 0 )
+        return tailEnd[t * nc + c];
+
+    return float(data[size_t(t) * nc + c]);
+}
+
+
+// Energy of a scan, x1^2 - x0*x2, from it and its neighbors.
+//
+template<typename T>
+static void energyRow(
+    float       *e,
+    double      *eSum,
+    const T     *x0,
+    const T     *x1,
+    const T     *x2,
+    int         nc )
+{
+    for( int c = 0; c < nc; ++c ) {
+
+        e[c] = float(x1[c]) * float(x1[c]) - float(x0[c]) * float(x2[c]);
+        eSum[c] += e[c];
+    }
+}
+
+
+// Copy waveform samples [from, to) of a spike at block scan (s).
+//
+template<typename T>
+static void fillWave(
+    float       *w,
+    const float *tailEnd,
+    const T     *data,
+    int         nc,
+    int         c,
+    int         s,
+    int         halfWidth,
+    int         from,
+    int         to )
+{
+    for( int j = from; j < to; ++j )
+        w[j] = sampleAt( tailEnd, data, nc, s - halfWidth + j, c );
+}
+
+/* ---------------------------------------------------------------- */
+/* SpikeDetector -------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void SpikeDetector::configure(
+    DetectMode  mode,
+    int         nchans,
+    int         refractory,
+    int         halfWidth )
+{
+    this->mode          = mode;
+    this->nchans        = nchans;
+    this->refractory    = refractory;
+    this->halfWidth     = halfWidth;
+
+    energyMean.assign( nchans, NAN );
+    vHit.clear();
+    waves.clear();
+    held.clear();
+    heldWaves.clear();
+    raw.clear();
+    rawWaves.clear();
+    cand.clear();
+    candWaves.clear();
+    candAmp.clear();
+    nDecided = 0;
+    restart();
+
+    switch( mode ) {
+        case detect_rms:    pick<RmsScaled>(); break;
+        case detect_neo:    pick<Neo>(); break;
+        default:            pick<Absolute>(); break;
+    }
+}
+
+
+void SpikeDetector::setNeighbors(
+    const std::vector<int>      &shank,
+    const std::vector<float>    &x,
+    const std::vector<float>    &z,
+    float                       radius )
+{
+    int n = int(shank.size());
+
+    nbrStart.assign( 1, 0 );
+    nbrList.clear();
+
+    for( int c = 0; c < n; ++c ) {
+
+        if( shank[c] >= 0 ) {
+
+            for( int d = 0; d < n; ++d ) {
+
+                if( d == c || shank[d] != shank[c] )
+                    continue;
+
+                float   dx = x[d] - x[c],
+                        dz = z[d] - z[c];
+
+                if( dx*dx + dz*dz <= radius*radius )
+                    nbrList.push_back( d );
+            }
+        }
+
+        nbrStart.push_back( int(nbrList.size()) );
+    }
+
+    isNbr.assign( n, 0 );
+}
+
+
+void SpikeDetector::flush()
+{
+    vHit.clear();
+    waves.clear();
+    raw.swap( held );
+    rawWaves.swap( heldWaves );
+    held.clear();
+    heldWaves.clear();
+    passOn( 0, true );
+    restart();
+}
+
+
+void SpikeDetector::restart()
+{
+    tailScans   = 0;
+    energyCount = 0;
+    streamEnd   = -1;
+    nextScan.assign( nchans, INT64_MIN );
+    energySum.assign( nchans, 0 );
+}
+
+
+template<class Policy>
+void SpikeDetector::pick()
+{
+    switch( nchans ) {
+        case 384:
+            fn16    = detectT<Policy,384,short>;
+            fnF     = detectT<Policy,384,float>;
+            break;
+        case 385:
+            fn16    = detectT<Policy,385,short>;
+            fnF     = detectT<Policy,385,float>;
+            break;
+        default:
+            fn16    = detectT<Policy,0,short>;
+            fnF     = detectT<Policy,0,float>;
+            break;
+    }
+}
+
+
+// Keep the stream's last halfWidth + 1 (at least 2) scans: enough for
+// early waveforms, including those of energy spikes at the scan before
+// a block, and for that scan's energy.
+//
+template<typename T>
+void SpikeDetector::keepTail( const T *data, int ntpts )
+{
+    const int   nc      = nchans,
+                want    = std::max( halfWidth + 1, 2 ),
+                fromOld = std::max( 0, std::min( tailScans, want - ntpts ) ),
+                fromNew = std::min( ntpts, want );
+
+    if( fromOld )
+        std::copy( tail.end() - size_t(fromOld) * nc, tail.end(), tail.begin() );
+
+    tail.resize( size_t(fromOld + fromNew) * nc );
+
+    const T *src = data + size_t(ntpts - fromNew) * nc;
+    float   *dst = &tail[size_t(fromOld) * nc];
+
+    for( size_t k = 0, n = size_t(fromNew) * nc; k < n; ++k )
+        dst[k] = float(src[k]);
+
+    tailScans = fromOld + fromNew;
+}
+
+
+// Pass the new spikes (raw) on to hits(). With deduplication, each
+// waits until all spikes within dedupWindow after it are known, and
+// goes on only if it's the largest (peak to peak, about the spike)
+// among its neighbors' spikes within dedupWindow. Spikes before scan
+// (known) have all come in; (final) decides everything now.
+//
+void SpikeDetector::passOn( int64_t known, bool final )
+{
+    const int   H = halfWidth,
+                W = 2 * H;
+
+    if( !dedupWindow && cand.empty() ) {
+
+        vHit.insert( vHit.end(), raw.begin(), raw.end() );
+        waves.insert( waves.end(), rawWaves.begin(), rawWaves.end() );
+        raw.clear();
+        rawWaves.clear();
+        return;
+    }
+
+// Candidates, with amplitudes
+
+    for( size_t k = 0; k < raw.size(); ++k ) {
+
+        const SpikeHit  &h  = raw[k];
+        const float     *w  = &rawWaves[k * W];
+        int             j0  = std::max( h.first, H - dedupWindow ),
+                        j1  = std::min( h.last, H + dedupWindow + 1 );
+        float           lo  = 0,
+                        hi  = 0;
+
+        for( int j = j0; j < j1; ++j ) {
+
+            if( j == j0 || w[j] < lo )
+                lo = w[j];
+            if( j == j0 || w[j] > hi )
+                hi = w[j];
+        }
+
+        cand.push_back( h );
+        candWaves.insert( candWaves.end(), w, w + W );
+        candAmp.push_back( hi - lo );
+    }
+
+    raw.clear();
+    rawWaves.clear();
+
+// Decide, in time order
+
+    for( ; nDecided < cand.size(); ++nDecided ) {
+
+        size_t          i   = nDecided;
+        const SpikeHit  &h  = cand[i];
+
+        if( !final && h.scan + dedupWindow >= known )
+            break;
+
+        int k0 = 0,
+            k1 = 0;
+
+        if( h.chan + 1 < int(nbrStart.size()) ) {
+            k0 = nbrStart[h.chan];
+            k1 = nbrStart[h.chan + 1];
+        }
+
+        for( int k = k0; k < k1; ++k )
+            isNbr[nbrList[k]] = 1;
+
+        bool    peak = true;
+
+        for( size_t j = i; peak && j-- > 0 && cand[j].scan >= h.scan - dedupWindow; ) {
+
+            if( isNbr[cand[j].chan] && candAmp[j] >= candAmp[i] )
+                peak = false;
+        }
+
+        for( size_t j = i + 1; peak && j < cand.size() && cand[j].scan <= h.scan + dedupWindow; ++j ) {
+
+            if( isNbr[cand[j].chan] && candAmp[j] > candAmp[i] )
+                peak = false;
+        }
+
+        for( int k = k0; k < k1; ++k )
+            isNbr[nbrList[k]] = 0;
+
+        if( peak ) {
+            vHit.push_back( h );
+            waves.insert( waves.end(), &candWaves[i * W], &candWaves[i * W] + W );
+        }
+    }
+
+// Keep decided spikes only while undecided or later ones may need them
+
+    size_t  nDrop = nDecided;
+
+    if( !final ) {
+
+        int64_t next = (nDecided < cand.size() ? cand[nDecided].scan : known);
+
+        nDrop = 0;
+
+        while( nDrop < nDecided && cand[nDrop].scan + dedupWindow < next )
+            ++nDrop;
+    }
+
+    cand.erase( cand.begin(), cand.begin() + nDrop );
+    candAmp.erase( candAmp.begin(), candAmp.begin() + nDrop );
+    candWaves.erase( candWaves.begin(), candWaves.begin() + nDrop * W );
+    nDecided -= nDrop;
+}
+
+
+// The loop every policy shares. With NCH nonzero the channel count
+// and mask width are constants.
+//
+template<class Policy, int NCH, typename T>
+void SpikeDetector::detectT(
+    SpikeDetector   &D,
+    const T         *data,
+    int             ntpts,
+    int64_t         firstScan,
+    const Input     &in )
+{
+    const int           nc      = (NCH ? NCH : D.nchans),
+                        words   = (nc + 63) / 64,
+                        tile    = 64,
+                        H       = D.halfWidth,
+                        W       = 2 * H;
+    const DspKernels    &K      = dspKernels();
+    // Samples compared as float: float data, or energy
+    const bool          cmpF    = Policy::energy || std::is_same<T,float>::value;
+
+    D.vHit.clear();
+    D.waves.clear();
+
+    if( ntpts <= 0 )
+        return;
+
+// A gap: held spikes go out as they are
+
+    if( firstScan != D.streamEnd ) {
+
+        D.raw.swap( D.held );
+        D.rawWaves.swap( D.heldWaves );
+        D.held.clear();
+        D.heldWaves.clear();
+        D.passOn( 0, true );
+        D.restart();
+    }
+
+    const float *tailEnd = D.tail.data() + size_t(D.tailScans) * nc;
+
+// Finish held waveforms, in time order, ahead of this block's
+
+    {
+        size_t  nHeld = 0;
+
+        for( size_t k = 0; k < D.held.size(); ++k ) {
+
+            SpikeHit    h   = D.held[k];
+            int         s   = int(h.scan - firstScan),
+                        to  = std::min( W, ntpts - s + H );
+            float       *w  = &D.heldWaves[k * W];
+
+            fillWave( w, tailEnd, data, nc, h.chan, s, H, h.last, to );
+            h.last = to;
+
+            if( to == W ) {
+                D.raw.push_back( h );
+                D.rawWaves.insert( D.rawWaves.end(), w, w + W );
+            }
+            else {
+                std::copy( w, w + W, &D.heldWaves[nHeld * W] );
+                D.held[nHeld++] = h;
+            }
+        }
+
+        D.held.resize( nHeld );
+        D.heldWaves.resize( nHeld * W );
+    }
+
+// Bounds
+
+    if( cmpF ) {
+        D.hiF.resize( nc );
+        D.loF.resize( nc );
+    }
+    else {
+        D.hi16.resize( nc );
+        D.lo16.resize( nc );
+    }
+
+    auto    setBounds = [&]() {
+
+        for( int c = 0; c < nc; ++c ) {
+
+            double  hi, lo;
+
+            Policy::bounds( in, &D.energyMean[0], c, hi, lo );
+
+            if( cmpF ) {
+                D.hiF[c] = boundAboveF( hi );
+                D.loF[c] = boundBelowF( lo );
+            }
+            else {
+                D.hi16[c] = boundAbove16( hi );
+                D.lo16[c] = boundBelow16( lo );
+            }
+        }
+    };
+
+    setBounds();
+
+// Scans tested: the block's; for energy, from the one before the
+// block (if any) to the one before its last.
+
+    int tBeg = 0,
+        tEnd = ntpts;
+
+    if( Policy::energy ) {
+
+        tBeg = (D.tailScans ? -1 : 0);
+        tEnd = ntpts - 1;
+        D.energySum.resize( nc, 0 );
+        D.energy.resize( size_t(tile) * nc );
+    }
+
+    D.mask.resize( size_t(tile) * words );
+
+// Crossings, a tile at a time. For energy, tiles end on the
+// stream's multiples of (tile), where the mean is updated.
+
+    for( int t0 = tBeg, nt; t0 < tEnd; t0 += nt ) {
+
+        nt = std::min( tile, tEnd - t0 );
+
+        if( Policy::energy ) {
+
+            int64_t scan = firstScan + t0;
+            int     left = tile - int(((scan % tile) + tile) % tile);
+
+            nt = std::min( nt, left );
+        }
+
+        if( Policy::energy ) {
+
+            for( int it = 0; it < nt; ++it ) {
+
+                int     t = t0 + it;
+                float   *e = &D.energy[size_t(it) * nc];
+
+                if( t > 0 ) {
+                    const T *x1 = data + size_t(t) * nc;
+
+                    energyRow( e, &D.energySum[0], x1 - nc, x1, x1 + nc, nc );
+                }
+                else {
+                    // Before the stream, x[-1] = x[0]
+                    int t0m = (t - 1 < -D.tailScans ? t : t - 1);
+
+                    for( int c = 0; c < nc; ++c ) {
+
+                        float   x0 = sampleAt( tailEnd, data, nc, t0m, c ),
+                                x1 = sampleAt( tailEnd, data, nc, t, c ),
+                                x2 = sampleAt( tailEnd, data, nc, t + 1, c );
+
+                        e[c] = x1 * x1 - x0 * x2;
+                        D.energySum[c] += e[c];
+                    }
+                }
+            }
+
+            K.crossMaskF( &D.energy[0], nt, nc, &D.hiF[0], &D.loF[0], &D.mask[0], words );
+            D.energyCount += nt;
+        }
+        else if constexpr( std::is_same<T,float>::value )
+            K.crossMaskF( data + size_t(t0) * nc, nt, nc, &D.hiF[0], &D.loF[0], &D.mask[0], words );
+        else
+            K.crossMask16( data + size_t(t0) * nc, nt, nc, &D.hi16[0], &D.lo16[0], &D.mask[0], words );
+
+        for( int it = 0; it < nt; ++it ) {
+
+            const uint64_t  *row    = &D.mask[size_t(it) * words];
+            int             s       = t0 + it;
+            int64_t         scan    = firstScan + s;
+
+            for( int w = 0; w < words; ++w ) {
+
+                for( uint64_t bits = row[w]; bits; bits &= bits - 1 ) {
+
+                    int c = 64 * w + lowestBit64( bits );
+
+                    if( scan < D.nextScan[c] )
+                        continue;
+
+                    D.nextScan[c] = scan + D.refractory;
+
+                    // Waveform, as far as the tail and block go
+
+                    SpikeHit    h;
+
+                    h.scan  = scan;
+                    h.chan  = c;
+                    h.first = std::max( 0, H - s - D.tailScans );
+                    h.last  = std::min( W, ntpts - s + H );
+
+                    bool                done    = (h.last == W);
+                    std::vector<float>  &wv     = (done ? D.rawWaves : D.heldWaves);
+                    size_t              at      = wv.size();
+
+                    wv.resize( at + W, 0 );
+                    fillWave( &wv[at], tailEnd, data, nc, c, s, H, h.first, h.last );
+                    (done ? D.raw : D.held).push_back( h );
+                }
+            }
+        }
+
+        // Energy mean: fold in the tile just ended, if it is whole
+        // or the first since a restart, for the next tile's bounds.
+
+        if( Policy::energy && (firstScan + t0 + nt) % tile == 0 ) {
+
+            double  alpha = std::min( 1.0, double(D.energyCount) / D.energyWindow );
+
+            for( int c = 0; c < nc; ++c ) {
+
+                double  m = D.energySum[c] / D.energyCount;
+
+                if( isnan( D.energyMean[c] ) )
+                    D.energyMean[c] = m;
+                else
+                    D.energyMean[c] += alpha * (m - D.energyMean[c]);
+
+                D.energySum[c] = 0;
+            }
+
+            D.energyCount = 0;
+            setBounds();
+        }
+    }
+
+    D.keepTail( data, ntpts );
+    D.streamEnd = firstScan + ntpts;
+
+    // Every spike before (known) is out of the held list
+    D.passOn( D.streamEnd - std::max( H, 1 ), false );
+}
+
+
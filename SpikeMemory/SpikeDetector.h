@@ -0,0 +1,218 @@
+#ifndef SPIKEDETECTOR_H
+#define SPIKEDETECTOR_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include <algorithm>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+enum DetectMode {
+    detect_absolute = 0,    // |x - mean| > threshold
+    detect_rms,             // |x - mean| > threshold * rms
+    detect_neo              // x[n]^2 - x[n-1]x[n+1] > threshold * mean
+};
+
+// A threshold crossing: absolute scan number and channel, and its
+// waveform: the 2*halfWidth samples from scan - halfWidth, of which
+// [first, last) are held (the rest fell across a gap or the stream's
+// start or end).
+//
+struct SpikeHit {
+    int64_t scan;
+    int     chan,
+            first,
+            last;
+};
+
+/* ---------------------------------------------------------------- */
+/* SpikeDetector -------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Streaming threshold-crossing spike detector for one probe.
+//
+// Each block is scanned in time order, a tile of scans at a time:
+// the crossing-mask kernel (DspKernels) compares each scan against
+// all channels' bounds at once, then set bits are taken in time
+// order. After a crossing, a channel is refractory for (refractory)
+// scans.
+//
+// Blocks are one stream, numbered by absolute scan. The refractory
+// runs on across block edges, and the last few scans of each block
+// are kept (as float) for the next one's early waveforms. A spike
+// too near a block's end to finish its waveform is held, and handed
+// out with the block that completes it. So hits, and waveforms, are
+// the same at any block length. A block that does not start where
+// the last ended is a gap: held spikes go out cut short and the
+// stream starts over.
+//
+// The loop is one template over a threshold policy, the channel
+// count and the sample type, instantiated at compile time and picked
+// once by configure(). A policy gives each channel's bounds, and may
+// detect on an energy signal rather than the samples:
+//
+//  - Absolute: mean +- threshold;
+//  - RmsScaled: mean +- threshold * rms;
+//  - Neo: the nonlinear energy operator, above threshold times its
+//    running mean (kept here). The mean is an exponential average
+//    with a time constant of (energyWindow) scans, updated every 64
+//    scans of the stream (counted from scan 0, not from the block),
+//    so it too is the same at any block length; nothing crosses
+//    until the first update. A scan's energy needs the next
+//    scan, so a block's last scan is tested with the next block.
+//
+// Optionally, spikes are deduplicated: one unit crosses on many
+// nearby sites at once, so a spike is kept only if it is the largest
+// among those on neighboring sites (a precomputed table, from site
+// positions) within a time window. That delays each spike by the
+// window.
+//
+// A new policy is a struct with those members (SpikeDetector.cpp)
+// and a case in configure(). Counts of 384 and 385 (Neuropixels AP
+// streams without and with SY) get their own instances; any other
+// count uses the general one.
+//
+class SpikeDetector
+{
+public:
+    // Per-block inputs, per channel where arrays.
+    struct Input {
+        const double    *mean,
+                        *rms;
+        double          threshold;
+    };
+
+private:
+    typedef void (*Fn16)(
+        SpikeDetector   &D,
+        const short     *data,
+        int             ntpts,
+        int64_t         firstScan,
+        const Input     &in );
+    typedef void (*FnF)(
+        SpikeDetector   &D,
+        const float     *data,
+        int             ntpts,
+        int64_t         firstScan,
+        const Input     &in );
+
+    Fn16                    fn16;
+    FnF                     fnF;
+    DetectMode              mode;
+    int                     nchans,
+                            refractory,
+                            halfWidth,
+                            tailScans,  // scans held in tail
+                            dedupWindow,
+                            energyWindow,
+                            energyCount;// Neo: scans in energySum
+    int64_t                 streamEnd;  // scan after tail; -1 = none
+    std::vector<double>     energyMean, // Neo: per channel
+                            energySum;  // Neo: this epoch, per channel
+    std::vector<float>      energy,     // Neo: one tile
+                            hiF, loF,
+                            tail,       // last scans of the stream
+                            waves,      // hits' waveforms
+                            heldWaves,
+                            rawWaves,
+                            candWaves,
+                            candAmp;
+    std::vector<short>      hi16, lo16;
+    std::vector<uint64_t>   mask;
+    std::vector<int64_t>    nextScan;
+    std::vector<int>        nbrStart,   // chan's neighbors: nbrList
+                            nbrList;    // [nbrStart[c], nbrStart[c+1])
+    std::vector<char>       isNbr;
+    std::vector<SpikeHit>   vHit,
+                            held,       // waveforms incomplete
+                            raw,        // new, before deduplication
+                            cand;       // deduplication candidates
+    size_t                  nDecided;   // cand: decided
+
+public:
+    SpikeDetector()
+    :   fn16(0), fnF(0), mode(detect_absolute), nchans(0),
+        refractory(0), halfWidth(0), tailScans(0), dedupWindow(0),
+        energyWindow(1), energyCount(0), streamEnd(-1), nDecided(0)  {}
+
+    // Choose the policy and channel count, and start the stream over,
+    // dropping held spikes and any baseline the policy keeps.
+    // (refractory) and (halfWidth) are in scans.
+    void configure(
+        DetectMode  mode,
+        int         nchans,
+        int         refractory,
+        int         halfWidth );
+
+    DetectMode detectMode() const   {return mode;}
+
+    // Neighbors for deduplication: other sites on the same shank
+    // (>= 0) within (radius) of each channel's (x, z).
+    void setNeighbors(
+        const std::vector<int>      &shank,
+        const std::vector<float>    &x,
+        const std::vector<float>    &z,
+        float                       radius );
+
+    // Deduplicate within (window) scans either side; 0 = off.
+    void setDedup( int window )     {dedupWindow = std::max( window, 0 );}
+
+    // Neo: time constant of the energy mean, in scans.
+    void setEnergyWindow( int scans )   {energyWindow = std::max( scans, 1 );}
+
+    // Detect in (ntpts) interleaved scans, stride (nchans) as
+    // configured, the first being scan (firstScan) of the stream.
+    // Replaces hits() with the spikes whose waveforms are complete
+    // (or cut short by a gap), in time order.
+    void detect(
+        const short *data,
+        int         ntpts,
+        int64_t     firstScan,
+        const Input &in )
+        {if( fn16 ) fn16( *this, data, ntpts, firstScan, in );}
+    void detect(
+        const float *data,
+        int         ntpts,
+        int64_t     firstScan,
+        const Input &in )
+        {if( fnF ) fnF( *this, data, ntpts, firstScan, in );}
+
+    // End of stream: replaces hits() with the held spikes, their
+    // waveforms cut short, and starts the stream over.
+    void flush();
+
+    const std::vector<SpikeHit> &hits() const  {return vHit;}
+
+    // Hit (k)'s 2*halfWidth waveform samples, from scan - halfWidth.
+    const float *waveform( int k ) const
+        {return waves.data() + size_t(k) * 2 * halfWidth;}
+
+    int waveformHalfWidth() const   {return halfWidth;}
+
+private:
+    void restart();
+    void passOn( int64_t known, bool final );
+    template<typename T>
+    void keepTail( const T *data, int ntpts );
+    template<class Policy, int NCH, typename T>
+    static void detectT(
+        SpikeDetector   &D,
+        const T         *data,
+        int             ntpts,
+        int64_t         firstScan,
+        const Input     &in );
+    template<class Policy>
+    void pick();
+};
+
+#endif  // SPIKEDETECTOR_H
+
+
@@ -12,12 +12,27 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    AcqThread.cpp \
+    BatchReprocess.cpp \
     Biquad.cpp \
+    BiquadBank.cpp \
+    BiquadSimd.cpp \
+    ChannelMixer.cpp \
     Comm.cpp \
+    CpuDispatch.cpp \
+    DataSource.cpp \
+    DspKernels.cpp \
+    FetchCursor.cpp \
+    LfpDecimator.cpp \
     NetClient.cpp \
+    Referencer.cpp \
     SglxApi.cpp \
+    SampleRing.cpp \
     SglxCppClient.cpp \
+    SglxFile.cpp \
     Socket.cpp \
+    SpikeDetector.cpp \
+    WaveformRing.cpp \
     main.cpp \
     controlwindow.cpp \
     qcustomplot.cpp \
@@ -27,12 +42,27 @@ SOURCES += \
     waveformwindow.cpp
 
 HEADERS += \
+    AcqThread.h \
+    BatchReprocess.h \
     Biquad.h \
+    BiquadBank.h \
+    BiquadSimd.h \
+    ChannelMixer.h \
     Comm.h \
+    CpuDispatch.h \
+    DataSource.h \
+    DspKernels.h \
+    FetchCursor.h \
+    LfpDecimator.h \
     NetClient.h \
+    Referencer.h \
     SglxApi.h \
+    SampleRing.h \
     SglxCppClient.h \
+    SglxFile.h \
     Socket.h \
+    SpikeDetector.h \
+    WaveformRing.h \
     controlwindow.h \
     qcustomplot.h \
     rasterwindow.h \
@@ -0,0 +1,91 @@
+
+#include "WaveformRing.h"
+
+#include <string.h>
+
+
+
+
+WaveformRing::WaveformRing( int nchans, int depth, int width )
+    :   buf(size_t(nchans) * depth * width), vS(size_t(nchans) * depth),
+        nPut(new std::atomic<t_ull>[nchans]),
+        seq(new std::atomic<unsigned>[nchans]),
+        nchans(nchans), depth(depth), width(width)
+{
+    for( int c = 0; c < nchans; ++c ) {
+        nPut[c].store( 0, std::memory_order_relaxed );
+        seq[c].store( 0, std::memory_order_relaxed );
+    }
+}
+
+
+void WaveformRing::put(
+    int         c,
+    const float *w,
+    int         first,
+    int         last,
+    double      baseline )
+{
+    unsigned    s   = seq[c].load( std::memory_order_relaxed );
+    t_ull       n   = nPut[c].load( std::memory_order_relaxed );
+    size_t      k   = size_t(c) * depth + n % depth;
+    float       *dst = &buf[k * width];
+
+    seq[c].store( s + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+
+    for( int j = 0; j < width; ++j )
+        dst[j] = (j >= first && j < last ? float(w[j] - baseline) : 0);
+
+    vS[k].first = first;
+    vS[k].last  = last;
+    nPut[c].store( n + 1, std::memory_order_relaxed );
+
+    seq[c].store( s + 2, std::memory_order_release );
+}
+
+
+// A few tries: the writer holds a channel for only a waveform's copy,
+// so failing them all means it's writing that channel nonstop, and
+// the next refresh will do.
+//
+bool WaveformRing::next(
+    int     c,
+    t_ull   &seen,
+    float   *w,
+    int     &first,
+    int     &last ) const
+{
+    for( int tries = 0; tries < 4; ++tries ) {
+
+        unsigned    s0 = seq[c].load( std::memory_order_acquire );
+
+        if( s0 & 1 )
+            continue;
+
+        t_ull   n = nPut[c].load( std::memory_order_relaxed );
+
+        if( n == seen )
+            return false;
+
+        // Older than the last (depth): overwritten, skip to the oldest held
+
+        t_ull   i = (n - seen > t_ull(depth) ? n - depth : seen);
+        size_t  k = size_t(c) * depth + i % depth;
+
+        memcpy( w, &buf[k * width], width * sizeof(float) );
+        first   = vS[k].first;
+        last    = vS[k].last;
+
+        std::atomic_thread_fence( std::memory_order_acquire );
+
+        if( seq[c].load( std::memory_order_relaxed ) == s0 ) {
+            seen = i + 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
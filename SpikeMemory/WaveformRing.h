@@ -0,0 +1,73 @@
+#ifndef WAVEFORMRING_H
+#define WAVEFORMRING_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include "SglxApi.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/* ---------------------------------------------------------------- */
+/* WaveformRing --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Each channel's last (depth) spike waveforms for one probe, written
+// by the detecting side and read by a display.
+//
+// All storage is allocated once, up front: a waveform is (width)
+// float samples, baseline subtracted, of which [first, last) hold
+// data (the rest fell across a gap). Sample j is at j - width/2
+// scans from the spike.
+//
+// One writer, any number of readers, and neither side locks. Each
+// channel has a sequence count, odd while the writer is storing. A
+// reader copies a waveform out, then checks the count didn't move;
+// if it did the copy may be torn, and the reader tries again.
+//
+class WaveformRing
+{
+private:
+    struct Slot {
+        int first,
+            last;
+    };
+
+    std::vector<float>          buf;    // [chan][depth][width]
+    std::vector<Slot>           vS;     // [chan][depth]
+    std::unique_ptr<std::atomic<t_ull>[]>
+                                nPut;   // per chan
+    std::unique_ptr<std::atomic<unsigned>[]>
+                                seq;    // per chan
+    int                         nchans,
+                                depth,
+                                width;
+
+public:
+    WaveformRing( int nchans, int depth, int width );
+
+    int nChans() const  {return nchans;}
+    int wfWidth() const {return width;}
+
+    // Writer side ---------------------------------------------------
+
+    // Store channel (c)'s newest waveform: samples [first, last) of
+    // (w), less (baseline).
+    void put( int c, const float *w, int first, int last, double baseline );
+
+    // Reader side ---------------------------------------------------
+
+    // If channel (c) has had a waveform since the (seen)th, copy the
+    // oldest of those still held (the last depth) to (w)[width], set
+    // [first, last), advance (seen) past it, and return true; call
+    // again for the next. Otherwise, or if the writer keeps getting
+    // in the way, return false.
+    bool next( int c, t_ull &seen, float *w, int &first, int &last ) const;
+};
+
+#endif  // WAVEFORMRING_H
+
+
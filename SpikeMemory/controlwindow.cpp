@@ -1,6 +1,11 @@
 #include "controlwindow.h"
 #include "ui_controlwindow.h"
 
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QMessageBox>
+#include <QTimer>
+
 ControlWindow::ControlWindow(QWidget *parent)
     : QDialog(parent)
     , ui(new Ui::ControlWindow)
@@ -20,9 +25,22 @@ ControlWindow::ControlWindow(QWidget *parent)
     //connect threshold display slots to our custom slots
     QObject::connect(ui->absolute_threshold_doubleSpinBox, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &ControlWindow::on_absolute_threshold_doubleSpinBox_valueChanged);
     QObject::connect(ui->rms_threshold_doubleSpinBox, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &ControlWindow::on_rms_threshold_doubleSpinBox_valueChanged);
+    QObject::connect(ui->neo_threshold_doubleSpinBox, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &ControlWindow::on_neo_threshold_doubleSpinBox_valueChanged);
+    QObject::connect(ui->dedup_checkBox, &QCheckBox::toggled, this, &ControlWindow::dedup_toggled);
+    QObject::connect(ui->reference_comboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &ControlWindow::reference_mode_changed);
+    QObject::connect(ui->referencePerShank_checkBox, &QCheckBox::toggled, this, &ControlWindow::reference_per_shank_toggled);
+    QObject::connect(ui->float32_checkBox, &QCheckBox::toggled, this, &ControlWindow::float32_toggled);
+    QObject::connect(ui->fixedPoint_checkBox, &QCheckBox::toggled, this, &ControlWindow::fixed_point_toggled);
+    QObject::connect(ui->whiten_comboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &ControlWindow::whiten_mode_changed);
 
     //connect connect button to our custom slot
     QObject::connect(ui->connect_pushButton, &QPushButton::clicked, this, &ControlWindow::connect_button_clicked);
+    QObject::connect(ui->openRecording_pushButton, &QPushButton::clicked, this, &ControlWindow::open_recording_button_clicked);
+
+    //refresh the acquisition health readout once a second
+    QTimer *stats_timer = new QTimer(this);
+    QObject::connect(stats_timer, &QTimer::timeout, this, &ControlWindow::update_acq_stats);
+    stats_timer->start(1000);
 
 }
 
@@ -42,6 +60,14 @@ void ControlWindow::restoreDefaultSettings()
     ui->absolute_threshold_doubleSpinBox->setValue(lastThreshold.toDouble());
     QString lastRMSThreshold = settings.value("lastRMSThreshold", "").toString();
     ui->rms_threshold_doubleSpinBox->setValue(lastRMSThreshold.toDouble());
+    ui->neo_threshold_doubleSpinBox->setValue(settings.value("lastNeoThreshold", 10).toDouble());
+    ui->dedup_checkBox->setChecked(settings.value("lastDedup", false).toBool());
+    ui->parallelFetch_checkBox->setChecked(settings.value("lastParallelFetch", false).toBool());
+    ui->reference_comboBox->setCurrentIndex(settings.value("lastReference", ref_none).toInt());
+    ui->referencePerShank_checkBox->setChecked(settings.value("lastReferencePerShank", false).toBool());
+    ui->float32_checkBox->setChecked(settings.value("lastFloat32", false).toBool());
+    ui->fixedPoint_checkBox->setChecked(settings.value("lastFixedPoint", false).toBool());
+    ui->whiten_comboBox->setCurrentIndex(settings.value("lastWhiten", mix_none).toInt());
 }
 
 void ControlWindow::saveDefaultSettings()
@@ -50,6 +76,14 @@ void ControlWindow::saveDefaultSettings()
     settings.setValue("lastPort", ui->port_lineEdit->text());
     settings.setValue("lastThreshold", ui->absolute_threshold_doubleSpinBox->value());
     settings.setValue("lastRMSThreshold", ui->rms_threshold_doubleSpinBox->value());
+    settings.setValue("lastNeoThreshold", ui->neo_threshold_doubleSpinBox->value());
+    settings.setValue("lastDedup", ui->dedup_checkBox->isChecked());
+    settings.setValue("lastParallelFetch", ui->parallelFetch_checkBox->isChecked());
+    settings.setValue("lastReference", ui->reference_comboBox->currentIndex());
+    settings.setValue("lastReferencePerShank", ui->referencePerShank_checkBox->isChecked());
+    settings.setValue("lastFloat32", ui->float32_checkBox->isChecked());
+    settings.setValue("lastFixedPoint", ui->fixedPoint_checkBox->isChecked());
+    settings.setValue("lastWhiten", ui->whiten_comboBox->currentIndex());
     settings.sync();
 }
 
@@ -146,28 +180,112 @@ void ControlWindow::on_rms_threshold_doubleSpinBox_valueChanged(double arg1)
     spikeVM->queued_rms_threshold_imec = arg1;
 }
 
+void ControlWindow::on_neo_threshold_doubleSpinBox_valueChanged(double arg1)
+{
+    //if spikeGLX is connected, update spikeVM neo_threshold
+    if(!connectionEstablished){
+        return;
+    }
+    spikeVM->queued_neo_threshold_imec = arg1;
+}
+
+void ControlWindow::dedup_toggled(bool checked)
+{
+    //if spikeGLX is connected, update spikeVM spike deduplication
+    if(!connectionEstablished){
+        return;
+    }
+    spikeVM->queued_dedup_spikes = checked;
+}
+
+void ControlWindow::reference_mode_changed(int index)
+{
+    //if spikeGLX is connected, update spikeVM referencing (none, CAR, CMR)
+    if(!connectionEstablished){
+        return;
+    }
+    spikeVM->queued_reference_mode = RefMode(index);
+}
+
+void ControlWindow::reference_per_shank_toggled(bool checked)
+{
+    //if spikeGLX is connected, update spikeVM to reference whole probes or single shanks
+    if(!connectionEstablished){
+        return;
+    }
+    spikeVM->queued_reference_per_shank = checked;
+}
+
+void ControlWindow::float32_toggled(bool checked)
+{
+    //if spikeGLX is connected, switch spikeVM between int16 and float32 processing
+    if(!connectionEstablished){
+        return;
+    }
+    spikeVM->queued_float_pipeline = checked;
+}
+
+void ControlWindow::fixed_point_toggled(bool checked)
+{
+    //if spikeGLX is connected, switch spikeVM's int16 filters between double and fixed-point arithmetic
+    if(!connectionEstablished){
+        return;
+    }
+    spikeVM->queued_fixed_point_filter = checked;
+}
+
+void ControlWindow::whiten_mode_changed(int index)
+{
+    //if spikeGLX is connected, update spikeVM whitening (none, ZCA, local)
+    if(!connectionEstablished){
+        return;
+    }
+    spikeVM->queued_mix_mode = MixMode(index);
+}
+
+void ControlWindow::attachSpikeVM(const QString &status)
+{
+    //spikeVM has just been created and is connected; bring up the child windows and show it as connected
+    initializeChildWindows();
+    connectionEstablished = true;
+    //change the button text to "disconnect"
+    ui->connect_pushButton->setText("Disconnect");
+    ui->openRecording_pushButton->setEnabled(false);
+    //change the status label text to green, with the source description
+    ui->connection_status_label->setStyleSheet("QLabel { color : green; }");
+    ui->connection_status_label->setText(status);
+    spikeVM->queued_absolute_threshold_imec = ui->absolute_threshold_doubleSpinBox->value();
+    spikeVM->queued_rms_threshold_imec = ui->rms_threshold_doubleSpinBox->value();
+    spikeVM->queued_neo_threshold_imec = ui->neo_threshold_doubleSpinBox->value();
+    if(ui->neo_threshold_radioButton->isChecked()){
+        spikeVM->queued_detect_mode = detect_neo;
+    }
+    else if(ui->rms_threshold_radioButton->isChecked()){
+        spikeVM->queued_detect_mode = detect_rms;
+    }
+    else{
+        spikeVM->queued_detect_mode = detect_absolute;
+    }
+    spikeVM->queued_dedup_spikes = ui->dedup_checkBox->isChecked();
+    spikeVM->queued_reference_mode = RefMode(ui->reference_comboBox->currentIndex());
+    spikeVM->queued_reference_per_shank = ui->referencePerShank_checkBox->isChecked();
+    spikeVM->queued_float_pipeline = ui->float32_checkBox->isChecked();
+    spikeVM->queued_fixed_point_filter = ui->fixedPoint_checkBox->isChecked();
+    spikeVM->queued_mix_mode = MixMode(ui->whiten_comboBox->currentIndex());
+}
+
 void ControlWindow::connect_button_clicked()
 {
 
     if(!connectionEstablished){//establish connection to spikeGLX with current parameters
         //create spikevm
-        spikeVM = new SpikeVM(this, ui->ip_lineEdit->text().toStdString().c_str(), ui->port_lineEdit->text().toInt());
-        if(spikeVM->establishConnection()){
-            initializeChildWindows();
-            connectionEstablished = true;
-            //change the button text to "disconnect"
-            ui->connect_pushButton->setText("Disconnect");
-            //change the status label text to green, with the ip/port
-            ui->connection_status_label->setStyleSheet("QLabel { color : green; }");
-            ui->connection_status_label->setText("SpikeGLX connected at:\n" + ui->ip_lineEdit->text() + ":" + ui->port_lineEdit->text());
-            spikeVM->queued_absolute_threshold_imec = ui->absolute_threshold_doubleSpinBox->value();
-            spikeVM->queued_rms_threshold_imec = ui->rms_threshold_doubleSpinBox->value();
-            spikeVM->queued_RMS_based_spike_detection = ui->rms_threshold_radioButton->isChecked();
-        }
-        else{
+        spikeVM = new SpikeVM(this, ui->ip_lineEdit->text().toStdString().c_str(), ui->port_lineEdit->text().toInt(), ui->parallelFetch_checkBox->isChecked());
+        if(!spikeVM->connected){
             //delete this spikeVM so we can try again, e.g., possibly with a new address
             delete spikeVM;
+            return;
         }
+        attachSpikeVM("SpikeGLX connected at:\n" + ui->ip_lineEdit->text() + ":" + ui->port_lineEdit->text());
     }
     else{
         //Double check that the user wants to disconnect
@@ -184,6 +302,7 @@ void ControlWindow::connect_button_clicked()
             connectionEstablished = false;
             //change the button text to "connect"
             ui->connect_pushButton->setText("Connect");
+            ui->openRecording_pushButton->setEnabled(true);
             //change the status label text to red
             ui->connection_status_label->setStyleSheet("QLabel { color : red; }");
             ui->connection_status_label->setText("SpikeGLX Not Connected");
@@ -191,6 +310,70 @@ void ControlWindow::connect_button_clicked()
     }
 }
 
+void ControlWindow::open_recording_button_clicked()
+{
+    //Process recorded SpikeGLX files instead of a live connection, as fast as they can be read and processed.
+    if(connectionEstablished){
+        return;
+    }
+    QStringList files = QFileDialog::getOpenFileNames(this, "Open SpikeGLX Recording", settings.value("lastRecordingDir", "").toString(), "SpikeGLX binary (*.ap.bin *.nidq.bin)");
+    if(files.isEmpty()){
+        return;
+    }
+    settings.setValue("lastRecordingDir", QFileInfo(files[0]).absolutePath());
+
+    std::vector<std::string> paths;
+    for(int file_ind = 0; file_ind < files.size(); file_ind++){
+        paths.push_back(files[file_ind].toStdString());
+    }
+    FileSource *source = new FileSource(paths);
+    spikeVM = new SpikeVM(this, source);
+    if(!spikeVM->connected){
+        QMessageBox::warning(this, "Open Recording", QString("Couldn't open recording:\n") + source->error().c_str());
+        //the spikeVM owns the source; delete both so another recording can be tried
+        delete spikeVM;
+        return;
+    }
+    attachSpikeVM("Replaying recording:\n" + QFileInfo(files[0]).fileName());
+}
+
+void ControlWindow::update_acq_stats()
+{
+    //Show whether SpikeMemory is keeping up: the worst lag over all streams, and the scans lost in gaps so far.
+    //Lost scans mean missing data that came from falling behind (or the link), not from the biology. The tooltip breaks it down per stream.
+    if(!connectionEstablished){
+        ui->acqStats_label->clear();
+        ui->acqStats_label->setToolTip("");
+        return;
+    }
+    std::vector<AcqStats*> stats = spikeVM->imec_stats;
+    QStringList names;
+    for(int probe_ind = 0; probe_ind < stats.size(); probe_ind++){
+        names << QString("imec%1").arg(probe_ind);
+    }
+    if(spikeVM->ni_stats){
+        stats.push_back(spikeVM->ni_stats);
+        names << "nidq";
+    }
+
+    double max_lag_ms = 0;
+    t_ull skipped = 0, gaps = 0;
+    QStringList details;
+    for(int stream_ind = 0; stream_ind < stats.size(); stream_ind++){
+        const AcqStats *st = stats[stream_ind];
+        max_lag_ms = std::max(max_lag_ms, st->lagMS());
+        skipped += st->skipped;
+        gaps += st->gaps;
+        details << QString("%1: lag %2 scans (%3 ms), %4 scans skipped in %5 gaps, ring full %6x")
+                   .arg(names[stream_ind]).arg(st->lagScans()).arg(st->lagMS(), 0, 'f', 0)
+                   .arg(st->skipped.load()).arg(st->gaps.load()).arg(st->ringFull.load());
+    }
+
+    ui->acqStats_label->setStyleSheet(skipped ? "QLabel { color : red; }" : "");
+    ui->acqStats_label->setText(QString("Lag %1 ms\nSkipped %2 scans (%3 gaps)").arg(max_lag_ms, 0, 'f', 0).arg(skipped).arg(gaps));
+    ui->acqStats_label->setToolTip(details.join("\n"));
+}
+
 void ControlWindow::on_restoreDefaults_pushButton_clicked()
 {
     //restore default settings in the ui
@@ -211,7 +394,7 @@ void ControlWindow::on_absolute_threshold_radioButton_clicked()
     if(!connectionEstablished){
         return;
     }
-    spikeVM->queued_RMS_based_spike_detection = false;
+    spikeVM->queued_detect_mode = detect_absolute;
 }
 
 
@@ -221,6 +404,16 @@ void ControlWindow::on_rms_threshold_radioButton_clicked()
     if(!connectionEstablished){
         return;
     }
-    spikeVM->queued_RMS_based_spike_detection = true;
+    spikeVM->queued_detect_mode = detect_rms;
+}
+
+
+void ControlWindow::on_neo_threshold_radioButton_clicked()
+{
+    //if spikeGLX is connected, update spikeVM to use the nonlinear energy threshold
+    if(!connectionEstablished){
+        return;
+    }
+    spikeVM->queued_detect_mode = detect_neo;
 }
 
@@ -37,8 +37,23 @@ private slots:
 
     void on_rms_threshold_doubleSpinBox_valueChanged(double arg1);
 
+    void on_neo_threshold_doubleSpinBox_valueChanged(double arg1);
+
+    void dedup_toggled(bool checked);
+
+    void reference_mode_changed(int index);
+
+    void reference_per_shank_toggled(bool checked);
+
+    void float32_toggled(bool checked);
+    void fixed_point_toggled(bool checked);
+
+    void whiten_mode_changed(int index);
+
     void connect_button_clicked();
 
+    void open_recording_button_clicked();
+
     void on_restoreDefaults_pushButton_clicked();
 
     void on_saveDefaults_pushButton_clicked();
@@ -47,8 +62,13 @@ private slots:
 
     void on_rms_threshold_radioButton_clicked();
 
+    void on_neo_threshold_radioButton_clicked();
+
+    void update_acq_stats();
+
 private:
     void initializeChildWindows();
+    void attachSpikeVM(const QString &status);
     void restoreDefaultSettings();
     void saveDefaultSettings();
     bool connectionEstablished = false;
@@ -1,9 +1,112 @@
 #include "controlwindow.h"
+#include "BatchReprocess.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+
+#include <string.h>
+
+//Offline batch mode: reprocess recorded SpikeGLX files into spike/event logs as fast as the cores allow, then exit. No windows are shown.
+//Usage: SpikeMemory --batch <out_dir> [--shard s] [--warmup s] [--abs x | --rms x | --neo x] [--dedup] [--threads n] [--ref none|car|cmr [--per-shank]] [--whiten none|zca|local] [--float32] [--fixed-point] <file.ap.bin> ... [<file.nidq.bin>]
+static int runBatch(QCoreApplication &app)
+{
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "SpikeGLX .ap.bin and .nidq.bin files of one recording (each with its .meta).");
+    QCommandLineOption batchOption("batch", "Write spikes.csv and events.csv to <dir>.", "dir");
+    QCommandLineOption shardOption("shard", "Seconds of recording per shard (default 60).", "s", "60");
+    QCommandLineOption warmupOption("warmup", "Seconds processed ahead of each shard to settle the filters and baselines (default 3).", "s", "3");
+    QCommandLineOption absOption("abs", "Absolute spike threshold (default 20).", "x", "20");
+    QCommandLineOption rmsOption("rms", "Use RMS-based spike detection with this threshold.", "x");
+    QCommandLineOption neoOption("neo", "Use nonlinear energy (NEO) spike detection with this multiple of the mean energy.", "x");
+    QCommandLineOption dedupOption("dedup", "Log only the largest of the spikes on nearby sites within 0.5 ms.");
+    QCommandLineOption threadsOption("threads", "Worker threads (default: one per core).", "n", "0");
+    QCommandLineOption refOption("ref", "Common-mode referencing before detection: none, car or cmr (default none).", "mode", "none");
+    QCommandLineOption perShankOption("per-shank", "Reference each shank separately.");
+    QCommandLineOption whitenOption("whiten", "Whitening before detection: none, zca or local (default none). Estimated once from the first second of the recording and used by every shard.", "mode", "none");
+    QCommandLineOption float32Option("float32", "Filter, reference and detect in float32 instead of int16.");
+    QCommandLineOption fixedPointOption("fixed-point", "Filter int16 data in fixed-point integer arithmetic instead of double.");
+    parser.addOptions({batchOption, shardOption, warmupOption, absOption, rmsOption, neoOption, dedupOption, threadsOption, refOption, perShankOption, whitenOption, float32Option, fixedPointOption});
+    parser.process(app);
+
+    std::vector<std::string> paths;
+    for(const QString &file : parser.positionalArguments()){
+        paths.push_back(file.toStdString());
+    }
+
+    BatchParams params;
+    params.shardSec = parser.value(shardOption).toDouble();
+    params.warmupSec = parser.value(warmupOption).toDouble();
+    params.absThresh = parser.value(absOption).toDouble();
+    if(parser.isSet(neoOption)){
+        params.detectMode = detect_neo;
+        params.neoThresh = parser.value(neoOption).toDouble();
+    }
+    else if(parser.isSet(rmsOption)){
+        params.detectMode = detect_rms;
+        params.rmsThresh = parser.value(rmsOption).toDouble();
+    }
+    params.dedup = parser.isSet(dedupOption);
+    params.nThreads = parser.value(threadsOption).toInt();
+    QString ref = parser.value(refOption).toLower();
+    if(ref == "car"){
+        params.refMode = ref_car;
+    }
+    else if(ref == "cmr"){
+        params.refMode = ref_cmr;
+    }
+    else if(ref != "none"){
+        fprintf(stderr, "Unknown --ref mode %s\n", qPrintable(ref));
+        return 1;
+    }
+    params.refPerShank = parser.isSet(perShankOption);
+    QString whiten = parser.value(whitenOption).toLower();
+    if(whiten == "zca"){
+        params.mixMode = mix_zca;
+    }
+    else if(whiten == "local"){
+        params.mixMode = mix_local;
+    }
+    else if(whiten != "none"){
+        fprintf(stderr, "Unknown --whiten mode %s\n", qPrintable(whiten));
+        return 1;
+    }
+    params.float32 = parser.isSet(float32Option);
+    params.fixedPoint = parser.isSet(fixedPointOption);
+
+    QDir outDir(parser.value(batchOption));
+    if(!outDir.mkpath(".")){
+        fprintf(stderr, "Can't create %s\n", qPrintable(outDir.path()));
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    BatchReprocess batch(paths, params);
+    if(!batch.run()){
+        fprintf(stderr, "Batch failed: %s\n", batch.error().c_str());
+        return 1;
+    }
+    if(!batch.writeSpikes(outDir.filePath("spikes.csv").toStdString()) || !batch.writeEvents(outDir.filePath("events.csv").toStdString())){
+        fprintf(stderr, "Can't write logs in %s\n", qPrintable(outDir.path()));
+        return 1;
+    }
+    printf("%zu spikes, %zu events in %.1f s\n", batch.spikes.size(), batch.events.size(), timer.elapsed() / 1000.0);
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
+    //Batch mode needs no display, so decide before creating the GUI application.
+    for(int arg_ind = 1; arg_ind < argc; arg_ind++){
+        if(!strcmp(argv[arg_ind], "--batch") || !strncmp(argv[arg_ind], "--batch=", 8)){
+            QCoreApplication a(argc, argv);
+            return runBatch(a);
+        }
+    }
+
     QApplication a(argc, argv);
     ControlWindow w;
     w.show();
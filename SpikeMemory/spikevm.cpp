@@ -1,67 +1,112 @@
 #include "spikevm.h"
 #include "SglxCppClient.h"
 #include "SglxApi.h"
+#include "BiquadBank.h"
+#include "DspKernels.h"
+#include "Referencer.h"
 #include <QTimer>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <chrono>
 #include <thread>
 #include <QDebug>
 #include <QTimer>
+#include <QThread>
 #include <queue>
 
-SpikeVM::SpikeVM(QObject *parent, const char* myhost, const int port)
-    : QObject(parent), myhost(myhost), port(port)
+SpikeVM::SpikeVM(QObject *parent, const char* myhost, const int port, bool parallel_fetch)
+    : SpikeVM(parent, new SglxSource(myhost, port), parallel_fetch)
 {
-    establishConnection();
+}
+
+SpikeVM::SpikeVM(QObject *parent, DataSource *source, bool parallel_fetch, bool realtime)
+    : QObject(parent), source(source), parallel_fetch(parallel_fetch), realtime(realtime || source->isLive())
+{
+    if(!establishConnection()){
+        return;
+    }
     initializeFetchContainers();
     updateParameters();
-    updateDataBuffers();
-    updateBaselineStats_imec();
-    updateBaselineStats_ni();
-    filterData();
-    detectSpikes();
-    detectEvents();
-    updateEventContents();
+    startAcquisition();
+    if(!this->realtime){
+        return;
+    }
     QTimer *timer = new QTimer(this);
     connect(timer, &QTimer::timeout, this, QOverload<>::of(&SpikeVM::runCycle));
 
-    timer->start(50);
+    //Recorded data are always waiting, so process whenever the event loop is otherwise idle.
+    timer->start(source->isLive() ? 50 : 0);
+}
+
+SpikeVM::~SpikeVM()
+{
+    //Stop the acquisition threads before tearing down the rings and the source they use.
+    for(int thread_ind = 0; thread_ind < acq_threads.size(); thread_ind++){
+        delete acq_threads[thread_ind];
+    }
+    delete batch_worker;
+    for(int probe_ind = 0; probe_ind < imec_rings.size(); probe_ind++){
+        delete imec_rings[probe_ind];
+    }
+    delete ni_ring;
+    for(int probe_ind = 0; probe_ind < imec_stats.size(); probe_ind++){
+        delete imec_stats[probe_ind];
+    }
+    delete ni_stats;
+    for(int probe_ind = 0; probe_ind < imec_filters.size(); probe_ind++){
+        delete imec_filters[probe_ind];
+    }
+    delete filter_pool;
+    for(int probe_ind = 0; probe_ind < imec_referencers.size(); probe_ind++){
+        delete imec_referencers[probe_ind];
+    }
+    for(int probe_ind = 0; probe_ind < lfp_decimators.size(); probe_ind++){
+        delete lfp_decimators[probe_ind];
+    }
+    for(int probe_ind = 0; probe_ind < imec_mixers.size(); probe_ind++){
+        delete imec_mixers[probe_ind];
+    }
+    for(int probe_ind = 0; probe_ind < imec_detectors.size(); probe_ind++){
+        delete imec_detectors[probe_ind];
+    }
+    for(int probe_ind = 0; probe_ind < waveform_rings.size(); probe_ind++){
+        delete waveform_rings[probe_ind];
+    }
+    delete source;
 }
 
 bool SpikeVM::establishConnection()
 {
-    hSglx = sglx_createHandle_std();
-    if( sglx_connect( hSglx, myhost, port ) ) {
-//        lastMaxReadableScanNum = sglx_getStreamSampleCount(hSglx, 2, 0);
-//        bufScanNumEnd = lastMaxReadableScanNum;
-        sampleRate_imec = sglx_getStreamSampleRate(hSglx, 2, 0);
-        sampleRate_ni = sglx_getStreamSampleRate(hSglx, 0, 0);
+    //Called by the constructor, which stops here on failure. Callers check connected instead of calling again: a later success would leave this SpikeVM without fetch containers or acquisition threads.
+    if(connected){
+        return true;
+    }
+    if(source->open()) {
+        sampleRate_imec = source->sampleRate(2, 0);
+        sampleRate_ni = source->sampleRate(0, 0);
         //        ui->map_display->xAxis->setRange(0, (2 * sampleRate / refreshRate));
+        connected = true;
         return true;
     }
     else {
-        printf( "couldn't connect" );
+        qDebug() << "couldn't connect: " << source->error().c_str();
         return false;
     }
 }
 
 void SpikeVM::initializeFetchContainers()
 {
-    cppClient_sglx_get_ints chanCount_container;
-
     //get number of imec probes
-    sglx_getStreamNP(num_probes, hSglx, 2);
+    num_probes = source->nProbes();
     qDebug() << "Initializing fetch containers";
     //for each probe, initialize a fetch container and a data buffer
     for(int probe_ind = 0; probe_ind < num_probes; ++probe_ind){
         imec_fetch_containers.push_back(std::make_shared<cppClient_sglx_fetch>());
-        imec_data_buffers.push_back(std::make_shared<std::vector<short>>());
-        lastMaxReadableScanNum_imec.push_back(sglx_getStreamSampleCount(hSglx, 2, probe_ind));
-        maxReadableScanNum_imec.push_back(lastMaxReadableScanNum_imec[probe_ind]);
-        bufScanNumEnd_imec.push_back(0);
+        imec_blocks.push_back(nullptr);
+        lastMaxReadableScanNum_imec.push_back(0);
+        resetFilters.push_back(true);
         scansToRead_imec.push_back(0);
-        availableScansToRead_imec.push_back(0);
         spike_scan_nums.push_back(std::vector<std::vector<t_ull>>());
         spike_times_ms.push_back(std::vector<std::vector<t_ull>>());
         spike_channels.push_back(std::vector<int>());
@@ -70,8 +115,7 @@ void SpikeVM::initializeFetchContainers()
         baseline_rms_by_channel_imec.push_back(std::vector<double>());
 
         //get number of channels of each type for this probe
-        sglx_getStreamAcqChans(chanCount_container, hSglx, 2, probe_ind);
-        std::vector<int> chanCounts = chanCount_container.vint;
+        std::vector<int> chanCounts = source->acqChanCounts(2, probe_ind);
 
         //set the channel and index fields of the fetch container
         imec_fetch_containers[probe_ind]->js = 2;
@@ -93,31 +137,54 @@ void SpikeVM::initializeFetchContainers()
         //read the channel layout for this probe
         channel_maps.push_back(readGeomMap(probe_ind));
 
-        // initialize waveform vectors
-        waveform_x.push_back(QVector<QVector<double>>());
-        waveform_y.push_back(QVector<QVector<double>>());
-        QVector<double> vector(32, 0);
-        for (int ch = 0; ch < chanCounts[0]; ch++) {
-            waveform_x[probe_ind].push_back(vector);
-            waveform_y[probe_ind].push_back(vector);
+        //initialize the acquisition ring for this probe
+        imec_rings.push_back(new SampleRing(chanCounts[0], std::round(ringSeconds * sampleRate_imec)));
+        imec_stats.push_back(new AcqStats(sampleRate_imec));
+
+        //initialize a filter for this probe: 300-6000 Hz band-pass and line-noise notches, in one pass over the data
+        BiquadBank* this_probe_filter = new BiquadBank;
+        this_probe_filter->setBandNotch(sampleRate_imec, 300, 6000, 60, 3);
+        imec_filters.push_back(this_probe_filter);
+
+        //initialize common-mode referencing and channel mixing for this probe, from its geometry
+        imec_referencers.push_back(new Referencer);
+        std::vector<int> shanks;
+        std::vector<float> site_x, site_z;
+        for(const ChannelGeom &geom : channel_geoms[probe_ind]){
+            shanks.push_back(geom.shank);
+            site_x.push_back(geom.x);
+            site_z.push_back(geom.z);
+        }
+        imec_mixers.push_back(new ChannelMixer);
+        imec_mixers[probe_ind]->setChannels(shanks, site_x, site_z);
+
+        //initialize spike detection for this probe; after a spike a channel is refractory for refractoryMs, and waveforms run waveformHalfMs either side
+        //sites within dedupRadiusUm on the same shank are neighbors, for deduplication; NEO thresholds scale with the energy averaged over neoWindowMs
+        imec_detectors.push_back(new SpikeDetector);
+        imec_detectors[probe_ind]->configure(detect_mode, chanCounts[0], std::round(sampleRate_imec * refractoryMs / 1000 / dsRatio), std::round(sampleRate_imec * waveformHalfMs / 1000 / dsRatio));
+        imec_detectors[probe_ind]->setNeighbors(shanks, site_x, site_z, dedupRadiusUm);
+        imec_detectors[probe_ind]->setEnergyWindow(std::round(sampleRate_imec * neoWindowMs / 1000 / dsRatio));
+        waveform_rings.push_back(new WaveformRing(chanCounts[0], waveformDepth, 2 * imec_detectors[probe_ind]->waveformHalfWidth()));
+
+        imec_float_data.push_back(std::vector<float>());
+
+        //initialize the LFP band for this probe; batch mode writes no LFP, so it doesn't pay for one
+        if(realtime){
+            lfp_decimators.push_back(new LfpDecimator(chanCounts[0], sampleRate_imec, 1000, 1, lfpSeconds));
         }
-
-        //initialize a filter for this probe
-        Biquad* this_probe_biquad = new Biquad( bq_type_highpass, 300/sampleRate_imec, 0, 0);
-        imec_filters.push_back(this_probe_biquad);
     }
+    applyReferenceGroups();
+
+    //Batch shards already run one per core, so they filter on their own thread.
+    filter_pool = new BiquadPool(realtime ? std::max(0, QThread::idealThreadCount() - 1) : 0);
 
-    qDebug() << "Imec containers intialized";
+    qDebug() << "Imec containers intialized; DSP kernels:" << cpuISAName(cpuISA());
 
     //for ni, initialize a fetch container and a data buffer
-    sglx_getStreamAcqChans(chanCount_container, hSglx, 0, 0);
-    ni_chan_counts = chanCount_container.vint;
+    ni_chan_counts = source->acqChanCounts(0, 0);
 
-    lastMaxReadableScanNum_ni = sglx_getStreamSampleCount(hSglx, 0, 0);
-    maxReadableScanNum_ni = lastMaxReadableScanNum_ni;
-    bufScanNumEnd_ni = 0;
+    lastMaxReadableScanNum_ni = 0;
     scansToRead_ni = 0;
-    availableScansToRead_ni = 0;
 
     ni_fetch_container.js = 0;
     ni_fetch_container.ip = 0;
@@ -171,7 +238,12 @@ void SpikeVM::initializeFetchContainers()
         }
     }
 
-    ni_fetch_container.channel_subset = &ni_fetch_container.chans[0];
+    ni_fetch_container.channel_subset = ni_fetch_container.chans.data();
+    //A recording may have no NI stream; then there is nothing to acquire for it.
+    if(ni_fetch_container.n_cs > 0){
+        ni_ring = new SampleRing(ni_fetch_container.n_cs, std::round(ringSeconds * sampleRate_ni));
+        ni_stats = new AcqStats(sampleRate_ni);
+    }
     qDebug() << "Fetch containers intialized";
 
 }
@@ -187,9 +259,7 @@ std::vector<int> SpikeVM::readGeomMap(int probe_ind)
     };
 
     //Get the geomMap for this probe
-    cppClient_sglx_get_strs geomMap_container;
-    sglx_getGeomMap(geomMap_container, hSglx, probe_ind);
-    std::vector<std::string> geomMap = geomMap_container.vstr;
+    std::vector<std::string> geomMap = source->geomMap(probe_ind);
 
     //initialize the channel map for this probe, and populate it with the geomMap
     //the channel map contains the indices of channels (that is, the indices specifying their acquisition order), sorted by their physical location, with the deepest channel first.
@@ -214,6 +284,18 @@ std::vector<int> SpikeVM::readGeomMap(int probe_ind)
         }
     }
 
+    //keep each acquired channel's shank and position; channels missing from the map, or marked unused, get no shank
+    std::vector<ChannelGeom> geoms(imec_fetch_containers[probe_ind]->n_cs);
+    for (const auto& ch : channels) {
+        if (ch.chNumber < 0 || ch.chNumber >= int(geoms.size())) {
+            continue;
+        }
+        geoms[ch.chNumber].shank = ch.u ? ch.s : -1;
+        geoms[ch.chNumber].x = ch.x;
+        geoms[ch.chNumber].z = ch.z;
+    }
+    channel_geoms.push_back(geoms);
+
     // Sort based on z-values primarily and x-values secondarily
     std::sort(channels.begin(), channels.end(), [](const ChannelInfo& a, const ChannelInfo& b) {
         if (a.z == b.z) return a.x < b.x;
@@ -235,114 +317,323 @@ void SpikeVM::updateParameters()
     //This way we can avoid changing the detection parameters in the middle of a cycle.
     absolute_threshold_imec = queued_absolute_threshold_imec;
     rms_threshold_imec = queued_rms_threshold_imec;
-    RMS_based_spike_detection = queued_RMS_based_spike_detection;
+    neo_threshold_imec = queued_neo_threshold_imec;
+    if(detect_mode != queued_detect_mode){
+        detect_mode = queued_detect_mode;
+        for(int probe_ind = 0; probe_ind < imec_detectors.size(); probe_ind++){
+            imec_detectors[probe_ind]->configure(detect_mode, imec_fetch_containers[probe_ind]->n_cs, std::round(sampleRate_imec * refractoryMs / 1000 / dsRatio), std::round(sampleRate_imec * waveformHalfMs / 1000 / dsRatio));
+        }
+    }
+    if(dedup_spikes != queued_dedup_spikes){
+        dedup_spikes = queued_dedup_spikes;
+        for(int probe_ind = 0; probe_ind < imec_detectors.size(); probe_ind++){
+            imec_detectors[probe_ind]->setDedup(dedup_spikes ? std::round(sampleRate_imec * dedupWindowMs / 1000 / dsRatio) : 0);
+        }
+    }
+    //Whitening is estimated on referenced data, so a change to either starts a new estimate.
+    bool remix = mix_mode != queued_mix_mode || (mix_mode != mix_none && (reference_mode != queued_reference_mode || reference_per_shank != queued_reference_per_shank));
+    reference_mode = queued_reference_mode;
+    if(reference_per_shank != queued_reference_per_shank){
+        reference_per_shank = queued_reference_per_shank;
+        applyReferenceGroups();
+    }
+    if(remix){
+        mix_mode = queued_mix_mode;
+        beginMixing();
+    }
+    if(float_pipeline != queued_float_pipeline){
+        //The filters keep separate state for each form, so switching starts them over, as at startup.
+        float_pipeline = queued_float_pipeline;
+        for(int probe_ind = 0; probe_ind < imec_filters.size(); probe_ind++){
+            imec_filters[probe_ind]->clearMem();
+        }
+        resetFilters.assign(resetFilters.size(), true);
+    }
+    if(fixed_point_filter != queued_fixed_point_filter){
+        //As above, the fixed-point form has its own state and starts over.
+        fixed_point_filter = queued_fixed_point_filter;
+        for(int probe_ind = 0; probe_ind < imec_filters.size(); probe_ind++){
+            imec_filters[probe_ind]->setFixedPoint(fixed_point_filter);
+        }
+        resetFilters.assign(resetFilters.size(), true);
+    }
 }
 
-void SpikeVM::updateDataBuffers()
+void SpikeVM::applyReferenceGroups()
 {
-//    qDebug() << "Updating data buffers";
-    auto start = std::chrono::high_resolution_clock::now();
-    t_ull meanScansPerTimerTick = std::round(sampleRate_imec / refreshRate);
-    for(int probe_ind = 0; probe_ind < num_probes; probe_ind++){
+    //Group each probe's channels for referencing: all mapped channels together, or one group per shank.
+    for(int probe_ind = 0; probe_ind < imec_referencers.size(); probe_ind++){
+        std::vector<int> shanks;
+        for(const ChannelGeom &geom : channel_geoms[probe_ind]){
+            shanks.push_back(geom.shank);
+        }
+        imec_referencers[probe_ind]->setGroups(shanks, reference_per_shank);
+    }
+}
 
-        lastMaxReadableScanNum_imec[probe_ind] = maxReadableScanNum_imec[probe_ind];
-        maxReadableScanNum_imec[probe_ind] = sglx_getStreamSampleCount(hSglx, 2, probe_ind);
-        availableScansToRead_imec[probe_ind] = maxReadableScanNum_imec[probe_ind] - lastMaxReadableScanNum_imec[probe_ind];
+void SpikeVM::beginMixing()
+{
+    //Estimate each probe's mixing matrix from every third scan of the next mixEstimateSeconds, or take it from fixed_mix_matrices. With mix_none this just drops the matrices.
+    for(int probe_ind = 0; probe_ind < imec_mixers.size(); probe_ind++){
+        if(mix_mode != mix_none && fixed_mix_matrices.size() == imec_mixers.size()){
+            imec_mixers[probe_ind]->begin(mix_none, 0, 1);
+            imec_mixers[probe_ind]->setMatrix(fixed_mix_matrices[probe_ind]);
+        }
+        else{
+            imec_mixers[probe_ind]->begin(mix_mode, std::round(sampleRate_imec * mixEstimateSeconds / 3), 3);
+        }
+    }
+}
 
+void SpikeVM::startAcquisition()
+{
+    //Hand every stream to the acquisition thread(s). Live streams start from SpikeGLX's current sample count; recordings start at the beginning.
+    //From here on only the acquisition threads read from the source.
+    std::vector<const T_sglx_fetch*> stream_ios;
+    std::vector<SampleRing*> stream_rings;
+    std::vector<AcqStats*> stream_stats;
+    for(int probe_ind = 0; probe_ind < num_probes; probe_ind++){
+        stream_ios.push_back(imec_fetch_containers[probe_ind].get());
+        stream_rings.push_back(imec_rings[probe_ind]);
+        stream_stats.push_back(imec_stats[probe_ind]);
+    }
+    if(ni_ring){
+        stream_ios.push_back(&ni_fetch_container);
+        stream_rings.push_back(ni_ring);
+        stream_stats.push_back(ni_stats);
+    }
 
-        scansToRead_imec[probe_ind] = (t_ull) std::min(availableScansToRead_imec[probe_ind], 5 * meanScansPerTimerTick);
-        if(scansToRead_imec[probe_ind] == 0){
-            continue;
+    int periodMS = std::round(1000 / refreshRate);
+    bool live = source->isLive();
+    //Give each stream its own connection and thread if asked. The round trips then overlap, so a pass takes as long as the slowest stream rather than the sum of all of them.
+    bool own_connections = parallel_fetch && live;
+    std::vector<AcqStream> shared_streams;
+
+    for(int stream_ind = 0; stream_ind < stream_ios.size(); stream_ind++){
+        const T_sglx_fetch *io = stream_ios[stream_ind];
+        AcqStream stream;
+        stream.ring = stream_rings[stream_ind];
+        stream.stats = stream_stats[stream_ind];
+        //Cap each read at 5 timer ticks' worth of this stream's scans, so that recorded streams advance together in time.
+        stream.maxScans = 5 * std::round(source->sampleRate(io->js, io->ip) / refreshRate);
+
+        if(own_connections){
+            if((stream.reader = source->newReader(*io, true))){
+                acq_threads.push_back(new AcqThread(std::vector<AcqStream>(1, stream), periodMS, live));
+                continue;
+            }
+            qDebug() << "couldn't open stream connection: " << source->error().c_str();
+            //Fall back to sharing the main connection for whatever is left.
+            own_connections = false;
         }
 
-        imec_fetch_containers[probe_ind]->max_samps = scansToRead_imec[probe_ind];
+        if(!(stream.reader = source->newReader(*io, false))){
+            qDebug() << "couldn't open stream: " << source->error().c_str();
+            continue;
+        }
+        shared_streams.push_back(stream);
+    }
 
-        //    std::vector<short> data(chanCounts[0] * scansToRead);
-        t_ull hC = sglx_fetch(*imec_fetch_containers[probe_ind], hSglx, lastMaxReadableScanNum_imec[probe_ind]);
-//        t_ull hC = sglx_fetchLatest(*imec_fetch_containers[probe_ind], hSglx);
+    if(shared_streams.empty()){
+        return;
+    }
+    if(realtime){
+        acq_threads.push_back(new AcqThread(shared_streams, periodMS, live));
+    }
+    else{
+        batch_worker = new AcqWorker(shared_streams, periodMS, live);
+    }
+}
 
-        if(hC < 1){
-            //Should also check here if hC = lastMaxReadableScanNum_imec[probe_ind] + 1
-            //Just fetch the latest data
-            qDebug() << "gap occured";
-            t_ull hC = sglx_fetchLatest(*imec_fetch_containers[probe_ind], hSglx);
+bool SpikeVM::updateDataBuffers()
+{
+    //Take the oldest unprocessed block from each stream's ring. Streams with nothing new get an empty block (scansToRead = 0).
+    //Returns false if no stream had anything new.
+    bool gotData = false;
+    for(int probe_ind = 0; probe_ind < num_probes; probe_ind++){
+        imec_blocks[probe_ind] = imec_rings[probe_ind]->front();
+        if(!imec_blocks[probe_ind]){
+            scansToRead_imec[probe_ind] = 0;
+            continue;
+        }
+        gotData = true;
+        lastMaxReadableScanNum_imec[probe_ind] = imec_blocks[probe_ind]->headCt;
+        scansToRead_imec[probe_ind] = imec_blocks[probe_ind]->nscans;
+
+        if(float_pipeline){
+            //The only conversion of this block: everything downstream works on the float copy.
+            const short *src = imec_blocks[probe_ind]->data;
+            size_t n = size_t(scansToRead_imec[probe_ind]) * imec_fetch_containers[probe_ind]->n_cs;
+            imec_float_data[probe_ind].resize(n);
+            float *dst = imec_float_data[probe_ind].data();
+            for(size_t k = 0; k < n; k++){
+                dst[k] = src[k];
+            }
+        }
 
-            //This means there was a gap since the last fetch, so we should reset the filters.
-            resetFilters = true;
+        if(imec_blocks[probe_ind]->gap){
+            //This means there was a gap since the last fetch, so we should reset this probe's filters.
+            qDebug() << "gap occured on probe" << probe_ind << "(" << imec_stats[probe_ind]->gaps.load() << "gaps," << imec_stats[probe_ind]->skipped.load() << "scans skipped so far)";
+            resetFilters[probe_ind] = true;
         }
-        //TODO: lock this data buffer for wrting.
+    }
 
-        //Copy imec_fetch_containers[i]->data to the corresponding buffer
-        imec_data_buffers[probe_ind]->clear();
-        imec_data_buffers[probe_ind]->reserve(imec_fetch_containers[probe_ind]->data.size());
-        std::copy(imec_fetch_containers[probe_ind]->data.begin(), imec_fetch_containers[probe_ind]->data.end(), std::back_inserter(*imec_data_buffers[probe_ind]));
-        //TODO: unlock this data buffer.
+    ni_block = ni_ring ? ni_ring->front() : nullptr;
+    if(ni_block){
+        gotData = true;
+        lastMaxReadableScanNum_ni = ni_block->headCt;
+        scansToRead_ni = ni_block->nscans;
+    }
+    else{
+        scansToRead_ni = 0;
+    }
 
+    return gotData;
+}
 
+void SpikeVM::releaseDataBuffers()
+{
+    //Hand the processed blocks back to the acquisition thread, noting how far processing has got for the lag counters.
+    for(int probe_ind = 0; probe_ind < num_probes; probe_ind++){
+        if(imec_blocks[probe_ind]){
+            imec_stats[probe_ind]->doneCt = imec_blocks[probe_ind]->headCt + t_ull(imec_blocks[probe_ind]->nscans) * dsRatio;
+            imec_rings[probe_ind]->release();
+            imec_blocks[probe_ind] = nullptr;
+        }
+    }
+    if(ni_block){
+        ni_stats->doneCt = ni_block->headCt + t_ull(ni_block->nscans) * dsRatio;
+        ni_ring->release();
+        ni_block = nullptr;
+    }
+}
 
 
-        bufScanNumEnd_imec[probe_ind] = maxReadableScanNum_imec[probe_ind] + scansToRead_imec[probe_ind];
+void SpikeVM::decimateLfp()
+{
+    //Feed each probe's raw block to its LFP decimator. This has to come before filterData(), which overwrites the int16 data in place.
+    for(int probe_ind = 0; probe_ind < lfp_decimators.size(); probe_ind++){
+        if(!imec_blocks[probe_ind]){
+            continue;
+        }
+        lfp_decimators[probe_ind]->feed(imec_blocks[probe_ind]->data, scansToRead_imec[probe_ind], imec_blocks[probe_ind]->headCt, imec_blocks[probe_ind]->gap);
     }
+}
 
+void SpikeVM::filterData()
+{
+    //Apply each probe's high-pass filter to its data buffer. All probes' channel slices go to the pool together, so probes are filtered in parallel.
+    std::vector<BiquadTask> filter_tasks;
+    for(int probe_ind = 0; probe_ind < num_probes; probe_ind++){
+        if(!imec_blocks[probe_ind]){
+            continue;
+        }
+        int num_chans = imec_fetch_containers[probe_ind]->n_cs;
+        if(resetFilters[probe_ind] && !zero_filter_transient){
+            //There was a gap since the last fetch: start the filters from this block's level rather than from before the gap.
+            if(float_pipeline){
+                imec_filters[probe_ind]->prime(imec_float_data[probe_ind].data(), scansToRead_imec[probe_ind], num_chans, 0, num_chans);
+            }
+            else{
+                imec_filters[probe_ind]->prime(imec_blocks[probe_ind]->data, 32767, scansToRead_imec[probe_ind], num_chans, 0, num_chans);
+            }
+        }
+        if(float_pipeline){
+            imec_filters[probe_ind]->addBlockwiseTasks(
+                        filter_tasks,
+                        imec_float_data[probe_ind].data(),
+                        scansToRead_imec[probe_ind],
+                        num_chans,
+                        0,
+                        num_chans,
+                        filter_pool->nThreads() + 1);
+        }
+        else{
+            imec_filters[probe_ind]->addBlockwiseTasks(
+                        filter_tasks,
+                        imec_blocks[probe_ind]->data,
+                        32767,
+                        scansToRead_imec[probe_ind],
+                        num_chans,
+                        0,
+                        num_chans,
+                        filter_pool->nThreads() + 1);
+        }
+    }
+    filter_pool->run(filter_tasks);
 
+    for(int probe_ind = 0; probe_ind < num_probes; probe_ind++){
+        if(!imec_blocks[probe_ind]){
+            continue;
+        }
+        //Check if there was a gap since the last fetch. If so, blank the filters' transient (legacy mode).
+        if(resetFilters[probe_ind] && zero_filter_transient){
+            if(float_pipeline){
+                zeroFilterTransient(imec_float_data[probe_ind].data(), scansToRead_imec[probe_ind], imec_fetch_containers[probe_ind]->n_cs);
+            }
+            else{
+                zeroFilterTransient(imec_blocks[probe_ind]->data, scansToRead_imec[probe_ind], imec_fetch_containers[probe_ind]->n_cs);
+            }
+        }
+        resetFilters[probe_ind] = false;
+    }
 
-    //Fetch NI data
-
-    //Record end of last ni fetch using last fetch's max readable scan number
-    lastMaxReadableScanNum_ni = maxReadableScanNum_ni;
+}
 
-    //Update max readable scan number for this fetch
-    maxReadableScanNum_ni = sglx_getStreamSampleCount(hSglx, 0, 0);
-    availableScansToRead_ni = maxReadableScanNum_ni - lastMaxReadableScanNum_ni;
-    scansToRead_ni = (t_ull) std::min(availableScansToRead_ni, 5 * meanScansPerTimerTick);
-    if(scansToRead_ni == 0){
+void SpikeVM::referenceData()
+{
+    //Subtract the common average or median from each probe's filtered data, so that artifacts common to all channels don't cross threshold everywhere at once.
+    if(reference_mode == ref_none){
         return;
     }
-    ni_fetch_container.max_samps = scansToRead_ni;
-    t_ull hC = sglx_fetch(ni_fetch_container, hSglx, lastMaxReadableScanNum_ni);
-    if(hC < 1){
-        qDebug() << "failed to read \n";
-        //Just fetch the latest data
-        t_ull hC = sglx_fetchLatest(ni_fetch_container, hSglx);
-
+    for(int probe_ind = 0; probe_ind < num_probes; probe_ind++){
+        if(!imec_blocks[probe_ind]){
+            continue;
+        }
+        if(float_pipeline){
+            imec_referencers[probe_ind]->apply(
+                        imec_float_data[probe_ind].data(),
+                        scansToRead_imec[probe_ind],
+                        imec_fetch_containers[probe_ind]->n_cs,
+                        reference_mode);
+        }
+        else{
+            imec_referencers[probe_ind]->apply(
+                        imec_blocks[probe_ind]->data,
+                        scansToRead_imec[probe_ind],
+                        imec_fetch_containers[probe_ind]->n_cs,
+                        reference_mode);
+        }
     }
-//    qDebug() << "read " << scansToRead_ni << "\n";
-
-
-    //Copy NI data to the data buffer
-    //TODO: lock this data buffer for wrting.
-    ni_data_buffer.clear();
-    ni_data_buffer.reserve(ni_fetch_container.data.size());
-    std::copy(ni_fetch_container.data.begin(), ni_fetch_container.data.end(), std::back_inserter(ni_data_buffer));
-    bufScanNumEnd_ni = lastMaxReadableScanNum_ni + scansToRead_ni;
-    //TODO: unlock this data buffer.
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> diff = end - start;
-//    qDebug() << "Time to get data: " << diff.count() << "s\n";
-//    qDebug() << "Finished updating buffers";
-
 }
 
-
-void SpikeVM::filterData()
+void SpikeVM::whitenData()
 {
-    //Apply each probe's high-pass filter to its data buffer
+    //Mix each probe's channels with its whitening matrix, or feed the data to the estimate while that is still being collected.
+    if(mix_mode == mix_none){
+        return;
+    }
     for(int probe_ind = 0; probe_ind < num_probes; probe_ind++){
-        imec_filters[probe_ind]->applyBlockwiseMem(
-                    &(*imec_data_buffers[probe_ind])[0],
-                    32767,
-                    scansToRead_imec[probe_ind],
-                    imec_fetch_containers[probe_ind]->n_cs,
-                    0,
-                    imec_fetch_containers[probe_ind]->n_cs);
-        //Check if there was a gap since the last fetch. If so, reset the filters.
-        if(resetFilters){
-            zeroFilterTransient(&(*imec_data_buffers[probe_ind])[0], scansToRead_imec[probe_ind], imec_fetch_containers[probe_ind]->n_cs);
+        if(!imec_blocks[probe_ind]){
+            continue;
+        }
+        ChannelMixer *mixer = imec_mixers[probe_ind];
+        int num_chans = imec_fetch_containers[probe_ind]->n_cs;
+        if(float_pipeline){
+            float *data = imec_float_data[probe_ind].data();
+            if(mixer->estimating()){
+                mixer->accumulate(data, scansToRead_imec[probe_ind], num_chans);
+            }
+            mixer->apply(data, scansToRead_imec[probe_ind], num_chans);
+        }
+        else{
+            short *data = imec_blocks[probe_ind]->data;
+            if(mixer->estimating()){
+                mixer->accumulate(data, scansToRead_imec[probe_ind], num_chans);
+            }
+            mixer->apply(data, scansToRead_imec[probe_ind], num_chans);
         }
     }
-
-    resetFilters = false;
-
 }
 
 void SpikeVM::zeroFilterTransient( short *data, int ntpts, int nchans )
@@ -356,115 +647,55 @@ void SpikeVM::zeroFilterTransient( short *data, int ntpts, int nchans )
     memset( data, 0, ntpts*nchans*sizeof(qint16) );
 }
 
+void SpikeVM::zeroFilterTransient( float *data, int ntpts, int nchans )
+{
+    if( ntpts > BIQUAD_TRANS_WIDE )
+        ntpts = BIQUAD_TRANS_WIDE;
+
+    std::fill( data, data + ntpts*nchans, 0.0f );
+}
+
+double SpikeVM::imecSample(int probe_ind, t_ull scan, int ch) const
+{
+    //Processed sample (scan, ch) of this probe's current block, from whichever buffer the pipeline works in.
+    size_t k = size_t(scan) * imec_fetch_containers[probe_ind]->n_cs + ch;
+    if(float_pipeline){
+        return imec_float_data[probe_ind][k];
+    }
+    return imec_blocks[probe_ind]->data[k];
+}
+
 
 void SpikeVM::detectSpikes()
 {
-    //    now loop through each channel and add spikes to the map
+    //Each probe's SpikeDetector scans its block in time order, comparing each scan against every channel's thresholds at once (SIMD across channels),
+    //with a loop specialized at compile time for the threshold mode and common channel counts. Crossings come back in time order, refractory already applied.
+    //The detector treats the blocks as one stream: the refractory carries across block edges, and a spike near the end of a block comes back with the next block, once its waveform is complete.
     auto start = std::chrono::high_resolution_clock::now();
-    QVector<double> vector(32, 0);
 
     for (int probe_ind = 0; probe_ind < num_probes; probe_ind++)
     {
-        int num_chans = imec_fetch_containers[probe_ind]->n_cs;
-
-        if(RMS_based_spike_detection){
-            //TODO: lock this probe's data buffer for reading.
-            for (int ch = 0; ch < num_chans; ch++) {
-                waveform_x[probe_ind].push_back(vector);
-                waveform_y[probe_ind].push_back(vector);
-                //        qDebug() << ch_threshold_high;
-                //        qDebug() << ch_threshold_low;
-                for (t_ull i = 0; i < scansToRead_imec[probe_ind]; ) {
-                    double val = (double) imec_data_buffers[probe_ind]->at((num_chans * i) + ch );
-                    val = (val - baseline_mean_by_channel_imec[probe_ind][ch]) / baseline_rms_by_channel_imec[probe_ind][ch];
-                    if ((std::abs(val) > rms_threshold_imec)) {
-                        //                    get previous waveforms for this channel:
-                        QVector<double> currchan_waveform_x = waveform_x[probe_ind][ch];
-                        QVector<double> currchan_waveform_y = waveform_y[probe_ind][ch];
-                        currchan_waveform_x.clear();
-                        currchan_waveform_y.clear();
-                        //                    add this new waveform:
-                        int waveform_halfwidth = std::round(sampleRate_imec * .0015 / dsRatio);
-                        int jlower = -std::min((int) i, waveform_halfwidth);
-                        int jupper = std::min((int) scansToRead_imec[probe_ind] - (int) i , waveform_halfwidth);
-
-                        for(int j = jlower; j < jupper; j++){
-                            currchan_waveform_x.push_back((double) j);
-                            //                        currchan_waveform_y.push_back(((mult * (double) data[ (chanCounts[0] * (i + j)) + ch ]) - mean));
-                            currchan_waveform_y.push_back(((double) imec_data_buffers[probe_ind]->at((num_chans * (i + j)) + ch )) - (baseline_mean_by_channel_imec[probe_ind][ch]));
-
-                        }
-
-                        //record spike index and channel
-                        spike_x.push_back((double) ((i * dsRatio)));
-                        spike_y.push_back(ch);
-
-                        //TODO: is this the optimal way to store this info? Memory-wise, yes, but in terms of speed of access?
-                        spike_scan_nums[probe_ind][ch].push_back(i * dsRatio + lastMaxReadableScanNum_imec[probe_ind] + 1);
-                        spike_times_ms[probe_ind][ch].push_back((i * dsRatio + lastMaxReadableScanNum_imec[probe_ind] + 1) * 1000 / sampleRate_imec);
-                        spike_channels[probe_ind].push_back(ch);
+        int num_scans = scansToRead_imec[probe_ind];
+        if(num_scans == 0){
+            continue;
+        }
 
-                        //add this back to full waveform vector:
-                        waveform_x[probe_ind][ch] = currchan_waveform_x;
-                        waveform_y[probe_ind][ch] = currchan_waveform_y;
+        SpikeDetector::Input in;
+        in.mean = baseline_mean_by_channel_imec[probe_ind].data();
+        in.rms = baseline_rms_by_channel_imec[probe_ind].data();
+        in.threshold = detect_mode == detect_rms ? rms_threshold_imec : detect_mode == detect_neo ? neo_threshold_imec : absolute_threshold_imec;
 
-                        i += std::round(sampleRate_imec * .015 / dsRatio);
-                    } else {
-                        ++i;
-                    }
-                }
-            }
+        SpikeDetector *detector = imec_detectors[probe_ind];
+        int64_t first_scan = lastMaxReadableScanNum_imec[probe_ind] / dsRatio;
+        if(float_pipeline){
+            detector->detect(imec_float_data[probe_ind].data(), num_scans, first_scan, in);
         }
         else{
-            //TODO: lock this probe's data buffer for reading.
-            for (int ch = 0; ch < num_chans; ch++) {
-                waveform_x[probe_ind].push_back(vector);
-                waveform_y[probe_ind].push_back(vector);
-
-                double ch_threshold_high = absolute_threshold_imec + baseline_mean_by_channel_imec[probe_ind][ch];
-                double ch_threshold_low = -absolute_threshold_imec + baseline_mean_by_channel_imec[probe_ind][ch];
-                for (t_ull i = 0; i < scansToRead_imec[probe_ind]; ) {
-                    double val = (double) imec_data_buffers[probe_ind]->at((num_chans * i) + ch );
-                    val = val - baseline_mean_by_channel_imec[probe_ind][ch];
-                    if ((val > ch_threshold_high) || (val < ch_threshold_low)) {
-                        //get previous waveforms for this channel:
-                        QVector<double> currchan_waveform_x = waveform_x[probe_ind][ch];
-                        QVector<double> currchan_waveform_y = waveform_y[probe_ind][ch];
-                        currchan_waveform_x.clear();
-                        currchan_waveform_y.clear();
-
-                        //add this new waveform:
-                        int waveform_halfwidth = std::round(sampleRate_imec * .0015 / dsRatio);
-                        int jlower = -std::min((int) i, waveform_halfwidth);
-                        int jupper = std::min((int) scansToRead_imec[probe_ind] - (int) i , waveform_halfwidth);
-
-                        for(int j = jlower; j < jupper; j++){
-                            currchan_waveform_x.push_back((double) j);
-                            currchan_waveform_y.push_back(((double) imec_data_buffers[probe_ind]->at((num_chans * (i + j)) + ch )) - baseline_mean_by_channel_imec[probe_ind][ch]);
-
-                        }
-
-                        //record spike index and channel
-                        spike_x.push_back((double) ((i * dsRatio)));
-                        spike_y.push_back(ch);
-
-                        //TODO: is this the optimal way to store this info? Memory-wise, yes, but in terms of speed of access?
-                        spike_scan_nums[probe_ind][ch].push_back(i * dsRatio + lastMaxReadableScanNum_imec[probe_ind] + 1);
-                        spike_times_ms[probe_ind][ch].push_back((i * dsRatio + lastMaxReadableScanNum_imec[probe_ind] + 1) * 1000 / sampleRate_imec);
-                        spike_channels[probe_ind].push_back(ch);
-
-                        //add this back to full waveform vector:
-                        waveform_x[probe_ind][ch] = currchan_waveform_x;
-                        waveform_y[probe_ind][ch] = currchan_waveform_y;
-
-                        i += std::round(sampleRate_imec * .015 / dsRatio);
-                    } else {
-                        ++i;
-                    }
-                }
-            }
+            detector->detect(imec_blocks[probe_ind]->data, num_scans, first_scan, in);
+        }
+        for (int k = 0; k < detector->hits().size(); k++) {
+            recordSpike(probe_ind, detector->hits()[k], detector->waveform(k));
         }
-        //TODO: unlock this probe's data buffer.
     }
 
     auto end = std::chrono::high_resolution_clock::now();
@@ -472,17 +703,49 @@ void SpikeVM::detectSpikes()
 //    qDebug() << "Time to get spikes: " << diff.count() << "s\n";
 }
 
+void SpikeVM::recordSpike(int probe_ind, const SpikeHit &hit, const float *waveform)
+{
+    //Keep the waveform around the spike (baseline subtracted) for display, and log the spike.
+    //The spike may be from an earlier block than the current one, so its position in the block (for the raster) can be negative.
+    int ch = hit.chan;
+    waveform_rings[probe_ind]->put(ch, waveform, hit.first, hit.last, baseline_mean_by_channel_imec[probe_ind][ch]);
+
+    //record spike index and channel
+    t_ull scan_num = t_ull(hit.scan) * dsRatio;
+    spike_x.push_back((double) scan_num - (double) lastMaxReadableScanNum_imec[probe_ind]);
+    spike_y.push_back(ch);
+
+    //TODO: is this the optimal way to store this info? Memory-wise, yes, but in terms of speed of access?
+    spike_scan_nums[probe_ind][ch].push_back(scan_num);
+    spike_times_ms[probe_ind][ch].push_back(scan_num * 1000 / sampleRate_imec);
+    spike_channels[probe_ind].push_back(ch);
+}
+
+void SpikeVM::finishDetection()
+{
+    //End of the stream: log the spikes still waiting on the rest of their waveforms.
+    for (int probe_ind = 0; probe_ind < imec_detectors.size(); probe_ind++)
+    {
+        SpikeDetector *detector = imec_detectors[probe_ind];
+        detector->flush();
+        for (int k = 0; k < detector->hits().size(); k++) {
+            recordSpike(probe_ind, detector->hits()[k], detector->waveform(k));
+        }
+    }
+}
+
 void SpikeVM::detectEvents()
 {
-    //Get digital input channel range for NI
-    cppClient_sglx_get_ints chanCount_container;
-    sglx_getStreamAcqChans(chanCount_container, hSglx, 0, 0);
-    std::vector<int> chanCounts = chanCount_container.vint;
+    if(!ni_block){
+        return;
+    }
+
+    //Get digital input channel range for NI (cached at startup; only the acquisition thread reads from the source)
+    const std::vector<int> &chanCounts = ni_chan_counts;
 //    int num_chans = chanCounts[3];
     int num_chans = ni_fetch_container.n_cs;
 
 
-    //TODO: lock this data buffer for reading.
     //An example of more complicated triggering logic on the analog NI channels. For a simple example of TTL-based triggering, scroll down to the following section.
     //here 3 is the pulse channel and 1 is the mic channel, but these can be changed:
     int mic_channel_ind = 1;
@@ -526,18 +789,18 @@ void SpikeVM::detectEvents()
         switch (trigger_phase_ni) {
             case 0:
                 //Just look for the start of an crossing on channel 3:
-                if(ni_data_buffer[(num_chans * i) + pulse_channel_ind ] > 2 * baseline_rms_by_channel_ni[pulse_channel_ind]){
+                if(ni_block->data[(num_chans * i) + pulse_channel_ind ] > 2 * baseline_rms_by_channel_ni[pulse_channel_ind]){
                     //if found, start updating the sum of squares for channel 1 and record the scan number of the crossing.
                     trigger_phase_ni = 1;
                     threshold_crossing_ongoing_ni = true;
                     threshold_crossing_start_scan_num_ni = i + lastMaxReadableScanNum_ni;
-                    sum_squares_start_scan_num_ni[mic_channel_ind] = ni_data_buffer[(num_chans * i) + mic_channel_ind ] * ni_data_buffer[(num_chans * i) + mic_channel_ind ];
+                    sum_squares_start_scan_num_ni[mic_channel_ind] = ni_block->data[(num_chans * i) + mic_channel_ind ] * ni_block->data[(num_chans * i) + mic_channel_ind ];
                 }
                 break;
 
             case 1:
                 //check if the channel 3 value has fallen below the threshold:
-                if(ni_data_buffer[(num_chans * i) + pulse_channel_ind ] < 2 * baseline_rms_by_channel_ni[pulse_channel_ind]){
+                if(ni_block->data[(num_chans * i) + pulse_channel_ind ] < 2 * baseline_rms_by_channel_ni[pulse_channel_ind]){
                     //reset the ongoing event and sum of squares
                     trigger_phase_ni = 0;
                     threshold_crossing_ongoing_ni = false;
@@ -547,7 +810,7 @@ void SpikeVM::detectEvents()
                 }
 
                 //otherwise, augment the running sum of squares for channel 1:
-                running_sum_squares_by_channel_ni[mic_channel_ind] += ni_data_buffer[(num_chans * i) + mic_channel_ind ] * ni_data_buffer[(num_chans * i) + mic_channel_ind ];
+                running_sum_squares_by_channel_ni[mic_channel_ind] += ni_block->data[(num_chans * i) + mic_channel_ind ] * ni_block->data[(num_chans * i) + mic_channel_ind ];
 
                 //check if the minimum threshold crossing duration has been attained:
                 if((i + lastMaxReadableScanNum_ni - threshold_crossing_start_scan_num_ni) > (sampleRate_ni * pulse_duration_ms / 1000)){
@@ -569,7 +832,7 @@ void SpikeVM::detectEvents()
 
             case 2:
                 //just continue updating the sum of squares for channel 1:
-                running_sum_squares_by_channel_ni[mic_channel_ind] += ni_data_buffer[(num_chans * i) + mic_channel_ind ] * ni_data_buffer[(num_chans * i) + mic_channel_ind ];
+                running_sum_squares_by_channel_ni[mic_channel_ind] += ni_block->data[(num_chans * i) + mic_channel_ind ] * ni_block->data[(num_chans * i) + mic_channel_ind ];
 
                 //see if a total of .1s has elapsed since the initial crossing:
                 if((i + lastMaxReadableScanNum_ni - threshold_crossing_start_scan_num_ni) > (sampleRate_ni * rms_refresh_window_ms / 1000)){
@@ -602,7 +865,7 @@ void SpikeVM::detectEvents()
                 }
 
                 //update the running sum of squares for channel 3:
-                running_sum_squares_by_channel_ni[pulse_channel_ind] += ni_data_buffer[(num_chans * i) + pulse_channel_ind ] * ni_data_buffer[(num_chans * i) + pulse_channel_ind ];
+                running_sum_squares_by_channel_ni[pulse_channel_ind] += ni_block->data[(num_chans * i) + pulse_channel_ind ] * ni_block->data[(num_chans * i) + pulse_channel_ind ];
 
                 //if we've already found a crossing on channel 1, we're done:
                 if(found_secondary_event_ni){
@@ -610,7 +873,7 @@ void SpikeVM::detectEvents()
                 }
 
                 //check for a crossing on channel 1 of [secondary_event_rms_multiplier]x the channel-1 RMS we just computed:
-                if(ni_data_buffer[(num_chans * i) + mic_channel_ind ] > secondary_event_rms_multiplier * baseline_rms_by_channel_ni[mic_channel_ind]){
+                if(ni_block->data[(num_chans * i) + mic_channel_ind ] > secondary_event_rms_multiplier * baseline_rms_by_channel_ni[mic_channel_ind]){
                     //if found, record the event:
                     event_scan_nums[mic_channel_ind].push_back(i + lastMaxReadableScanNum_ni);
                     event_times_by_type_ms[mic_channel_ind].push_back((i + lastMaxReadableScanNum_ni) * 1000 / sampleRate_ni);
@@ -635,7 +898,7 @@ void SpikeVM::detectEvents()
                 }
 
                 //check for a crossing on channel 1 of [secondary_event_rms_multiplier]x the channel-1 RMS we just computed:
-                if(ni_data_buffer[(num_chans * i) + mic_channel_ind ] > secondary_event_rms_multiplier * baseline_rms_by_channel_ni[mic_channel_ind]){
+                if(ni_block->data[(num_chans * i) + mic_channel_ind ] > secondary_event_rms_multiplier * baseline_rms_by_channel_ni[mic_channel_ind]){
                     //if found, record the event:
                     event_scan_nums[mic_channel_ind].push_back(i + lastMaxReadableScanNum_ni);
                     event_times_by_type_ms[mic_channel_ind].push_back((i + lastMaxReadableScanNum_ni) * 1000 / sampleRate_ni);
@@ -670,19 +933,19 @@ void SpikeVM::detectEvents()
 
             if(!event_scan_nums[event_type_ind].empty()){
                 //Get the first scan number in the buffer not in the range of the last detected event of this type:
-                t_ull first_relevant_scan_ind = std::max(event_scan_nums[event_type_ind][event_scan_nums[event_type_ind].size() - 1] + (t_ull) std::round(sampleRate_ni * event_minimum_separation_ms[event_type_ind] / 1000), lastMaxReadableScanNum_ni + 1);
-                first_relevant_buffer_ind = first_relevant_scan_ind - lastMaxReadableScanNum_ni - 1;
+                t_ull first_relevant_scan_ind = std::max(event_scan_nums[event_type_ind][event_scan_nums[event_type_ind].size() - 1] + (t_ull) std::round(sampleRate_ni * event_minimum_separation_ms[event_type_ind] / 1000), lastMaxReadableScanNum_ni);
+                first_relevant_buffer_ind = first_relevant_scan_ind - lastMaxReadableScanNum_ni;
             }
 
             //On this digital channel, look for events:
             for(t_ull i = first_relevant_buffer_ind; i < scansToRead_ni; ){
                 //get the (bit_ind)th bit of the data at this scan number
-                bool target_bit = (((ni_data_buffer[(num_chans * i) + ch] & (1 << bit_ind))) != 0);
+                bool target_bit = (((ni_block->data[(num_chans * i) + ch] & (1 << bit_ind))) != 0);
                 if(target_bit){
                     //record event index
                     //TODO: need to reconcile different sampling rates between this and imec. Do it here?
-                    event_scan_nums[event_type_ind].push_back(i + lastMaxReadableScanNum_ni + 1);
-                    event_times_by_type_ms[event_type_ind].push_back((i + lastMaxReadableScanNum_ni + 1) * 1000 / sampleRate_ni);
+                    event_scan_nums[event_type_ind].push_back(i + lastMaxReadableScanNum_ni);
+                    event_times_by_type_ms[event_type_ind].push_back((i + lastMaxReadableScanNum_ni) * 1000 / sampleRate_ni);
                     event_types.push_back(event_type_ind);
                     event_index_within_type.push_back(event_scan_nums[event_type_ind].size() - 1);
                     //initialize the spike times vector for this event for all probes and channels:
@@ -692,8 +955,8 @@ void SpikeVM::detectEvents()
                         }
                     }
 
-                    //                new_event_pretimes_by_type_ms[event_type_ind].push_back(((i + lastMaxReadableScanNum_ni + 1) * 1000 / sampleRate_ni) - event_before_after_durations_ms[event_type_ind][0]);
-                    //                qDebug() << ni_data_buffer[(num_chans * i) + ch];
+                    //                new_event_pretimes_by_type_ms[event_type_ind].push_back(((i + lastMaxReadableScanNum_ni) * 1000 / sampleRate_ni) - event_before_after_durations_ms[event_type_ind][0]);
+                    //                qDebug() << ni_block->data[(num_chans * i) + ch];
 //                    qDebug() << "Detected event " << event_type_ind << " at t = " << event_times_by_type_ms[event_type_ind][event_times_by_type_ms[event_type_ind].size() - 1];
                     i += std::round(sampleRate_ni * event_minimum_separation_ms[event_type_ind] / 1000);
                 }
@@ -709,8 +972,6 @@ void SpikeVM::detectEvents()
     }
 
     //TODO: can merge and sort events here, rather than in updateEventContents()?
-
-    //TODO: unlock this data buffer.
 }
 
 
@@ -852,23 +1113,18 @@ void SpikeVM::updateBaselineStats_imec()
 {
     //Read over each data buffer, and update the baseline stats (RMS and mean) for each channel, excluding spikes.
     for(int probe_ind = 0; probe_ind < num_probes; probe_ind++){
-        //TODO: lock this probe's data buffer for reading.
-        for(int ch = 0; ch < imec_fetch_containers[probe_ind]->n_cs; ch++){
-            //TODO: need to exclude spikes in this section
-
-            //Compute the mean of the data in this channel, excluding spikes.
-            double sum = 0;
-            for(int i = 0; i < scansToRead_imec[probe_ind]; i++){
-                sum += imec_data_buffers[probe_ind]->at((imec_fetch_containers[probe_ind]->n_cs * i) + ch);
-            }
-            baseline_mean_by_channel_imec[probe_ind][ch] = sum / scansToRead_imec[probe_ind];
-
-            //Compute the RMS of the data in this channel, excluding spikes.
-            double rms = 0;
-            for(int i = 0; i < scansToRead_imec[probe_ind]; i++){
-                rms += (imec_data_buffers[probe_ind]->at((imec_fetch_containers[probe_ind]->n_cs * i) + ch) - baseline_mean_by_channel_imec[probe_ind][ch]) * (imec_data_buffers[probe_ind]->at((imec_fetch_containers[probe_ind]->n_cs * i) + ch) - baseline_mean_by_channel_imec[probe_ind][ch]);
-            }
-            baseline_rms_by_channel_imec[probe_ind][ch] = std::sqrt(rms / scansToRead_imec[probe_ind]);
+        if(scansToRead_imec[probe_ind] == 0){
+            continue;
+        }
+        //TODO: need to exclude spikes in this section
+        const DspKernels &K = dspKernels();
+        if(float_pipeline){
+            K.meanRmsF(imec_float_data[probe_ind].data(), scansToRead_imec[probe_ind], imec_fetch_containers[probe_ind]->n_cs,
+                       baseline_mean_by_channel_imec[probe_ind].data(), baseline_rms_by_channel_imec[probe_ind].data());
+        }
+        else{
+            K.meanRms16(imec_blocks[probe_ind]->data, scansToRead_imec[probe_ind], imec_fetch_containers[probe_ind]->n_cs,
+                        baseline_mean_by_channel_imec[probe_ind].data(), baseline_rms_by_channel_imec[probe_ind].data());
         }
     }
 }
@@ -876,13 +1132,16 @@ void SpikeVM::updateBaselineStats_imec()
 void SpikeVM::updateBaselineStats_ni()
 {
     //Read over each data buffer, and update the baseline stats (RMS and mean) for each channel, using all the data in the buffer.
+    if(scansToRead_ni == 0){
+        return;
+    }
     for(int ch = 0; ch < ni_fetch_container.n_cs; ch++){
         //Loop through the buffer and compute the mean and RMS for this channel:
         double sum = 0;
         double rms = 0;
         for(int i = 0; i < scansToRead_ni; i++){
-            sum += ni_data_buffer[(ni_fetch_container.n_cs * i) + ch];
-            rms += ni_data_buffer[(ni_fetch_container.n_cs * i) + ch] * ni_data_buffer[(ni_fetch_container.n_cs * i) + ch];
+            sum += ni_block->data[(ni_fetch_container.n_cs * i) + ch];
+            rms += ni_block->data[(ni_fetch_container.n_cs * i) + ch] * ni_block->data[(ni_fetch_container.n_cs * i) + ch];
         }
         baseline_mean_by_channel_ni[ch] = sum / scansToRead_ni;
         baseline_rms_by_channel_ni[ch] = std::sqrt(rms / scansToRead_ni);
@@ -892,15 +1151,49 @@ void SpikeVM::updateBaselineStats_ni()
 void SpikeVM::runCycle()
 {
     updateParameters();
-    updateDataBuffers();
     auto start = std::chrono::high_resolution_clock::now();
-    filterData();
-    detectSpikes();
-    detectEvents();
+    //Work through everything the acquisition thread has queued since the last tick, one block per stream at a time.
+    //A backlog (and a recording always has one) is drained in chunks: stop after one tick's worth of time to keep the windows responsive, and pick up the rest next tick.
+    //If processing can't keep up live, the rings fill, the source drops the oldest scans, and that shows up as skipped scans in the stream stats rather than silently.
+    while(updateDataBuffers()){
+        processBlock();
+        if(std::chrono::high_resolution_clock::now() - start > std::chrono::milliseconds(50)){
+            break;
+        }
+    }
     updateEventContents();
-    updateBaselineStats_imec();
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> diff = end - start;
 //    qDebug() << "Time to process: " << diff.count() << "s\n";
 }
 
+void SpikeVM::processBlock()
+{
+    //Process the blocks taken by updateDataBuffers(), then hand them back.
+    decimateLfp();
+    filterData();
+    referenceData();
+    whitenData();
+    detectSpikes();
+    detectEvents();
+    updateBaselineStats_imec();
+    releaseDataBuffers();
+}
+
+bool SpikeVM::processBatchStep()
+{
+    //Read the next block of every stream on this thread and process everything read. Returns false once the source is exhausted.
+    if(!batch_worker){
+        return false;
+    }
+    updateParameters();
+    if(batch_worker->readAll() < 0){
+        finishDetection();
+        return false;
+    }
+    while(updateDataBuffers()){
+        processBlock();
+    }
+    return true;
+}
+
@@ -2,27 +2,50 @@
 #define SPIKEVM_H
 #include "SglxApi.h"
 #include "SglxCppClient.h"
-#include "Biquad.h"
+#include "BiquadBank.h"
+#include "SampleRing.h"
+#include "AcqThread.h"
+#include "DataSource.h"
+
+#include "Referencer.h"
+#include "LfpDecimator.h"
+#include "ChannelMixer.h"
+#include "SpikeDetector.h"
+#include "WaveformRing.h"
 
 #include <QVector>
 #include <Qobject>
 
+//Shank and site position of an acquired channel, from its probe's geomMap. shank is -1 for channels not in the map or marked unused.
+struct ChannelGeom {
+    int shank = -1;
+    int x = 0;
+    int z = 0;
+};
+
 class SpikeVM : public QObject
 {
     Q_OBJECT
 public:
-    explicit SpikeVM(QObject *parent = nullptr,  const char* myhost = "127.0.0.1", const int port = 4142);
+    explicit SpikeVM(QObject *parent = nullptr,  const char* myhost = "127.0.0.1", const int port = 4142, bool parallel_fetch = false);
+    //Takes ownership of source.
+    //With realtime false there is no acquisition thread or timer: the caller drives processing with processBatchStep() (recorded sources only).
+    SpikeVM(QObject *parent, DataSource *source, bool parallel_fetch = false, bool realtime = true);
+    ~SpikeVM();
 
-    t_sglxconn S;
-    void *hSglx;
+    //Live SpikeGLX connection or recorded files.
+    DataSource *source;
+    bool connected = false;
     bool running = false;
-    std::vector<t_ull> lastMaxReadableScanNum_imec, maxReadableScanNum_imec, bufScanNumEnd_imec, scansToRead_imec, availableScansToRead_imec;
+    //lastMaxReadableScanNum is the stream index of the first scan in the block being processed; scansToRead is its length.
+    std::vector<t_ull> lastMaxReadableScanNum_imec, scansToRead_imec;
 //    t_ull lastMaxReadableScanNum_imec[4] = {0, 0, 0, 0}, maxReadableScanNum_imec[4], bufScanNumEnd_imec[4], scansToRead_imec[4], availableScansToRead_imec[4];
     std::vector<std::vector<std::vector<t_ull>>> spike_scan_nums;
     std::vector<std::vector<std::vector<t_ull>>> spike_times_ms;
     std::vector<std::vector<int>> spike_channels;
     std::vector<std::vector<int>> channel_maps;
-    t_ull lastMaxReadableScanNum_ni, maxReadableScanNum_ni, bufScanNumEnd_ni, scansToRead_ni, availableScansToRead_ni;
+    std::vector<std::vector<ChannelGeom>> channel_geoms; //probe, acquisition channel
+    t_ull lastMaxReadableScanNum_ni, scansToRead_ni;
     t_ull trigger_threshold_crossing_duration_ms;
     std::vector<int> ni_chan_counts;
     std::vector<std::vector<t_ull>> event_scan_nums;
@@ -53,40 +76,108 @@ public:
     double queued_absolute_threshold_imec;
     double rms_threshold_imec = 5;
     double queued_rms_threshold_imec;
+    double neo_threshold_imec = 10;
+    double queued_neo_threshold_imec;
     double mult; //Conversion factor from int16 to true (pre-gain) V.
     const double refreshRate = 20; //Timer frequency, in Hz.
+    const double ringSeconds = 2; //Duration of data each acquisition ring can hold before the acquisition thread has to wait on processing.
+    const double lfpSeconds = 10; //Duration of decimated LFP kept for each probe.
+    const double mixEstimateSeconds = 1; //Duration of data the whitening matrix is estimated from.
     const int dsRatio = 1;
+    const int waveformDepth = 20; //Waveforms kept per channel for display.
+    const double dedupRadiusUm = 50; //Site distance within which spikes are duplicates of one another.
+    static constexpr double dedupWindowMs = .5; //Time either side within which spikes are duplicates of one another.
+    static constexpr double refractoryMs = 15; //Time after a spike during which its channel detects no other.
+    static constexpr double waveformHalfMs = 1.5; //Waveform length either side of a spike.
+    const double neoWindowMs = 100; //Time constant of the running mean energy NEO thresholds are scaled by.
 //    const char* myhost = "10.37.128.152";
-    const char* myhost;
 //    const int port = 4142;
-    const int port;
+    //If true, each probe and the NI stream get their own SpikeGLX connection and acquisition thread, so their fetches overlap.
+    const bool parallel_fetch;
+    const bool realtime;
     int num_probes;
     int num_event_types;
     bool establishConnection();
     void initializeFetchContainers();
     std::vector<int> readGeomMap(int probe_ind);
+    void decimateLfp();
     void filterData();
+    void referenceData();
+    void applyReferenceGroups();
+    void whitenData();
+    void beginMixing();
     void zeroFilterTransient( short *data, int ntpts, int nchans );
+    void zeroFilterTransient( float *data, int ntpts, int nchans );
+    double imecSample(int probe_ind, t_ull scan, int ch) const;
     void resetFilter();
     void detectSpikes();
+    void recordSpike(int probe_ind, const SpikeHit &hit, const float *waveform);
+    void finishDetection();
     void detectEvents();
     void updateParameters();
-    void updateDataBuffers();
+    void startAcquisition();
+    bool updateDataBuffers();
+    void releaseDataBuffers();
     void updateBaselineStats_imec();
     void updateBaselineStats_ni();
     void updateEventContents();
     void runCycle();
-    bool resetFilters = false;
-    bool RMS_based_spike_detection = false;
-    bool queued_RMS_based_spike_detection;
+    void processBlock();
+    bool processBatchStep();
+    //Per probe: set by a gap on that probe, and initially or when the filter form changes, as fresh filter state has the same transient.
+    std::vector<bool> resetFilters;
+    //After a gap (resetFilters) the probe's filter state is primed to the steady state of the block's first samples, so nothing is blanked and detection carries on at once.
+    //If true, the old behavior instead: the filters keep their state across the gap and the first BIQUAD_TRANS_WIDE filtered scans are zeroed.
+    bool zero_filter_transient = false;
+    //Spike threshold: absolute, a multiple of each channel's RMS, or a multiple of the mean nonlinear energy (NEO).
+    DetectMode detect_mode = detect_absolute;
+    DetectMode queued_detect_mode = detect_absolute;
+    //If true, a spike is logged only if it's the largest of those on sites within dedupRadiusUm (same shank) and dedupWindowMs, so one unit seen on many sites counts once.
+    bool dedup_spikes = false;
+    bool queued_dedup_spikes = false;
+    //Common-mode referencing between filtering and spike detection.
+    RefMode reference_mode = ref_none;
+    RefMode queued_reference_mode = ref_none;
+    bool reference_per_shank = false;
+    bool queued_reference_per_shank = false;
+    //If true, each imec block is converted once to float32 after it is taken from its ring, and filtered, referenced and detected in float32 with no re-quantizing or clipping.
+    bool float_pipeline = false;
+    bool queued_float_pipeline = false;
+    //If true, the int16 pipeline's filters use integer (Q14 fixed-point) arithmetic instead of double; outputs stay within 1 LSB. No effect on the float pipeline.
+    bool fixed_point_filter = false;
+    bool queued_fixed_point_filter = false;
+    //Spatial whitening between referencing and spike detection. The matrix is estimated afresh from the first mixEstimateSeconds of data after the mode or the referencing changes; until then data pass through.
+    MixMode mix_mode = mix_none;
+    MixMode queued_mix_mode = mix_none;
+    //If set (one matrix per probe), whitening uses these instead of estimating, e.g., batch shards sharing one estimate. They must come from the same mode and referencing.
+    std::vector<std::vector<float>> fixed_mix_matrices;
     QVector<double> spike_x, spike_y;
-    QVector<QVector<QVector<double>>> waveform_x, waveform_y;
+    //Each probe's last few waveforms per channel, for WaveformWindow.
+    std::vector<WaveformRing*> waveform_rings;
 
     std::vector<std::shared_ptr<cppClient_sglx_fetch>> imec_fetch_containers;
     cppClient_sglx_fetch ni_fetch_container;
-    std::vector<std::shared_ptr<std::vector<short>>> imec_data_buffers;
-    std::vector<short> ni_data_buffer;
-    std::vector<Biquad*> imec_filters;
+    //The acquisition thread fills one ring per stream; processing works in place on the oldest block of each.
+    std::vector<SampleRing*> imec_rings;
+    SampleRing* ni_ring = nullptr;
+    //Per-stream lag, skipped scans and gap counts, kept up to date by the acquisition thread(s); safe to read from the GUI.
+    std::vector<AcqStats*> imec_stats;
+    AcqStats* ni_stats = nullptr;
+    std::vector<SampleBlock*> imec_blocks;
+    SampleBlock* ni_block = nullptr;
+    //Float32 working copy of each probe's current block, used instead of the block's data when float_pipeline is on.
+    std::vector<std::vector<float>> imec_float_data;
+    std::vector<AcqThread*> acq_threads;
+    //Reads the streams on the caller's thread when not running in real time.
+    AcqWorker* batch_worker = nullptr;
+    std::vector<BiquadBank*> imec_filters;
+    //Long-lived filter threads shared by all probes.
+    BiquadPool* filter_pool = nullptr;
+    std::vector<Referencer*> imec_referencers;
+    std::vector<ChannelMixer*> imec_mixers;
+    std::vector<SpikeDetector*> imec_detectors;
+    //LFP band (1-300 Hz at ~1 kHz) of each probe, decimated from the raw data of each block, with the last lfpSeconds of it. Empty when not running in real time.
+    std::vector<LfpDecimator*> lfp_decimators;
 };
 
 #endif // SPIKEVM_H
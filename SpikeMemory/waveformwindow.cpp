@@ -14,6 +14,9 @@ WaveformWindow::WaveformWindow(SpikeVM *spikeVM, QWidget *parent) :
     ui->ch_range_spinbox->setMaximum(spikeVM->imec_fetch_containers[0]->n_cs - 1);
     ui->ch_range_spinbox->setValue(0);
     ui->ch_range_spinbox->setSingleStep(32);
+    for (int probe_ind = 0; probe_ind < spikeVM->num_probes; ++probe_ind) {
+        waveforms_seen.push_back(std::vector<t_ull>(spikeVM->waveform_rings[probe_ind]->nChans(), 0));
+    }
     const int pen_width = 1;
 
     //iterate over the rows of plots:
@@ -51,6 +54,7 @@ WaveformWindow::WaveformWindow(SpikeVM *spikeVM, QWidget *parent) :
             }
         }
     }
+    graph_cyclers.fill(0, plots.size());
     connect(ui->waveformWindow_startStop_button, &QPushButton::clicked, this, &WaveformWindow::startstop_button_toggled);
 //    connect(ui->spinBox, &QSpinBox::valueChanged, this, &WaveformWindow::ch_range_changed);
     QTimer *display_timer = new QTimer(this);
@@ -71,29 +75,39 @@ void WaveformWindow::refreshDisplay()
         return;
     }
 
+    //Show each channel's waveforms since the last refresh, each in the plot's next graph, so the plot holds its channel's last waveforms_per_plot; a channel with none has its oldest graph cleared, so idle channels fade out. The rings are only read here, never changed.
     int probe_ind = ui->probe_ind_spinBox->value();
+    const WaveformRing *ring = spikeVM->waveform_rings[probe_ind];
+    int width = ring->wfWidth();
+    waveform_buf.resize(width);
     for (int i = 0; i < plots.size(); ++i) {
         int ch = spikeVM->channel_maps[probe_ind][i + ui->ch_range_spinbox->value()];
-        if( spikeVM->waveform_x[probe_ind].empty() || spikeVM->waveform_x[probe_ind][ch][0] == 0){
-            plots[i]->graph(graph_cycler)->data()->clear();
+        int first, last, shown = 0;
+        while(shown < waveforms_per_plot && ring->next(ch, waveforms_seen[probe_ind][ch], waveform_buf.data(), first, last)){
+            plot_x.resize(last - first);
+            plot_y.resize(last - first);
+            for (int j = first; j < last; ++j) {
+                plot_x[j - first] = j - width / 2;
+                plot_y[j - first] = waveform_buf[j];
+            }
+            plots[i]->graph(graph_cyclers[i])->setData(plot_x, plot_y, true);
+            graph_cyclers[i] = (graph_cyclers[i] + 1) % waveforms_per_plot;
+            ++shown;
         }
-        else{
-            plots[i]->graph(graph_cycler)->setData(spikeVM->waveform_x[probe_ind][ch], spikeVM->waveform_y[probe_ind][ch]);
-            spikeVM->waveform_x[probe_ind][ch] = QVector<double>(32, 0);
-            spikeVM->waveform_y[probe_ind][ch] = QVector<double>(32, 0);
+        if(!shown){
+            plots[i]->graph(graph_cyclers[i])->data()->clear();
+            graph_cyclers[i] = (graph_cyclers[i] + 1) % waveforms_per_plot;
         }
         plots[i]->replot();
         plots[i]->update();
     }
-    graph_cycler++;
-    graph_cycler = graph_cycler % waveforms_per_plot;
 }
 
 void WaveformWindow::clearPlots()
 {
     for (int i = 0; i < plots.size(); ++i) {
         for (int j = 0; j< waveforms_per_plot; ++j){
-            plots[i]->graph(graph_cycler)->data()->clear();
+            plots[i]->graph(j)->data()->clear();
         }
         plots[i]->replot();
         plots[i]->update();
@@ -29,7 +29,11 @@ private:
     bool plotting = false;
     QVector<QCustomPlot*> plots;
     const int waveforms_per_plot = 20;
-    int graph_cycler = 0;
+    QVector<int> graph_cyclers; //Per plot, the graph its next waveform goes to.
+    //Waveforms already shown, per probe and channel, and buffers for reading one.
+    std::vector<std::vector<t_ull>> waveforms_seen;
+    std::vector<float> waveform_buf;
+    QVector<double> plot_x, plot_y;
 };
 
 #endif // WAVEFORMWINDOW_H